@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Plays games with the autopilot as far as it gets, to see how the engine
+ * copes with snakes filling the map. Reports how full the map got and the
+ * time of the ticks while most of it was empty and while it wasn't. The
+ * map doesn't change, so the cycle keeps fitting the body, and shorteners
+ * (which would cut the snake in half) only show up if asked for.
+ * Usage:
+ *     bench_autopilot [height] [width] [permill_obstacles] [games] [max_ticks]
+ *                     [probability_shortener]
+ */
+
+#include <autopilot.h>
+#include <config.h>
+#include <stdio.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <time.h>
+
+/*
+ * Monotonic clock in nanoseconds
+ */
+static double
+now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1e9 + ts.tv_nsec);
+}
+
+int
+main(int argc, char *argv[])
+{
+	int n_games = argc > 4 ? atoi(argv[4]) : 5;
+	unsigned long max_ticks = argc > 5 ? strtoul(argv[5], NULL, 10) : 2000000;
+	arguments_t args = {
+		.height = argc > 1 ? atoi(argv[1]) : DEFAULT_W_GAME_HEIGHT,
+		.width = argc > 2 ? atoi(argv[2]) : DEFAULT_W_GAME_WIDTH,
+		.permill_obstacles = argc > 3 ? atoi(argv[3]) : DEFAULT_PERMILL_OBSTACLES,
+		.obstacle_layout = LAYOUT_UNIFORM,
+		.starting_delay = DEFAULT_STARTING_DELAY,
+		.minimum_delay = DEFAULT_MINIMUM_DELAY,
+		.step_delay = DEFAULT_STEP_DELAY,
+		.duration_shortener = DEFAULT_DURATION_SHORTENER,
+		.duration_decelerator = DEFAULT_DURATION_DECELERATOR,
+		.duration_extra_points = DEFAULT_DURATION_EXTRA_POINTS,
+		.probability_shortener = argc > 6 ? atoi(argv[6]) : INT_MAX,
+		.probability_decelerator = DEFAULT_PROBABILITY_DECELERATOR,
+		.probability_extra_points = DEFAULT_PROBABILITY_EXTRA_POINTS,
+		.score_step_map_change = DEFAULT_SCORE_STEP_MAP_CHANGE,
+		.disable_map_change = 1,
+	};
+	int interior = (args.height - 2) * (args.width - 2), length, fewest_empty, food;
+	double start, time[2] = {0, 0};
+	unsigned long ticks[2] = {0, 0};
+	engine_t *engine;
+	autopilot_t *autopilot;
+
+	srand(1);
+	printf("%dx%d map, %d permill of obstacles\n", args.height, args.width,
+			args.permill_obstacles);
+	for (int g = 0; g < n_games; g++)
+	{
+		engine = init_engine(&args);
+		autopilot = init_autopilot(engine);
+		fewest_empty = interior;
+		while (engine->running && engine->tick < max_ticks)
+		{
+			steer(engine, 0, autopilot_move(autopilot, engine, 0));
+			if ((food = autopilot_dropped_food(autopilot)) != -1 &&
+					add_food(engine->field, engine->snakes[0]->head->y,
+						engine->snakes[0]->head->x))
+				set_cell(engine->field, food / args.width, food % args.width, EMPTY);
+			advance_clock(engine->field, (game_clock_t)engine->delay);
+			start = now_ns();
+			step_engine(engine, -1);
+			time[engine->field->n_empty * 2 < interior] += now_ns() - start;
+			ticks[engine->field->n_empty * 2 < interior]++;
+			if (engine->field->n_empty < fewest_empty)
+				fewest_empty = engine->field->n_empty;
+		}
+		length = 0;
+		for (const body_t *node = engine->snakes[0]->tail; node; node = node->next)
+			length++;
+		printf("Game %d: %lu ticks, cycle of %d cells, score %u, %s with %d "
+				"cells, %.1f%% of the map busy at most\n", g, engine->tick,
+				autopilot_cycle_length(autopilot), engine->scores[0],
+				engine->running ? "stopped" : "died", length,
+				100.0 * (interior - fewest_empty) / interior);
+		delete_autopilot(autopilot);
+		delete_engine(engine);
+	}
+	printf("Tick while most of the map is empty: %8.1f ns\n",
+			ticks[0] ? time[0] / ticks[0] : 0);
+	printf("Tick while most of the map is busy:  %8.1f ns (%lu ticks)\n",
+			ticks[1] ? time[1] / ticks[1] : 0, ticks[1]);
+	return (0);
+}
@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measures the round trip of the bot protocol: from sending a line of
+ * moves to having the state after them, for a bot that goes round the map
+ * without parsing more than its head. Usage:
+ *     bench_bot_rtt <cnake> [full|delta] [turns_per_line] [turns] [height] [width]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LINE_SIZE (1 << 24)
+
+/*
+ * Monotonic clock in microseconds
+ */
+static double
+now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1e6 + ts.tv_nsec / 1e3);
+}
+
+/*
+ * Start cnake as a bot game, with its stdin and stdout in *to and *from
+ */
+static pid_t
+start_game(char *argv[], FILE **to, FILE **from)
+{
+	int in[2], out[2];
+	pid_t pid;
+
+	if (pipe(in) == -1 || pipe(out) == -1 || (pid = fork()) == -1)
+	{
+		perror("bench_bot_rtt");
+		exit(1);
+	}
+	if (pid == 0)
+	{
+		dup2(in[0], STDIN_FILENO);
+		dup2(out[1], STDOUT_FILENO);
+		close(in[1]);
+		close(out[0]);
+		execv(argv[0], argv);
+		perror("bench_bot_rtt");
+		_exit(1);
+	}
+
+	close(in[0]);
+	close(out[1]);
+	*to = fdopen(in[1], "w");
+	*from = fdopen(out[0], "r");
+	return (pid);
+}
+
+/*
+ * Move of a bot that follows the walls two cells away, clockwise
+ */
+static const char*
+next_move(const char *state, int height, int width)
+{
+	const char *heads = strstr(state, "\"heads\":[[");
+	char direction[8];
+	int y, x;
+
+	if (!heads || sscanf(heads, "\"heads\":[[%d,%d,\"%7[a-z]", &y, &x,
+				direction) != 3)
+		return ("-");
+	if (!strcmp(direction, "up"))
+		return (y <= 2 ? "right" : "-");
+	if (!strcmp(direction, "right"))
+		return (x >= width - 3 ? "down" : "-");
+	if (!strcmp(direction, "down"))
+		return (y >= height - 3 ? "left" : "-");
+	return (x <= 2 ? "up" : "-");
+}
+
+int
+main(int argc, char *argv[])
+{
+	const char *mode = argc > 2 ? argv[2] : "delta";
+	int per_line = argc > 3 ? atoi(argv[3]) : 1;
+	int turns = argc > 4 ? atoi(argv[4]) : 20000;
+	char *height = argc > 5 ? argv[5] : "100", *width = argc > 6 ? argv[6] : "100";
+	char *game[] = {argc > 1 ? argv[1] : "./cnake", "-B", (char*)mode,
+		"-H", height, "-W", width, "-o", "0", "-C", NULL};
+	char *line = malloc(LINE_SIZE);
+	const char *move;
+	double start, elapsed, sum = 0, max = 0;
+	size_t bytes = 0;
+	int played = 0, lines = 0, games = 0;
+	FILE *to, *from;
+	pid_t pid;
+
+	if (argc < 2)
+	{
+		fputs("Usage: bench_bot_rtt <cnake> [full|delta] [turns_per_line] "
+				"[turns] [height] [width]\n", stderr);
+		return (1);
+	}
+
+	while (played < turns)
+	{
+		pid = start_game(game, &to, &from);
+		games++;
+		fgets(line, LINE_SIZE, from);  /* Start */
+		fgets(line, LINE_SIZE, from);  /* First state */
+
+		/* Every turn of a line repeats the move, straight ahead after a turn */
+		while (played < turns)
+		{
+			move = next_move(line, atoi(height), atoi(width));
+			start = now_us();
+			fprintf(to, "[\"%s\"", move);
+			for (int i = 1; i < per_line; i++)
+				fputs(",\"-\"", to);
+			fputs("]\n", to);
+			fflush(to);
+			if (!fgets(line, LINE_SIZE, from) || strstr(line, "\"end\""))
+				break;
+			elapsed = now_us() - start;
+
+			sum += elapsed;
+			if (elapsed > max)
+				max = elapsed;
+			bytes += strlen(line);
+			played += per_line;
+			lines++;
+		}
+
+		fclose(to);
+		fclose(from);
+		waitpid(pid, NULL, 0);
+	}
+
+	printf("%s, %d turns per line, %sx%s map, %d games\n", mode, per_line,
+			height, width, games);
+	printf("Round trip: avg %.1f us, max %.1f us\n", sum / lines, max);
+	printf("Per turn: %.1f us, %.0f bytes per state\n", sum / played,
+			(double)bytes / lines);
+
+	free(line);
+	return (0);
+}
@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measures copying a game to try a move on it, as bots searching ahead
+ * do: a clone of a game_state_t and a tick, against capturing the game
+ * from the engine each time, and against a tick of the engine undone
+ * through its journal. Usage:
+ *     bench_clone [height] [width] [length] [iterations]
+ */
+
+#include <game_state.h>
+#include <journal.h>
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/*
+ * Monotonic clock in nanoseconds
+ */
+static double
+now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1e9 + ts.tv_nsec);
+}
+
+/*
+ * Move of a snake that goes round the map two cells away from the border
+ */
+static int
+round_move(const game_state_t *state, int player)
+{
+	const state_snake_t *snake = &state->snakes[player];
+	int y = snake->head / state->width, x = snake->head % state->width;
+
+	switch (snake->direction)
+	{
+		case NORTH:
+			return (y <= 2 ? EAST : -1);
+		case EAST:
+			return (x >= state->width - 3 ? SOUTH : -1);
+		case SOUTH:
+			return (y >= state->height - 3 ? WEST : -1);
+		default:
+			return (x <= 2 ? NORTH : -1);
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	int length = argc > 3 ? atoi(argv[3]) : 40;
+	long iterations = argc > 4 ? atol(argv[4]) : 1000000;
+	arguments_t args = {
+		.height = argc > 1 ? atoi(argv[1]) : DEFAULT_W_GAME_HEIGHT,
+		.width = argc > 2 ? atoi(argv[2]) : DEFAULT_W_GAME_WIDTH,
+		.permill_obstacles = 0,
+		.obstacle_layout = LAYOUT_UNIFORM,
+		.starting_delay = DEFAULT_STARTING_DELAY,
+		.minimum_delay = DEFAULT_MINIMUM_DELAY,
+		.step_delay = DEFAULT_STEP_DELAY,
+		.duration_shortener = DEFAULT_DURATION_SHORTENER,
+		.duration_decelerator = DEFAULT_DURATION_DECELERATOR,
+		.duration_extra_points = DEFAULT_DURATION_EXTRA_POINTS,
+		.probability_shortener = DEFAULT_PROBABILITY_SHORTENER,
+		.probability_decelerator = DEFAULT_PROBABILITY_DECELERATOR,
+		.probability_extra_points = DEFAULT_PROBABILITY_EXTRA_POINTS,
+		.score_step_map_change = DEFAULT_SCORE_STEP_MAP_CHANGE,
+		.disable_map_change = 1,
+	};
+	engine_t *engine;
+	game_state_t *root, *work, *captured;
+	int moves[MAX_PLAYERS] = {-1, -1};
+	journal_t *journal = init_journal();
+	double start, cloned, rebuilt, undone;
+	unsigned long alive = 0;
+
+	srand(1);
+	engine = init_engine(&args);
+	root = capture_game(engine, 1);
+
+	/* Grow the snake going round, eating whatever is on the way */
+	while (root->snakes[0].length < length && root->running)
+	{
+		moves[0] = round_move(root, 0);
+		step_game_state(root, moves);
+		if (root->tick % 64 == 0)
+			root->map[root->snakes[0].head +
+				(root->snakes[0].direction == EAST ? 1 : -1)] = FOOD;
+	}
+	work = copy_game(root);
+
+	start = now_ns();
+	for (long i = 0; i < iterations; i++)
+	{
+		clone_game(work, root);
+		moves[0] = (int)(i & 3);
+		step_game_state(work, moves);
+		alive += work->running;
+	}
+	cloned = (now_ns() - start) / iterations;
+
+	start = now_ns();
+	for (long i = 0; i < iterations / 100; i++)
+	{
+		captured = capture_game(engine, (uint64_t)i);
+		moves[0] = (int)(i & 3);
+		step_game_state(captured, moves);
+		alive += captured->running;
+		delete_game_state(captured);
+	}
+	rebuilt = (now_ns() - start) / (iterations / 100);
+
+	attach_journal(engine, journal);
+	start = now_ns();
+	for (long i = 0; i < iterations; i++)
+	{
+		steer(engine, 0, (direction_t)(i & 3));
+		advance_clock(engine->field, (game_clock_t)engine->delay);
+		step_engine(engine, -1);
+		alive += engine->running;
+		undo_tick(engine);
+	}
+	undone = (now_ns() - start) / iterations;
+	attach_journal(engine, NULL);
+
+	printf("%dx%d map, snake of %d cells, %zu bytes per state\n",
+			args.height, args.width, root->snakes[0].length,
+			offsetof(game_state_t, map) + (size_t)root->cells +
+			sizeof(int) * root->snakes[0].length);
+	printf("%-24s %8.1f ns\n", "clone + tick", cloned);
+	printf("%-24s %8.1f ns\n", "capture + tick", rebuilt);
+	printf("%-24s %8.1f ns\n", "engine tick + undo", undone);
+	printf("(%lu alive)\n", alive);
+
+	delete_game_state(root);
+	delete_game_state(work);
+	delete_engine(engine);
+	delete_journal(journal);
+	return (0);
+}
@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measures what it costs bots to find the way to food when they share the
+ * distances of the field, against a search of their own each. The
+ * autopilot plays a game while the bots, at random passable cells each
+ * tick, look for the nearest food or item. Usage:
+ *     bench_food_distance [height] [width] [bots] [ticks]
+ */
+
+#include <autopilot.h>
+#include <config.h>
+#include <flat_map.h>
+#include <food_distance.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Monotonic clock in microseconds
+ */
+static double
+now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1e6 + ts.tv_nsec / 1e3);
+}
+
+/*
+ * Steps from cell to the nearest food or item searching from it, -1 if
+ * there's none. seen must hold a byte per cell, all 0, and is left that way
+ */
+static int
+search_food(const cell_byte_t *cells, int width, int cell, int *queue,
+		int *steps, unsigned char *seen)
+{
+	const int offsets[4] = {-width, 1, -1, width};
+	int head = 0, tail = 1, next, found = -1;
+
+	queue[0] = cell;
+	steps[cell] = 0;
+	seen[cell] = 1;
+	while (head < tail && found == -1)
+	{
+		cell = queue[head++];
+		if (cells[cell] != EMPTY)
+			found = steps[cell];
+		for (int k = 0; k < 4 && found == -1; k++)
+		{
+			next = cell + offsets[k];
+			if (flat_passable[cells[next]] && !seen[next])
+			{
+				seen[next] = 1;
+				steps[next] = steps[cell] + 1;
+				queue[tail++] = next;
+			}
+		}
+	}
+	for (int i = 0; i < tail; i++)
+		seen[queue[i]] = 0;
+	return (found);
+}
+
+/*
+ * Play ticks of a game with the autopilot, the bots looking for food
+ * after each one through the shared distances if shared, else each on its
+ * own. Add the time of the steps to *stepping and the one of the bots to
+ * *looking, and return the ticks played
+ */
+static unsigned long
+play(const arguments_t *args, int bots, unsigned long ticks, int shared,
+		double *stepping, double *looking)
+{
+	engine_t *engine = init_engine(args);
+	autopilot_t *autopilot = init_autopilot(engine);
+	food_distance_t *distances = shared ? init_food_distance(engine->field) : NULL;
+	int cells = args->height * args->width, *at = malloc(sizeof(int) * bots);
+	int *queue = malloc(sizeof(int) * cells), *steps = malloc(sizeof(int) * cells);
+	unsigned char *seen = calloc(cells, 1);
+	unsigned long played;
+	long sum = 0;
+	double start;
+
+	if (shared)
+		attach_food_distance(engine, distances);
+	srand(1);
+	while (engine->running && engine->tick < ticks)
+	{
+		for (int b = 0; b < bots; b++)
+			at[b] = engine->field->empty_cells[rand() % engine->field->n_empty];
+
+		steer(engine, 0, autopilot_move(autopilot, engine, 0));
+		advance_clock(engine->field, (game_clock_t)engine->delay);
+		start = now_us();
+		step_engine(engine, -1);
+		*stepping += now_us() - start;
+
+		start = now_us();
+		for (int b = 0; b < bots; b++)
+			sum += shared ? food_distance(distances, at[b] / args->width,
+					at[b] % args->width) :
+				search_food(engine->field->cells, args->width, at[b], queue,
+						steps, seen);
+		*looking += now_us() - start;
+	}
+	played = engine->tick;
+	printf("%s: %lu ticks, %.1f steps to food on average\n",
+			shared ? "Shared distances" : "Own search", played,
+			(double)sum / played / bots);
+
+	if (shared)
+	{
+		attach_food_distance(engine, NULL);
+		delete_food_distance(distances);
+	}
+	delete_autopilot(autopilot);
+	delete_engine(engine);
+	free(at);
+	free(queue);
+	free(steps);
+	free(seen);
+	return (played);
+}
+
+int
+main(int argc, char *argv[])
+{
+	int bots = argc > 3 ? atoi(argv[3]) : 32;
+	unsigned long ticks = argc > 4 ? strtoul(argv[4], NULL, 10) : 1000;
+	arguments_t args = {
+		.height = argc > 1 ? atoi(argv[1]) : 200,
+		.width = argc > 2 ? atoi(argv[2]) : 200,
+		.permill_obstacles = DEFAULT_PERMILL_OBSTACLES,
+		.obstacle_layout = LAYOUT_UNIFORM,
+		.starting_delay = DEFAULT_STARTING_DELAY,
+		.minimum_delay = DEFAULT_MINIMUM_DELAY,
+		.step_delay = DEFAULT_STEP_DELAY,
+		.duration_shortener = DEFAULT_DURATION_SHORTENER,
+		.duration_decelerator = DEFAULT_DURATION_DECELERATOR,
+		.duration_extra_points = DEFAULT_DURATION_EXTRA_POINTS,
+		.probability_shortener = DEFAULT_PROBABILITY_SHORTENER,
+		.probability_decelerator = DEFAULT_PROBABILITY_DECELERATOR,
+		.probability_extra_points = DEFAULT_PROBABILITY_EXTRA_POINTS,
+		.score_step_map_change = DEFAULT_SCORE_STEP_MAP_CHANGE,
+	};
+	double stepping[2] = {0, 0}, looking[2] = {0, 0};
+	unsigned long played[2];
+
+	printf("%dx%d map, %d bots\n", args.height, args.width, bots);
+	for (int shared = 0; shared < 2; shared++)
+	{
+		srand(1);
+		played[shared] = play(&args, bots, ticks, shared, &stepping[shared],
+				&looking[shared]);
+	}
+	printf("Per tick, own search:       step %8.2f us, bots %8.2f us\n",
+			stepping[0] / played[0], looking[0] / played[0]);
+	printf("Per tick, shared distances: step %8.2f us, bots %8.2f us\n",
+			stepping[1] / played[1], looking[1] / played[1]);
+	return (0);
+}
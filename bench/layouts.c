@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measures how long each obstacle layout takes to generate. Usage:
+ *     bench_layouts [height] [width] [repetitions]
+ */
+
+#include <obstacles.h>
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/*
+ * Monotonic clock in milliseconds
+ */
+static double
+now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1e3 + ts.tv_nsec / 1e6);
+}
+
+int
+main(int argc, char *argv[])
+{
+	const struct
+	{
+		const char *name;
+		obstacle_layout_t layout;
+		int permill;
+	} layouts[] = {
+		{"uniform", LAYOUT_UNIFORM, DEFAULT_PERMILL_OBSTACLES},
+		{"caves", LAYOUT_CAVES, DEFAULT_PERMILL_CAVES},
+		{"maze", LAYOUT_MAZE, DEFAULT_PERMILL_MAZE},
+		{"arena", LAYOUT_ARENA, DEFAULT_PERMILL_ARENA},
+	};
+	int height = argc > 1 ? atoi(argv[1]) : 4000;
+	int width = argc > 2 ? atoi(argv[2]) : 4000;
+	int repetitions = argc > 3 ? atoi(argv[3]) : 5;
+	bitplane_t *plane = init_bitplane(height, width);
+	double start, elapsed, best;
+
+	printf("map %dx%d, best of %d\n", height, width, repetitions);
+	for (size_t i = 0; i < sizeof(layouts) / sizeof(layouts[0]); i++)
+	{
+		best = -1;
+		for (int r = 0; r < repetitions; r++)
+		{
+			clear_bitplane(plane);
+			start = now_ms();
+			generate_obstacles(plane, layouts[i].layout, layouts[i].permill,
+					(uint64_t)r + 1);
+			elapsed = now_ms() - start;
+			if (best < 0 || elapsed < best)
+				best = elapsed;
+		}
+		printf("%-8s (%4d permill): %8.2f ms\n", layouts[i].name,
+				layouts[i].permill, best);
+	}
+
+	delete_bitplane(plane);
+	return (0);
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measures how long game ticks take on a big map, comparing the ticks that
+ * change the map, and the ones placing the change after them, with the
+ * regular ones. Every tick spawns food reachable from a snake head, as the
+ * engine does when food is eaten, so it pays for whatever the change left
+ * to the regions. Usage:
+ *     bench_map_change [height] [width] [permill] [ticks] [ticks_per_change]
+ *                      [layout]
+ */
+
+#include <field.h>
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/*
+ * Monotonic clock in microseconds
+ */
+static double
+now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1e6 + ts.tv_nsec / 1e3);
+}
+
+int
+main(int argc, char *argv[])
+{
+	int height = argc > 1 ? atoi(argv[1]) : 300;
+	int width = argc > 2 ? atoi(argv[2]) : 300;
+	int permill = argc > 3 ? atoi(argv[3]) : 10;
+	int ticks = argc > 4 ? atoi(argv[4]) : 2000;
+	int ticks_per_change = argc > 5 ? atoi(argv[5]) : 100;
+	int layout = argc > 6 ? parse_obstacle_layout(argv[6]) : LAYOUT_UNIFORM;
+	double start, elapsed, max[3] = {0, 0, 0}, sum[3] = {0, 0, 0};
+	int count[3] = {0, 0, 0}, kind, head;
+	struct timespec plan_time = {0, DEFAULT_STARTING_DELAY * 1000000L};
+	field_t *field;
+
+	if (layout == -1)
+	{
+		fprintf(stderr, "Unknown layout %s\n", argv[6]);
+		return (1);
+	}
+	srand(1);
+	field = init_field(height, width, layout, permill);
+
+	/*
+	 * A snake head that stays put, so food spawns in its region. The game
+	 * starts with food, which labels the regions for the first time
+	 */
+	head = field->empty_cells[rand() % field->n_empty];
+	set_cell(field, head / width, head % width, SNAKE);
+	add_food(field, head / width, head % width);
+
+	/*
+	 * A regular tick is taken as one where food is eaten, the most
+	 * expensive one without map change
+	 */
+	for (int i = 1; i <= ticks; i++)
+	{
+		kind = field->next_word < field->obstacles->height *
+			field->obstacles->stride;
+		start = now_us();
+		if (i % ticks_per_change == 0)
+		{
+			change_obstacles(field);
+			kind = 2;
+		}
+		place_obstacles(field);
+		remove_expired_items(field);
+		add_food(field, head / width, head % width);
+		elapsed = now_us() - start;
+
+		/*
+		 * The game waits a delay between ticks while the next layout is
+		 * computed in the background. Without that wait, on a single core
+		 * the thread would take its time out of the ticks measured
+		 */
+		if (kind == 2)
+			nanosleep(&plan_time, NULL);
+
+		sum[kind] += elapsed;
+		count[kind]++;
+		if (elapsed > max[kind])
+			max[kind] = elapsed;
+	}
+
+	printf("map %dx%d, %d permill obstacles, %d ticks\n", height, width,
+			permill, ticks);
+	printf("regular tick:    avg %10.1f us  max %10.1f us\n",
+			count[0] ? sum[0] / count[0] : 0, max[0]);
+	printf("map change tick: avg %10.1f us  max %10.1f us\n",
+			count[2] ? sum[2] / count[2] : 0, max[2]);
+	printf("placing ticks:   avg %10.1f us  max %10.1f us  (%.1f a change)\n",
+			count[1] ? sum[1] / count[1] : 0, max[1],
+			count[2] ? (double)count[1] / count[2] : 0);
+
+	delete_field(field);
+	return (0);
+}
@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measures the games per second the MCTS bot plays with 1 to workers
+ * threads, then has it play two-player games against a greedy bot that
+ * goes for the nearest food without crashing. Usage:
+ *     bench_mcts [workers] [budget_ms] [games] [max_ticks]
+ */
+
+#include <mcts.h>
+#include <config.h>
+#include <flat_map.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/*
+ * Sleep ms milliseconds
+ */
+static void
+sleep_ms(int ms)
+{
+	struct timespec ts = {ms / 1000, (long)(ms % 1000) * 1000000L};
+
+	nanosleep(&ts, NULL);
+}
+
+/*
+ * Move of player closer to some food without crashing, if possible
+ */
+static int
+greedy_move(const game_state_t *state, int player)
+{
+	const int offsets[4] = {-state->width, 1, -1, state->width};
+	int head = state->snakes[player].head, food = -1, next, best = -1;
+	int distance, best_distance = 1 << 30;
+
+	for (int i = 0; i < state->cells && food == -1; i++)
+		if (state->map[i] == FOOD)
+			food = i;
+	for (int d = 0; d < 4; d++)
+	{
+		next = head + offsets[d];
+		if (d == SOUTH - state->snakes[player].direction ||
+				!flat_passable[state->map[next]])
+			continue;
+		distance = food == -1 ? 0 :
+			abs(next / state->width - food / state->width) +
+			abs(next % state->width - food % state->width);
+		if (distance < best_distance)
+		{
+			best_distance = distance;
+			best = d;
+		}
+	}
+	return (best);
+}
+
+int
+main(int argc, char *argv[])
+{
+	int max_workers = argc > 1 ? atoi(argv[1]) : 4;
+	int budget = argc > 2 ? atoi(argv[2]) : 20;
+	int n_games = argc > 3 ? atoi(argv[3]) : 10;
+	unsigned long max_ticks = argc > 4 ? strtoul(argv[4], NULL, 10) : 1000;
+	arguments_t args = {
+		.height = DEFAULT_W_GAME_HEIGHT,
+		.width = DEFAULT_W_GAME_WIDTH,
+		.permill_obstacles = DEFAULT_PERMILL_OBSTACLES,
+		.obstacle_layout = LAYOUT_UNIFORM,
+		.starting_delay = DEFAULT_STARTING_DELAY,
+		.minimum_delay = DEFAULT_MINIMUM_DELAY,
+		.step_delay = DEFAULT_STEP_DELAY,
+		.two_players = 1,
+		.duration_shortener = DEFAULT_DURATION_SHORTENER,
+		.duration_decelerator = DEFAULT_DURATION_DECELERATOR,
+		.duration_extra_points = DEFAULT_DURATION_EXTRA_POINTS,
+		.probability_shortener = DEFAULT_PROBABILITY_SHORTENER,
+		.probability_decelerator = DEFAULT_PROBABILITY_DECELERATOR,
+		.probability_extra_points = DEFAULT_PROBABILITY_EXTRA_POINTS,
+		.score_step_map_change = DEFAULT_SCORE_STEP_MAP_CHANGE,
+		.disable_map_change = 1,
+	};
+	engine_t *engine;
+	game_state_t *game;
+	mcts_t *mcts;
+	int moves[MAX_PLAYERS], wins = 0, losses = 0;
+	unsigned long rollouts = 0, searches = 0;
+
+	srand(1);
+	engine = init_engine(&args);
+	game = capture_game(engine, 1);
+	printf("%dx%d map, %d ms per move\n", args.height, args.width, budget);
+	for (int workers = 1; workers <= max_workers; workers *= 2)
+	{
+		mcts = init_mcts(workers);
+		start_mcts(mcts, game, 1, (game_clock_t)budget);
+		sleep_ms(budget);
+		finish_mcts(mcts);
+		printf("%2d workers: %9.0f games per second\n", workers,
+				mcts_rollouts(mcts) * 1000.0 / budget);
+		delete_mcts(mcts);
+	}
+	delete_game_state(game);
+	delete_engine(engine);
+
+	mcts = init_mcts(max_workers);
+	for (int g = 0; g < n_games; g++)
+	{
+		engine = init_engine(&args);
+		game = capture_game(engine, (uint64_t)g);
+		while (game->running && game->tick < max_ticks)
+		{
+			start_mcts(mcts, game, 1, (game_clock_t)budget);
+			sleep_ms(budget);
+			moves[1] = finish_mcts(mcts);
+			rollouts += mcts_rollouts(mcts);
+			searches++;
+			moves[0] = greedy_move(game, 0);
+			step_game_state(game, moves);
+		}
+		if (game->loser == 0)
+			wins++;
+		else if (game->loser == 1)
+			losses++;
+		printf("Game %d: %lu ticks, scores greedy %u, MCTS %u, %s\n", g,
+				game->tick, game->scores[0], game->scores[1],
+				game->loser == -1 ? "nobody died" :
+				game->loser == 0 ? "greedy died" : "MCTS died");
+		delete_game_state(game);
+		delete_engine(engine);
+	}
+	if (searches)
+		printf("MCTS won %d, lost %d of %d games, %.0f games per move\n", wins,
+				losses, n_games, (double)rollouts / searches);
+
+	delete_mcts(mcts);
+	return (0);
+}
@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measures how long encoding the observations of a batch of games takes,
+ * against a pass over the map for every plane. Usage:
+ *     bench_observation [envs] [height] [width] [window] [rounds]
+ */
+
+#include <observation.h>
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Monotonic clock in microseconds
+ */
+static double
+now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1e6 + ts.tv_nsec / 1e3);
+}
+
+/*
+ * Whole map observations of env as bytes, a plane at a time
+ */
+static void
+encode_naive(const vec_env_t *env, unsigned char *out)
+{
+	static const int types[PLANES][2] = {
+		[PLANE_WALLS] = {BORDER, OBSTACLE},
+		[PLANE_OWN_BODY] = {SNAKE, SNAKE},
+		[PLANE_OWN_HEAD] = {HEAD, HEAD},
+		[PLANE_OTHER_HEAD] = {HEAD2, HEAD2},
+		[PLANE_FOOD] = {FOOD, FOOD},
+		[PLANE_SHORTENER] = {SHORTENER, SHORTENER},
+		[PLANE_DECELERATOR] = {DECELERATOR, DECELERATOR},
+		[PLANE_EXTRA_POINTS] = {EXTRA_POINTS, EXTRA_POINTS},
+		[PLANE_OTHER_BODY] = {-1, -1},
+	};
+	const cell_byte_t *map;
+
+	for (int game = 0; game < env->n_envs; game++)
+	{
+		map = vec_env_game(env, game)->map;
+		for (int k = 0; k < PLANES; k++, out += env->cells)
+			for (int i = 0; i < env->cells; i++)
+				out[i] = map[i] == types[k][0] || map[i] == types[k][1];
+	}
+}
+
+/*
+ * Return the microseconds encode_vec_observations takes following spec,
+ * the best of rounds
+ */
+static double
+time_encoder(const observation_spec_t *spec, const vec_env_t *env,
+		void *out, int rounds)
+{
+	double start, elapsed, best = 1e30;
+
+	for (int r = 0; r < rounds; r++)
+	{
+		start = now_us();
+		encode_vec_observations(spec, env, out);
+		elapsed = now_us() - start;
+		if (elapsed < best)
+			best = elapsed;
+	}
+	return (best);
+}
+
+int
+main(int argc, char *argv[])
+{
+	int n_envs = argc > 1 ? atoi(argv[1]) : 1024;
+	int window = argc > 4 ? atoi(argv[4]) : 15;
+	int rounds = argc > 5 ? atoi(argv[5]) : 50;
+	arguments_t args = {
+		.height = argc > 2 ? atoi(argv[2]) : DEFAULT_W_GAME_HEIGHT,
+		.width = argc > 3 ? atoi(argv[3]) : DEFAULT_W_GAME_WIDTH,
+		.permill_obstacles = DEFAULT_PERMILL_OBSTACLES,
+		.obstacle_layout = LAYOUT_UNIFORM,
+		.starting_delay = DEFAULT_STARTING_DELAY,
+		.minimum_delay = DEFAULT_MINIMUM_DELAY,
+		.step_delay = DEFAULT_STEP_DELAY,
+		.duration_shortener = DEFAULT_DURATION_SHORTENER,
+		.duration_decelerator = DEFAULT_DURATION_DECELERATOR,
+		.duration_extra_points = DEFAULT_DURATION_EXTRA_POINTS,
+		.probability_shortener = DEFAULT_PROBABILITY_SHORTENER,
+		.probability_decelerator = DEFAULT_PROBABILITY_DECELERATOR,
+		.probability_extra_points = DEFAULT_PROBABILITY_EXTRA_POINTS,
+		.score_step_map_change = DEFAULT_SCORE_STEP_MAP_CHANGE,
+	};
+	observation_spec_t specs[] = {
+		{OBSERVATION_BYTES, args.height, args.width, 0},
+		{OBSERVATION_BITS, args.height, args.width, 0},
+		{OBSERVATION_BYTES, window, window, 1},
+		{OBSERVATION_BITS, window, window, 1},
+	};
+	const char *names[] = {"bytes, whole map", "bits, whole map",
+		"bytes, egocentric", "bits, egocentric"};
+	vec_env_t *env = init_vec_env(&args, n_envs, 1, 1);
+	size_t size = observation_size(&specs[0]) * n_envs;
+	unsigned char *naive = malloc(size), *out = malloc(size);
+	double start, elapsed, best = 1e30;
+
+	/* Some play so the maps aren't all fresh */
+	int *actions = calloc(n_envs, sizeof(int));
+	float *rewards = malloc(sizeof(float) * n_envs);
+	unsigned char *dones = malloc(n_envs);
+	for (int s = 0; s < 10; s++)
+	{
+		for (int i = 0; i < n_envs; i++)
+			actions[i] = (s + i) % 5 - 1;
+		step_vec_env(env, actions, rewards, dones);
+	}
+
+	for (int r = 0; r < rounds; r++)
+	{
+		start = now_us();
+		encode_naive(env, naive);
+		elapsed = now_us() - start;
+		if (elapsed < best)
+			best = elapsed;
+	}
+	printf("%d games of %dx%d\n", n_envs, args.height, args.width);
+	printf("%-20s %8.1f ns per game\n", "plane by plane", best * 1e3 / n_envs);
+
+	for (int i = 0; i < 4; i++)
+	{
+		if (specs[i].egocentric)
+			printf("%dx%d window:\n", window, window);
+		printf("%-20s %8.1f ns per game\n", names[i],
+				time_encoder(&specs[i], env, out, rounds) * 1e3 / n_envs);
+		if (i == 0 && memcmp(naive, out, size) != 0)
+			printf("Output differs from plane by plane\n");
+	}
+
+	delete_vec_env(env);
+	free(naive);
+	free(out);
+	free(actions);
+	free(rewards);
+	free(dones);
+	return (0);
+}
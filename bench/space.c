@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measures measure_space against a flood fill of a cell at a time from
+ * each neighbour of the head, on the field of each obstacle layout.
+ * Usage:
+ *     bench_space [height] [width] [repetitions]
+ */
+
+#include <space.h>
+#include <config.h>
+#include <flat_map.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Monotonic clock in microseconds
+ */
+static double
+now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1e6 + ts.tv_nsec / 1e3);
+}
+
+/*
+ * Cells reachable from cell, a cell at a time. seen must hold as many
+ * bytes as the map and be all 0, and is left that way
+ */
+static int
+flood_cells(cell_byte_t *map, int width, int cell, int *queue)
+{
+	const int offsets[4] = {-width, 1, -1, width};
+	int head = 0, tail = 1, next;
+
+	queue[0] = cell;
+	map[cell] = SNAKE;
+	while (head < tail)
+	{
+		cell = queue[head++];
+		for (int k = 0; k < 4; k++)
+		{
+			next = cell + offsets[k];
+			if (flat_passable[map[next]])
+			{
+				map[next] = SNAKE;
+				queue[tail++] = next;
+			}
+		}
+	}
+	return (tail);
+}
+
+int
+main(int argc, char *argv[])
+{
+	const struct
+	{
+		const char *name;
+		obstacle_layout_t layout;
+		int permill;
+	} layouts[] = {
+		{"uniform", LAYOUT_UNIFORM, DEFAULT_PERMILL_OBSTACLES},
+		{"caves", LAYOUT_CAVES, DEFAULT_PERMILL_CAVES},
+		{"maze", LAYOUT_MAZE, DEFAULT_PERMILL_MAZE},
+		{"arena", LAYOUT_ARENA, DEFAULT_PERMILL_ARENA},
+	};
+	int height = argc > 1 ? atoi(argv[1]) : 200;
+	int width = argc > 2 ? atoi(argv[2]) : 200;
+	int repetitions = argc > 3 ? atoi(argv[3]) : 1000;
+	int cells = height * width, head, room[4], check[4], next;
+	const int offsets[4] = {-width, 1, -1, width};
+	cell_byte_t *map = malloc(cells), *copy = malloc(cells);
+	int *queue = malloc(sizeof(int) * cells);
+	space_t *space = init_space(height, width);
+	double start, bits, one;
+	field_t *field;
+
+	srand(1);
+	printf("map %dx%d, average of %d\n", height, width, repetitions);
+	for (size_t i = 0; i < sizeof(layouts) / sizeof(layouts[0]); i++)
+	{
+		field = init_field(height, width, layouts[i].layout,
+				layouts[i].permill);
+		memcpy(map, field->cells, cells);
+		head = field->empty_cells[rand() % field->n_empty];
+		map[head] = HEAD;
+
+		start = now_us();
+		for (int r = 0; r < repetitions; r++)
+			measure_space(space, map, head, room);
+		bits = (now_us() - start) / repetitions;
+
+		start = now_us();
+		for (int r = 0; r < repetitions; r++)
+		{
+			for (int d = 0; d < 4; d++)
+			{
+				memcpy(copy, map, cells);
+				next = head + offsets[d];
+				check[d] = flat_passable[copy[next]] ?
+					flood_cells(copy, width, next, queue) : 0;
+			}
+		}
+		one = (now_us() - start) / repetitions;
+
+		printf("%-8s: room %d %d %d %d, %8.2f us, a cell at a time %8.2f us%s\n",
+				layouts[i].name, room[0], room[1], room[2], room[3], bits, one,
+				memcmp(room, check, sizeof(room)) ? " (MISMATCH)" : "");
+		delete_field(field);
+	}
+
+	delete_space(space);
+	free(queue);
+	free(copy);
+	free(map);
+	return (0);
+}
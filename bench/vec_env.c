@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measures how many game steps per second a batch of games runs, with
+ * snakes that turn at random one tick out of turn_every. lockstep 0 steps
+ * the games one by one even if the CPU could do them together. Usage:
+ *     bench_vec_env [envs] [workers] [steps] [height] [width] [turn_every]
+ *         [lockstep]
+ */
+
+#include <vec_env.h>
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/*
+ * Monotonic clock in microseconds
+ */
+static double
+now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1e6 + ts.tv_nsec / 1e3);
+}
+
+int
+main(int argc, char *argv[])
+{
+	int n_envs = argc > 1 ? atoi(argv[1]) : 4096;
+	int n_workers = argc > 2 ? atoi(argv[2]) : 1;
+	int steps = argc > 3 ? atoi(argv[3]) : 2000;
+	int turn_every = argc > 6 ? atoi(argv[6]) : 8;
+	arguments_t args = {
+		.height = argc > 4 ? atoi(argv[4]) : DEFAULT_W_GAME_HEIGHT,
+		.width = argc > 5 ? atoi(argv[5]) : DEFAULT_W_GAME_WIDTH,
+		.permill_obstacles = DEFAULT_PERMILL_OBSTACLES,
+		.obstacle_layout = LAYOUT_UNIFORM,
+		.starting_delay = DEFAULT_STARTING_DELAY,
+		.minimum_delay = DEFAULT_MINIMUM_DELAY,
+		.step_delay = DEFAULT_STEP_DELAY,
+		.duration_shortener = DEFAULT_DURATION_SHORTENER,
+		.duration_decelerator = DEFAULT_DURATION_DECELERATOR,
+		.duration_extra_points = DEFAULT_DURATION_EXTRA_POINTS,
+		.probability_shortener = DEFAULT_PROBABILITY_SHORTENER,
+		.probability_decelerator = DEFAULT_PROBABILITY_DECELERATOR,
+		.probability_extra_points = DEFAULT_PROBABILITY_EXTRA_POINTS,
+		.score_step_map_change = DEFAULT_SCORE_STEP_MAP_CHANGE,
+	};
+	int *actions = malloc(sizeof(int) * n_envs);
+	float *rewards = malloc(sizeof(float) * n_envs);
+	unsigned char *dones = malloc(sizeof(unsigned char) * n_envs);
+	double start, elapsed = 0, points = 0;
+	long episodes = 0;
+	vec_env_t *env;
+	rng_t rng;
+
+	env = init_vec_env(&args, n_envs, n_workers, 1);
+	if (argc > 7 && atoi(argv[7]) == 0)
+		env->lockstep = 0;
+	seed_rng(&rng, 2);
+
+	/* Actions are drawn outside of the measured time */
+	for (int s = 0; s < steps; s++)
+	{
+		for (int i = 0; i < n_envs; i++)
+			actions[i] = rng_below(&rng, (uint32_t)turn_every) == 0 ?
+				(int)rng_below(&rng, 4) : -1;
+
+		start = now_us();
+		step_vec_env(env, actions, rewards, dones);
+		elapsed += now_us() - start;
+
+		for (int i = 0; i < n_envs; i++)
+		{
+			episodes += dones[i];
+			if (!dones[i])
+				points += rewards[i];
+		}
+	}
+
+	printf("%d games of %dx%d, %d workers, %d steps%s\n", n_envs, args.height,
+			args.width, pool_workers(env->pool), steps,
+			env->lockstep ? ", in lockstep" : "");
+	printf("%.1f M steps/s, %.1f ns per step\n",
+			(double)n_envs * steps / elapsed, elapsed * 1e3 / ((double)n_envs * steps));
+	printf("%ld episodes, %.1f steps and %.1f points each\n", episodes,
+			(double)n_envs * steps / (episodes ? episodes : 1),
+			points / (episodes ? episodes : 1));
+
+	delete_vec_env(env);
+	free(actions);
+	free(rewards);
+	free(dones);
+	return (0);
+}
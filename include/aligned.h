@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ALIGNED_H
+#define ALIGNED_H
+
+#include <stddef.h>
+
+/*
+ * Memory aligned to a power of two, e.g. a cache line. C11 aligned_alloc
+ * isn't there on Windows, which has _aligned_malloc instead, so this picks
+ * the one at hand. Only aligned_free can deallocate it
+ */
+
+/*
+ * Allocate size bytes starting at a multiple of alignment, or return NULL
+ */
+void*
+aligned_malloc(size_t alignment, size_t size);
+
+/*
+ * Deallocate memory from aligned_malloc
+ */
+void
+aligned_free(void *ptr);
+
+#endif /* ALIGNED_H */
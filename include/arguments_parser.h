@@ -23,12 +23,22 @@ typedef struct arguments_s
 	/* Value -1 means no specified */
 	int height, width;
 	int use_terminal_dimensions;
+	int half_blocks;
+	int minimap;
 	int permill_obstacles;
+	int obstacle_layout;  /* obstacle_layout_t */
 	int starting_delay, minimum_delay, step_delay;
 	int two_players;
+	int ai_opponent;  /* Player 2 is the computer */
+	int autopilot;    /* The computer plays alone */
 	int duration_shortener, duration_decelerator, duration_extra_points;
 	int probability_shortener, probability_decelerator, probability_extra_points;
 	int score_step_map_change, disable_map_change;
+	const char *export_video;  /* NULL means no video */
+	int video_scale;
+	const char *asciicast;  /* NULL means no recording */
+	const char *input;      /* Script of commands, "-" for stdin, NULL for none */
+	int bot_protocol;       /* bot_protocol_t, -1 if a person plays */
 } arguments_t;
 
 /*
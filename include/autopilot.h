@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef AUTOPILOT_H
+#define AUTOPILOT_H
+
+#include <engine.h>
+
+/*
+ * Drives a snake over a Hamiltonian cycle of the free cells, so it can
+ * grow until it fills most of the map, e.g. to stress the engine with the
+ * longest snakes. The cycle goes around a spanning tree of the 2x2 blocks
+ * without obstacles, then takes in pairs of the cells left out wherever
+ * they lie along it. Single cells between obstacles stay out. It's
+ * computed again when the obstacles change. While the snake is short and
+ * following the cycle it takes shortcuts that keep its body behind the
+ * head in the cycle, leaving more room before the tail the longer it is.
+ * Food out of the cycle is taken from the cycle when there's a way back
+ * after it. Food the cycle doesn't pass by, in a dead end or left after a
+ * lap is given up on, for the caller to put somewhere else. Out of the
+ * cycle, or when it's blocked, the snake goes back into it where the body
+ * won't be in the way, or else takes the move with most room
+ */
+typedef struct autopilot_s autopilot_t;
+
+/*
+ * Initialize an autopilot for the field of engine
+ */
+autopilot_t*
+init_autopilot(const engine_t *engine);
+
+/*
+ * Return the move of player in engine
+ */
+direction_t
+autopilot_move(autopilot_t *autopilot, const engine_t *engine, int player);
+
+/*
+ * Return the cell of the food the last move gave up on, -1 if none
+ */
+int
+autopilot_dropped_food(const autopilot_t *autopilot);
+
+/*
+ * Return the cells of the cycle, 0 if there's none
+ */
+int
+autopilot_cycle_length(const autopilot_t *autopilot);
+
+/*
+ * Deallocate autopilot
+ */
+void
+delete_autopilot(autopilot_t *autopilot);
+
+#endif /* AUTOPILOT_H */
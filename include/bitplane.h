@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef BITPLANE_H
+#define BITPLANE_H
+
+#include <stdint.h>
+
+/*
+ * One bit per cell of a height x width map. Each row starts on its own
+ * 64 bit word so rows can be processed a word (64 cells) at a time
+ */
+typedef struct
+{
+	int height, width;
+	int stride;       /* Words per row */
+	uint64_t *words;  /* [height * stride], bits past width are always 0 */
+} bitplane_t;
+
+
+/*
+ * Initialize a bitplane with all its bits cleared
+ */
+bitplane_t*
+init_bitplane(int height, int width);
+
+/*
+ * Clear all the bits of plane
+ */
+void
+clear_bitplane(bitplane_t *plane);
+
+/*
+ * Return the bit of cell (y, x)
+ */
+int
+get_bit(const bitplane_t *plane, int y, int x);
+
+/*
+ * Set the bit of cell (y, x)
+ */
+void
+set_bit(bitplane_t *plane, int y, int x);
+
+/*
+ * Clear the bit of cell (y, x)
+ */
+void
+reset_bit(bitplane_t *plane, int y, int x);
+
+/*
+ * Return the index of the lowest set bit of word, which must not be 0
+ */
+int
+lowest_bit(uint64_t word);
+
+/*
+ * Return the index of the highest set bit of word, which must not be 0
+ */
+int
+highest_bit(uint64_t word);
+
+/*
+ * Return how many bits of word are set
+ */
+int
+count_bits(uint64_t word);
+
+/*
+ * Deallocate plane
+ */
+void
+delete_bitplane(bitplane_t *plane);
+
+#endif /* BITPLANE_H */
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef BOT_PROTOCOL_H
+#define BOT_PROTOCOL_H
+
+#include <arguments_parser.h>
+
+/*
+ * How much of the map each state message carries
+ */
+typedef enum
+{
+	BOT_FULL,   /* Every cell */
+	BOT_DELTA,  /* Only the cells changed since the previous message */
+} bot_protocol_t;
+
+/*
+ * Play a game without terminal, driven by a bot through stdin and stdout,
+ * one JSON object per line. cnake writes a start message with the whole
+ * map, then a state message after each turn the bot sends, and an end
+ * message when the game is over. Each line from the bot holds the moves
+ * of one or more turns, as strings: one per snake and turn, in order, any
+ * of "up", "down", "left", "right", "-" (keep going) or "quit". The game
+ * clock advances the current delay each turn. Return the exit status
+ */
+int
+run_bot_protocol(const arguments_t *args, bot_protocol_t mode);
+
+/*
+ * Parse the name of a mode. Return -1 if it isn't known
+ */
+int
+parse_bot_protocol(const char *name);
+
+#endif /* BOT_PROTOCOL_H */
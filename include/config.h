@@ -30,6 +30,10 @@
 
 /* Obstacles */
 #define DEFAULT_PERMILL_OBSTACLES 10
+/* Default permill of the other layouts, the meaning depends on the layout */
+#define DEFAULT_PERMILL_CAVES 450
+#define DEFAULT_PERMILL_MAZE 150
+#define DEFAULT_PERMILL_ARENA 100
 
 /* Delays */
 /* milliseconds */
@@ -54,7 +58,16 @@
 #define DEFAULT_PROBABILITY_DECELERATOR 10
 #define DEFAULT_PROBABILITY_EXTRA_POINTS 10
 
+/* Reward of a bot in training when its snake dies, see vec_env.h */
+#define REWARD_DEATH -10.0f
+
+/* Percent of the delay of a tick the computer thinks its move, see mcts.h */
+#define MCTS_TIME_SHARE 70
+
 /* Map change */
 #define DEFAULT_SCORE_STEP_MAP_CHANGE 200
 
+/* Recording */
+#define DEFAULT_VIDEO_SCALE 2  /* Pixels per cell side */
+
 #endif /* CONFIG_H */
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <arguments_parser.h>
+#include <field.h>
+#include <snake.h>
+
+#define MAX_PLAYERS 2
+
+/*
+ * State of a whole game and the rules that move it forward. It knows
+ * nothing about terminals or wall clock time, whoever runs it decides
+ * when ticks happen and how much game time they take
+ */
+typedef struct
+{
+	const arguments_t *args;
+	field_t *field;
+	snake_t *snakes[MAX_PLAYERS];
+	int n_players;
+	unsigned int scores[MAX_PLAYERS];
+	unsigned int score_last_change;
+	int delay;    /* Milliseconds between ticks */
+	int running;  /* 0 once someone died or the game was quit */
+	int loser;    /* Player who died first, -1 if nobody did */
+	unsigned long tick;
+} engine_t;
+
+
+/*
+ * Initialize a game following args, which must outlive it
+ */
+engine_t*
+init_engine(const arguments_t *args);
+
+/*
+ * Point the snake of player to direction. Players without a snake are
+ * ignored
+ */
+void
+steer(engine_t *engine, int player, direction_t direction);
+
+/*
+ * Run a tick: advance the snake of player, or all of them if player is -1,
+ * applying what they find, then take away expired items
+ */
+void
+step_engine(engine_t *engine, int player);
+
+/*
+ * Return the Zobrist hash of the game: the field with its temporal items
+ * and the direction and score of each snake, from field->hash in
+ * O(players). Equal games have equal hashes on every machine, e.g. to
+ * detect desyncs or as the key of transposition tables. Building with
+ * CNAKE_CHECK_HASH compares field->hash with a full recomputation after
+ * every tick
+ */
+uint64_t
+hash_engine(const engine_t *engine);
+
+/*
+ * Stop the game without anyone dying
+ */
+void
+quit_engine(engine_t *engine);
+
+/*
+ * Deallocate engine
+ */
+void
+delete_engine(engine_t *engine);
+
+#endif /* ENGINE_H */
@@ -18,10 +18,15 @@
 #ifndef FIELD_H
 #define FIELD_H
 
+#include <bitplane.h>
+#include <obstacles.h>
 #include <stdlib.h>
-#include <time.h>
 
 typedef int coord_t;
+
+/* Milliseconds of game time, only advances while the game is running */
+typedef unsigned long game_clock_t;
+
 typedef enum
 {
 	EMPTY,
@@ -36,11 +41,17 @@ typedef enum
 	EXTRA_POINTS,
 } cell_t;
 
+/* Number of cell types, kept out of cell_t so that switches over it stay complete */
+#define CELL_TYPES (EXTRA_POINTS + 1)
+
+/* cell_t as stored in the matrix, one byte each */
+typedef unsigned char cell_byte_t;
+
 typedef struct temp_item_s
 {
 	coord_t y, x;
-	time_t scheduled_destruction;
-	struct temp_item_s *next;
+	game_clock_t scheduled_destruction;
+	struct temp_item_s *prev, *next;
 } temp_item_t;
 
 typedef temp_item_t* temp_item_list_t;
@@ -48,42 +59,127 @@ typedef temp_item_t* temp_item_list_t;
 typedef struct
 {
 	int width, height;
-	cell_t **matrix;  /* [height][width] */
-	temp_item_list_t til;
+	cell_byte_t *cells;    /* [height * width], row after row */
+	cell_byte_t **matrix;  /* [height][width], rows of cells */
+	temp_item_list_t til;   /* Only items still present in the matrix */
+	temp_item_t **item_at;  /* [height * width], item in each cell or NULL */
+	game_clock_t clock;
+	obstacle_layout_t layout;
+	int permill_obstacles;
+	bitplane_t *obstacles;            /* Obstacles placed in the matrix */
+	obstacle_plan_t *next_obstacles;  /* Layout for the next map change */
+
+	/*
+	 * Layout of the last map change, placed a few words of obstacles a
+	 * tick. Words [0, next_word) of obstacles already follow it
+	 */
+	bitplane_t *next_layout;
+	int next_word;
+
+	/* Empty cells (as y * width + x) and the slot of each one, or -1 */
+	int *empty_cells, *empty_slot, n_empty;
+
+	/*
+	 * Connected regions of passable cells (everything but snakes, borders
+	 * and obstacles). Each passable cell has a node of the union-find
+	 * region_parent, which has room for twice as many nodes as cells so
+	 * that a relabel reclaims them once in a while. Only relabelled when
+	 * dirty and needed
+	 */
+	int *region_node, *region_parent, n_region_nodes;
+	int regions_dirty;
+	int *fill_queue;  /* [height * width], flood fills of small regions */
+
+	/*
+	 * Columns [damage_from[y], damage_to[y]) of each row y that set_cell
+	 * changed since whoever follows them (the minimap or the bot protocol)
+	 * last reset them
+	 */
+	coord_t *damage_from, *damage_to;
+
+	struct journal_s *journal;  /* Where changes are recorded, or NULL */
+
+	/* Distances to food and items kept up to date, or NULL */
+	struct food_distance_s *food_distance;
+
+	/* Zobrist hash of the matrix and the temporal items, see zobrist.h */
+	uint64_t hash;
 } field_t;
 
 
 /*
- * Initialize a field with empty (incl. borders) matrix
+ * Initialize a field with empty (incl. borders) matrix and obstacles
+ * following layout
  */
 field_t*
-init_field(int height, int width, int permill_obstacles);
+init_field(int height, int width, obstacle_layout_t layout,
+		int permill_obstacles);
 
 /*
- * Changes the ubication of the obstacles to a new one
+ * Changes the ubication of the obstacles to a new one of the same kind of
+ * layout. The new layout is
+ * computed in the background beforehand, and place_obstacles applies the
+ * differences with the current one over the next ticks. Cells that are
+ * busy by then keep their content instead of becoming obstacles
  */
 void
 change_obstacles(field_t *field);
 
 /*
- * Add a random cell with food into the matrix. Return 0 if there wasn't
- * space for it. Return 1 in success
+ * Apply the next differences of the map change under way, if any, as many
+ * as fit in a tick. Called once a tick
+ */
+void
+place_obstacles(field_t *field);
+
+/*
+ * Change the cell (y, x) of the matrix to type. Every write to the matrix
+ * after init_field must go through here to keep track of empty cells,
+ * regions and damage
+ */
+void
+set_cell(field_t *field, coord_t y, coord_t x, cell_t type);
+
+/*
+ * Add a random cell with food into the matrix, reachable from the cell
+ * (near_y, near_x), e.g. the head of the snake that ate. With near_y -1,
+ * or if nothing reachable is empty, it can be anywhere. Return 0 if there
+ * wasn't space for it. Return 1 in success
  */
 int
-add_food(field_t *field);
+add_food(field_t *field, coord_t near_y, coord_t near_x);
 
 /*
- * Add a random cell with "type" into the matrix. Return 0 if there wasn't
- * space for it. Return 1 in success
+ * Add a random cell with "type" into the matrix that will last "duration"
+ * milliseconds of game time, reachable from (near_y, near_x) as in
+ * add_food. Return 0 if there wasn't space for it. Return 1 in success
  */
 int
-add_temp_item(field_t *field, cell_t type, time_t duration);
+add_temp_item(field_t *field, cell_t type, game_clock_t duration,
+		coord_t near_y, coord_t near_x);
+
+/*
+ * Move the game clock forward "elapsed" milliseconds. While it isn't
+ * called (e.g. the game is paused) temporal items don't age
+ */
+void
+advance_clock(field_t *field, game_clock_t elapsed);
 
 /*
- * Add extra_seconds to all the temporal items in the map
+ * Forget the temporal item in (y, x), if any, without touching the matrix.
+ * Used when something takes the item's cell, like a snake eating it
  */
 void
-prolong_temp_items(field_t *field, time_t extra_seconds);
+take_temp_item(field_t *field, coord_t y, coord_t x);
+
+/*
+ * Register a temporal item in (y, x), which is already in the matrix, that
+ * lasts until the game clock reaches destruction. Used to roll back taking
+ * it
+ */
+void
+restore_temp_item(field_t *field, coord_t y, coord_t x,
+		game_clock_t destruction);
 
 /*
  * Take away expired items from the map
@@ -91,6 +187,13 @@ prolong_temp_items(field_t *field, time_t extra_seconds);
 void
 remove_expired_items(field_t *field);
 
+/*
+ * Return the hash of the matrix and the temporal items computed from
+ * scratch, which field->hash keeps up to date as they change
+ */
+uint64_t
+hash_field(const field_t *field);
+
 /*
  * Deallocate field
  */
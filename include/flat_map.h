@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef FLAT_MAP_H
+#define FLAT_MAP_H
+
+#include <field.h>
+#include <rng.h>
+
+/*
+ * Helpers for maps kept as a plain array of cells, one cell_byte_t each
+ * numbered y * width + x and with borders all around, like the ones of
+ * vec_env_t and game_state_t. Unlike field_t they keep no empty cells or
+ * regions, so these work them out from the cells
+ */
+
+/* Whether a snake can go through a cell, for every byte */
+extern const unsigned char flat_passable[256];
+
+/*
+ * Return whether blocking the interior cell may split the passable cells
+ * around it, as set_cell checks it: its passable 4-neighbours aren't all
+ * linked through the ring of 8 cells around it
+ */
+int
+flat_may_split(const cell_byte_t *map, int width, int cell);
+
+/*
+ * Return a random empty cell of the map, or -1 if there's none
+ */
+int
+flat_random_empty(const cell_byte_t *map, int cells, rng_t *rng);
+
+/*
+ * Return a random empty cell reachable from the cell near, as add_food
+ * chooses them, or -1 if there's none. queue must hold cells ints, and
+ * the map is left as it was
+ */
+int
+flat_random_reachable(cell_byte_t *map, int width, int cells, rng_t *rng,
+		int *queue, int near);
+
+/*
+ * Return whether all the passable cells of the map are connected. queue
+ * must hold cells ints, and the map is left as it was
+ */
+int
+flat_connected(cell_byte_t *map, int width, int cells, int *queue);
+
+#endif /* FLAT_MAP_H */
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef FOOD_DISTANCE_H
+#define FOOD_DISTANCE_H
+
+#include <engine.h>
+
+/*
+ * Distance from every cell of a field to the nearest food or item, going
+ * through passable cells, shared by every bot of the game: each one reads
+ * the neighbours of its head instead of searching the map. Computed from
+ * all of them at once with a breadth-first search, again only when food
+ * or items go away or the obstacles change, and patched as snakes move:
+ * the cells that got their distance through a cell that becomes busy are
+ * worked out again, and a cell left behind lowers the ones around it
+ */
+typedef struct food_distance_s food_distance_t;
+
+/*
+ * Initialize the distances for the field as it is now
+ */
+food_distance_t*
+init_food_distance(const field_t *field);
+
+/*
+ * Keep distances up to date with the field of engine from now on, or stop
+ * if distances is NULL. They follow a single field
+ */
+void
+attach_food_distance(engine_t *engine, food_distance_t *distances);
+
+/*
+ * Return the steps from (y, x) to the nearest food or item, or -1 if none
+ * can be reached or the cell is busy. Up to date after each tick
+ */
+int
+food_distance(const food_distance_t *distances, coord_t y, coord_t x);
+
+/*
+ * Return the direction of the neighbour of the head of snake nearest to
+ * food or items, or the one the snake goes if none leads to them
+ */
+direction_t
+toward_food(const food_distance_t *distances, const snake_t *snake);
+
+/*
+ * Deallocate distances, which must not be attached anymore
+ */
+void
+delete_food_distance(food_distance_t *distances);
+
+/*
+ * What the field and the engine tell the distances attached to them: a
+ * change of a cell, and the end of a tick to do what was left for it
+ */
+void
+note_cell(food_distance_t *distances, const field_t *field, coord_t y,
+		coord_t x, cell_t old);
+
+void
+refresh_food_distance(food_distance_t *distances, const field_t *field);
+
+#endif /* FOOD_DISTANCE_H */
@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef GAME_STATE_H
+#define GAME_STATE_H
+
+#include <engine.h>
+#include <rng.h>
+#include <stddef.h>
+
+/* Temporal items a state keeps at once, no more are generated while full */
+#define GAME_STATE_MAX_ITEMS 16
+
+/*
+ * Snake of a game_state_t: its body is a ring of cells from the tail
+ */
+typedef struct
+{
+	int tail;    /* Slot of the ring with the tail */
+	int length;  /* Cells of the snake, head included */
+	int head;    /* Cell of the head */
+	unsigned char direction;  /* direction_t */
+	unsigned char head_type;  /* cell_t */
+} state_snake_t;
+
+/*
+ * A whole game in a single allocation, so copying it is copying memory:
+ * only the room for flood fills, which holds nothing between ticks, is
+ * pointed to. It follows the rules of the engine with its own random
+ * numbers, and ticks take game time (the delay) instead of waiting for it.
+ * Bots try moves ahead on states captured from the engine, and batches of
+ * games for training keep states one after another. Map changes are only
+ * played by states with layouts to choose from: the next layout of a
+ * field isn't known until it happens.
+ * Cells are numbered y * width + x
+ */
+typedef struct
+{
+	/* What a tick without events touches comes first, in a cache line */
+	int split;    /* Passable cells may not be all connected */
+	int n_items;
+	int delay;    /* Milliseconds of game time per tick */
+	int running;  /* 0 once someone died */
+	game_clock_t clock;
+	unsigned long tick;
+	state_snake_t snakes[MAX_PLAYERS];
+
+	const arguments_t *args;
+	int height, width, cells, n_players;
+	int loser;    /* Player who died first, -1 if nobody did */
+	int food;     /* Cell with the food, -1 if there wasn't room for it */
+	unsigned int scores[MAX_PLAYERS];
+	unsigned int score_last_change;
+	const cell_byte_t *layouts;  /* [n_layouts * cells] maps without snakes, or NULL */
+	int n_layouts;
+	rng_t rng;
+	int item_cell[GAME_STATE_MAX_ITEMS];
+	game_clock_t item_end[GAME_STATE_MAX_ITEMS];
+	int *queue;   /* [cells] for flood fills, kept by clone_game */
+
+	/* The map ([cells]), followed by the body rings ([n_players * cells] ints) */
+	cell_byte_t map[];
+} game_state_t;
+
+
+/*
+ * Return the bytes of a state of a height x width map with n_players,
+ * without the room for flood fills. It's a multiple of the alignment of
+ * game_state_t, so states can be kept one after another
+ */
+size_t
+game_state_size(int height, int width, int n_players);
+
+/*
+ * Make the game_state_size bytes at state a new game following args, which
+ * must outlive it, on one of the n_layouts maps of layouts, as init_engine
+ * does. Map changes pick another one of them. Flood fills use queue, which
+ * states that are never stepped at the same time may share. Its random
+ * numbers are drawn from seed
+ */
+void
+new_game_state(game_state_t *state, const arguments_t *args, int n_players,
+		const cell_byte_t *layouts, int n_layouts, int *queue, uint64_t seed);
+
+/*
+ * Start the game of state over on another one of its layouts
+ */
+void
+restart_game_state(game_state_t *state);
+
+/*
+ * Initialize a state with the game of engine, drawing its random numbers
+ * from seed
+ */
+game_state_t*
+capture_game(const engine_t *engine, uint64_t seed);
+
+/*
+ * Initialize a state with the game of state
+ */
+game_state_t*
+copy_game(const game_state_t *state);
+
+/*
+ * Make dst the same game as src. They must have the same size and number
+ * of players, e.g. dst from copy_game(src) or a clone of it
+ */
+void
+clone_game(game_state_t *dst, const game_state_t *src);
+
+/*
+ * Return the cell of the body of player in the given position from the
+ * tail
+ */
+int
+state_body_cell(const game_state_t *state, int player, int position);
+
+/*
+ * Run a tick of state as step_engine does for all the players, steering
+ * them to moves (a direction_t, or -1 to keep going) before. The clock
+ * advances by the delay first
+ */
+void
+step_game_state(game_state_t *state, const int *moves);
+
+/*
+ * Run a tick of a one player state whose snake goes to direction, into an
+ * empty cell, without temporal items in the map: what step_game_state does
+ * then, but split, what state->split becomes, is worked out by the caller
+ * (e.g. for several states at once)
+ */
+void
+slide_game_state(game_state_t *state, int direction, int split);
+
+/*
+ * Deallocate state
+ */
+void
+delete_game_state(game_state_t *state);
+
+#endif /* GAME_STATE_H */
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <field.h>
+#include <snake.h>
+
+/*
+ * What a player wants to do, wherever it comes from: the keyboard or a
+ * script
+ */
+typedef struct
+{
+	enum {CMD_STEER, CMD_PAUSE, CMD_QUIT, CMD_OTHER} type;
+	int player;
+	direction_t direction;
+} command_t;
+
+/*
+ * Script of commands read from a file or a pipe without blocking. Each
+ * line is "<tick> <command> [player]", due when the game reaches that
+ * tick, or "@<ms> <command> [player]", due that many milliseconds after
+ * the game started. Commands are up, down, left, right and quit, players
+ * 1 or 2 (1 if missing). Due times must not go backwards. Empty lines and
+ * lines starting by # are skipped
+ */
+typedef struct input_s input_t;
+
+
+/*
+ * Open the script at path, or stdin if path is "-". Return NULL if it
+ * can't be opened
+ */
+input_t*
+open_input(const char *path);
+
+/*
+ * Take the next command if it's due at tick or time (milliseconds since
+ * the game started). Return 0 if there isn't any due yet
+ */
+int
+poll_input(input_t *input, unsigned long tick, game_clock_t time,
+		command_t *command);
+
+/*
+ * Return 1 if the script may still have commands
+ */
+int
+input_open(const input_t *input);
+
+/*
+ * Close the script
+ */
+void
+close_input(input_t *input);
+
+#endif /* INPUT_H */
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <engine.h>
+
+/*
+ * Changes a game went through, tick after tick, with what they replaced so
+ * they can be rolled back: search bots can try a move and undo it instead
+ * of copying the game, and a replay can go back a few seconds. Writes to
+ * the field only pay for a check of field->journal while none is attached.
+ * Random numbers drawn in a tick aren't rolled back with it
+ */
+typedef struct journal_s journal_t;
+
+/*
+ * Initialize an empty journal
+ */
+journal_t*
+init_journal(void);
+
+/*
+ * Record the changes of engine into journal from now on, or stop recording
+ * if journal is NULL. A journal follows a single engine
+ */
+void
+attach_journal(engine_t *engine, journal_t *journal);
+
+/*
+ * Roll back the last tick recorded in the journal of engine, with the
+ * steering and the clock advance done before it. Return 0 if there was
+ * none. Return 1 in success
+ */
+int
+undo_tick(engine_t *engine);
+
+/*
+ * Return the number of ticks that can be rolled back
+ */
+unsigned long
+journal_ticks(const journal_t *journal);
+
+/*
+ * Forget all but the last keep ticks, e.g. to rewind at most a few seconds
+ */
+void
+forget_ticks(journal_t *journal, unsigned long keep);
+
+/*
+ * Deallocate journal, which must not be attached anymore
+ */
+void
+delete_journal(journal_t *journal);
+
+/*
+ * What the engine records as it changes, each with the old value. Called
+ * only while a journal is attached
+ */
+void
+record_cell(journal_t *journal, coord_t y, coord_t x, cell_t old);
+
+void
+record_head(journal_t *journal, snake_t *snake, body_t *old_neck);
+
+/* Takes ownership of tail, which the journal frees once forgotten */
+void
+record_tail(journal_t *journal, snake_t *snake, body_t *tail);
+
+void
+record_direction(journal_t *journal, snake_t *snake, direction_t old);
+
+void
+record_item_added(journal_t *journal, coord_t y, coord_t x);
+
+void
+record_item_taken(journal_t *journal, const temp_item_t *item);
+
+void
+record_clock(journal_t *journal, game_clock_t old);
+
+/*
+ * Where a map change was: the layout it went to, or NULL if that didn't
+ * change, and its next word. Takes ownership of layout, which the journal
+ * frees once forgotten
+ */
+void
+record_obstacles(journal_t *journal, bitplane_t *layout, int next_word);
+
+void
+record_obstacle_word(journal_t *journal, int word, uint64_t old);
+
+/* End of a tick, with the state of engine after it */
+void
+record_tick(journal_t *journal, const engine_t *engine);
+
+#endif /* JOURNAL_H */
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef MCTS_H
+#define MCTS_H
+
+#include <game_state.h>
+
+/*
+ * Bot that looks for the move of a snake with a Monte Carlo tree search:
+ * the workers of a thread pool play games from the position at random,
+ * each on its own copy, and share a tree of statistics of the moves of
+ * every snake (decoupled, as they move at once) updated with atomics.
+ * A worker going down the tree counts its moves as lost until its game
+ * ends (virtual loss), so the others spread over other moves meanwhile
+ */
+typedef struct mcts_s mcts_t;
+
+/*
+ * Initialize a bot searching with n_workers threads
+ */
+mcts_t*
+init_mcts(int n_workers);
+
+/*
+ * Start searching in the background the move of player in state for at
+ * most budget milliseconds. state can be deallocated after this
+ */
+void
+start_mcts(mcts_t *mcts, const game_state_t *state, int player,
+		game_clock_t budget);
+
+/*
+ * Stop the search if it's still going and return the best move found
+ */
+direction_t
+finish_mcts(mcts_t *mcts);
+
+/*
+ * Return the games played at random in the last search
+ */
+unsigned long
+mcts_rollouts(const mcts_t *mcts);
+
+/*
+ * Deallocate mcts, which must not be searching
+ */
+void
+delete_mcts(mcts_t *mcts);
+
+#endif /* MCTS_H */
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef MINIMAP_H
+#define MINIMAP_H
+
+#include <field.h>
+
+/*
+ * What a block of the minimap shows: the most important thing in it
+ */
+typedef enum
+{
+	MINIMAP_EMPTY,
+	MINIMAP_OBSTACLE,  /* Incl. borders */
+	MINIMAP_BODY,
+	MINIMAP_ITEM,
+	MINIMAP_FOOD,
+	MINIMAP_HEAD2,
+	MINIMAP_HEAD,
+	MINIMAP_PRIORITIES,  /* Number of priorities, not a priority */
+} minimap_priority_t;
+
+/*
+ * The field reduced to rows x cols blocks of block_height x block_width
+ * cells each
+ */
+typedef struct
+{
+	int rows, cols;
+	int block_height, block_width;
+	unsigned char *blocks;  /* [rows * cols], minimap_priority_t */
+	unsigned char *dirty;   /* [rows * cols], blocks to be computed again */
+} minimap_t;
+
+
+/*
+ * Initialize a minimap of field with at most max_rows x max_cols blocks.
+ * Blocks are as square as that allows
+ */
+minimap_t*
+init_minimap(field_t *field, int max_rows, int max_cols);
+
+/*
+ * Compute again the blocks touched by the damage of field, and reset it
+ */
+void
+update_minimap(minimap_t *minimap, field_t *field);
+
+/*
+ * Deallocate minimap
+ */
+void
+delete_minimap(minimap_t *minimap);
+
+#endif /* MINIMAP_H */
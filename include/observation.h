@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef OBSERVATION_H
+#define OBSERVATION_H
+
+#include <engine.h>
+#include <vec_env.h>
+#include <stddef.h>
+
+/*
+ * Planes of an observation, each one telling which cells hold something
+ */
+typedef enum
+{
+	PLANE_WALLS,  /* Borders and obstacles, also what's outside the field */
+	PLANE_OWN_BODY,
+	PLANE_OWN_HEAD,
+	PLANE_OTHER_HEAD,
+	PLANE_FOOD,
+	PLANE_SHORTENER,
+	PLANE_DECELERATOR,
+	PLANE_EXTRA_POINTS,
+	PLANE_OTHER_BODY,
+	PLANES,  /* Number of planes, not a plane */
+} plane_t;
+
+typedef enum
+{
+	OBSERVATION_BYTES,  /* A byte per cell, 0 or 1 */
+	OBSERVATION_BITS,   /* A bit per cell, rows start on their own 64 bit word.
+	                       The buffer must be aligned to 8 bytes */
+} observation_format_t;
+
+/*
+ * What an observation looks like: a window of height x width cells of the
+ * field, either centered on the head of the player (egocentric) or with
+ * its top left corner on the one of the field. The buffer holds the planes
+ * one after the other, each of them row after row
+ */
+typedef struct
+{
+	observation_format_t format;
+	int height, width;
+	int egocentric;
+} observation_spec_t;
+
+
+/*
+ * Return the bytes of a row of a plane following spec
+ */
+size_t
+observation_row_size(const observation_spec_t *spec);
+
+/*
+ * Return the bytes of a whole observation following spec
+ */
+size_t
+observation_size(const observation_spec_t *spec);
+
+/*
+ * Write what player sees of the game in engine into out, which must hold
+ * observation_size(spec) bytes
+ */
+void
+encode_observation(const observation_spec_t *spec, const engine_t *engine,
+		int player, void *out);
+
+/*
+ * Write the observation of every game of env into out, one after the
+ * other, which must hold env->n_envs * observation_size(spec) bytes
+ */
+void
+encode_vec_observations(const observation_spec_t *spec, const vec_env_t *env,
+		void *out);
+
+#endif /* OBSERVATION_H */
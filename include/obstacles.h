@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef OBSTACLES_H
+#define OBSTACLES_H
+
+#include <bitplane.h>
+#include <stdint.h>
+
+typedef enum
+{
+	LAYOUT_UNIFORM,  /* Independent random cells */
+	LAYOUT_CAVES,    /* Blobs grown by a cellular automaton */
+	LAYOUT_MAZE,     /* Corridors between walls on a lattice */
+	LAYOUT_ARENA,    /* Blocks mirrored on both axes */
+} obstacle_layout_t;
+
+typedef struct obstacle_plan_s obstacle_plan_t;
+
+/*
+ * Fill the interior (everything but the outer ring) of a cleared plane with
+ * obstacles following layout, using seed as randomness. permill_obstacles
+ * is the amount of obstacles for uniform and arena layouts, the starting
+ * noise for caves and 1000/permill sets the spacing of the maze walls.
+ * All the free cells of the result are connected: mazes are built that
+ * way, and in the rest obstacles between regions are opened and
+ * unreachable pockets are filled
+ */
+void
+generate_obstacles(bitplane_t *plane, obstacle_layout_t layout,
+		int permill_obstacles, uint64_t seed);
+
+/*
+ * Return the layout called name (uniform, caves, maze or arena) or -1 if
+ * there's none
+ */
+int
+parse_obstacle_layout(const char *name);
+
+/*
+ * Start computing in the background a new obstacle layout for a
+ * height x width map
+ */
+obstacle_plan_t*
+start_obstacle_plan(int height, int width, obstacle_layout_t layout,
+		int permill_obstacles, uint64_t seed);
+
+/*
+ * Wait for the plan to be ready, deallocate it and return the layout
+ */
+bitplane_t*
+finish_obstacle_plan(obstacle_plan_t *plan);
+
+#endif /* OBSTACLES_H */
@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef RECORDER_H
+#define RECORDER_H
+
+/*
+ * Recording of everything written to stdout, as an asciicast v2 file
+ */
+typedef struct recorder_s recorder_t;
+
+/*
+ * Start recording stdout into the file at path. stdout is replaced by a
+ * pipe whose bytes go on to the terminal and, with their timestamps, to
+ * the file. Must be called before curses takes the terminal. Return NULL
+ * if the recording can't be started
+ */
+recorder_t*
+start_recording(const char *path);
+
+/*
+ * Give stdout back to the terminal and write what's left of the
+ * recording. Return 0 if some of it couldn't be written. Return 1 in
+ * success
+ */
+int
+finish_recording(recorder_t *recorder);
+
+#endif /* RECORDER_H */
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+/*
+ * Small pseudo random generator (splitmix64). Unlike rand() every rng_t
+ * keeps its own state, so it can be used from worker threads and gives the
+ * same sequence for the same seed on every platform
+ */
+typedef struct
+{
+	uint64_t state;
+} rng_t;
+
+/*
+ * Set the starting state of rng
+ */
+void
+seed_rng(rng_t *rng, uint64_t seed);
+
+/*
+ * Return the next 64 random bits
+ */
+uint64_t
+next_rng(rng_t *rng);
+
+/*
+ * Return a random number in [0, n). n must be greater than 0
+ */
+uint32_t
+rng_below(rng_t *rng, uint32_t n);
+
+#endif /* RNG_H */
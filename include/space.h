@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPACE_H
+#define SPACE_H
+
+#include <field.h>
+
+/*
+ * Measures how much room each move of a snake leaves it: the passable
+ * cells reachable from each neighbour of its head. The map is packed into
+ * a bitplane of passable cells and flooded from each neighbour a word (64
+ * cells) at a time, filling whole runs of a row at once and going down
+ * and up the rows until nothing changes. Works on any map kept as a plain
+ * array of cells with borders all around, like the ones of field_t,
+ * game_state_t and vec_env_t
+ */
+typedef struct space_s space_t;
+
+/*
+ * Initialize the planes to measure maps of height x width
+ */
+space_t*
+init_space(int height, int width);
+
+/*
+ * Write in room[d] how many passable cells can be reached from the
+ * neighbour of cell head in the direction d (a direction_t), counting the
+ * neighbour, or 0 if it isn't passable. Neighbours in the same region
+ * share the count
+ */
+void
+measure_space(space_t *space, const cell_byte_t *map, int head, int room[4]);
+
+/*
+ * Deallocate space
+ */
+void
+delete_space(space_t *space);
+
+#endif /* SPACE_H */
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stddef.h>
+
+/*
+ * Lock-free ring of fixed size slots between exactly one producer thread
+ * and one consumer thread. Slots are written and read in place
+ */
+typedef struct spsc_ring_s spsc_ring_t;
+
+/*
+ * Initialize a ring of capacity slots of at least slot_size bytes, each
+ * one aligned for any type
+ */
+spsc_ring_t*
+init_spsc_ring(size_t capacity, size_t slot_size);
+
+/*
+ * Producer: return the next free slot, or NULL if the ring is full. It
+ * isn't visible to the consumer until push_slot
+ */
+void*
+peek_free_slot(spsc_ring_t *ring);
+
+/*
+ * Producer: publish the slot returned by peek_free_slot
+ */
+void
+push_slot(spsc_ring_t *ring);
+
+/*
+ * Consumer: return the oldest published slot, or NULL if the ring is empty
+ */
+void*
+peek_full_slot(spsc_ring_t *ring);
+
+/*
+ * Consumer: give back every published slot but the newest one and return
+ * it, or NULL if the ring is empty
+ */
+void*
+skip_to_last_slot(spsc_ring_t *ring);
+
+/*
+ * Consumer: give back the slot returned by peek_full_slot or
+ * skip_to_last_slot
+ */
+void
+pop_slot(spsc_ring_t *ring);
+
+/*
+ * Deallocate ring
+ */
+void
+delete_spsc_ring(spsc_ring_t *ring);
+
+#endif /* SPSC_RING_H */
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+/*
+ * Fixed set of threads that run the same job together, e.g. each one on
+ * its own slice of a batch. The thread calling run_thread_pool is one of
+ * the workers, so a pool of 1 worker runs everything in the caller
+ */
+typedef struct thread_pool_s thread_pool_t;
+
+/*
+ * Job of a worker, numbered from 0 (the caller) to n_workers - 1
+ */
+typedef void (*pool_job_t)(void *arg, int worker, int n_workers);
+
+/*
+ * Initialize a pool of n_workers, starting n_workers - 1 threads. If some
+ * can't be created the pool has fewer workers
+ */
+thread_pool_t*
+init_thread_pool(int n_workers);
+
+/*
+ * Return the number of workers of pool
+ */
+int
+pool_workers(const thread_pool_t *pool);
+
+/*
+ * Run job(arg) once in every worker and wait for all of them to finish
+ */
+void
+run_thread_pool(thread_pool_t *pool, pool_job_t job, void *arg);
+
+/*
+ * Stop the threads and deallocate pool
+ */
+void
+delete_thread_pool(thread_pool_t *pool);
+
+#endif /* THREAD_POOL_H */
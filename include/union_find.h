@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef UNION_FIND_H
+#define UNION_FIND_H
+
+/*
+ * Disjoint sets over an int array "parent". Roots hold minus the size of
+ * their set and every other node the index of its parent, so a fresh
+ * singleton is -1
+ */
+
+/*
+ * Return the root of the set of i, halving paths on the way
+ */
+int
+find_root(int *parent, int i);
+
+/*
+ * Join the sets of a and b, returning the root of the result
+ */
+int
+unite(int *parent, int a, int b);
+
+#endif /* UNION_FIND_H */
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VEC_ENV_H
+#define VEC_ENV_H
+
+#include <arguments_parser.h>
+#include <bitplane.h>
+#include <game_state.h>
+#include <thread_pool.h>
+
+/*
+ * Obstacle layouts generated when the batch is initialized. Games start
+ * and change their map with one of them instead of generating a new one
+ */
+#define VEC_ENV_LAYOUTS 64
+
+/*
+ * Batch of independent one player games with the rules of the engine, for
+ * training bots: every call steps all of them, and a game that ends starts
+ * over right away. Each game is a game_state_t, all of them one after
+ * another in a single block, and the games are split in contiguous slices
+ * between the workers of a thread pool. Ticks take game time (the delay of
+ * each game) instead of waiting for it
+ */
+typedef struct
+{
+	const arguments_t *args;
+	int n_envs;
+	int height, width, cells;
+	thread_pool_t *pool;
+	int lockstep;  /* Step several games at once with AVX2, set if the CPU can */
+
+	unsigned char *states;    /* [n_envs * state_size], state of each game */
+	size_t state_size;        /* Bytes from a state to the next one */
+	cell_byte_t *layouts;     /* [VEC_ENV_LAYOUTS * cells], maps without snake */
+	int **queue;              /* [cells] for each worker, for flood fills */
+
+	/* Arguments of the step in progress */
+	const int *actions;
+	float *rewards;
+	unsigned char *dones;
+} vec_env_t;
+
+
+/*
+ * Initialize n_envs games following args, which must outlive them, stepped
+ * by n_workers threads (the caller included). seed makes the whole batch
+ * reproducible. Return NULL if args asks for two players
+ */
+vec_env_t*
+init_vec_env(const arguments_t *args, int n_envs, int n_workers,
+		uint64_t seed);
+
+/*
+ * Return the state of game
+ */
+game_state_t*
+vec_env_game(const vec_env_t *env, int game);
+
+/*
+ * Start every game over
+ */
+void
+reset_vec_env(vec_env_t *env);
+
+/*
+ * Run a tick of every game i steering its snake to actions[i] (a
+ * direction_t, or -1 to keep going). rewards[i] gets the points won, or
+ * REWARD_DEATH if the snake died, and dones[i] whether the game ended, in
+ * which case it was started over
+ */
+void
+step_vec_env(vec_env_t *env, const int *actions, float *rewards,
+		unsigned char *dones);
+
+/*
+ * Deallocate env
+ */
+void
+delete_vec_env(vec_env_t *env);
+
+#endif /* VEC_ENV_H */
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VIDEO_H
+#define VIDEO_H
+
+#include <field.h>
+#include <stdio.h>
+
+typedef enum
+{
+	VIDEO_Y4M,  /* YUV4MPEG2 with 4:4:4 planes */
+	VIDEO_PPM,  /* Binary PPM images one after another */
+} video_format_t;
+
+/*
+ * Raw video stream of a field, each cell drawn as a square of scale x
+ * scale pixels
+ */
+typedef struct
+{
+	FILE *file;
+	video_format_t format;
+	int scale;
+	int width, height;     /* Pixels */
+	unsigned char *frame;  /* Whole frame as written, header included */
+	size_t frame_size, header_size;
+	unsigned char palette[3][CELL_TYPES];  /* Y, U, V or R, G, B of each cell type */
+	unsigned char *runs;   /* [CELL_TYPES][scale] RGB pixels of each cell type */
+	int failed;            /* Some write went wrong */
+} video_t;
+
+
+/*
+ * Open a video at path for a field of field_height x field_width cells.
+ * The format is Y4M if path ends in ".y4m", else PPM. Frames are meant to
+ * be shown fps_num / fps_den per second. Return NULL if it can't be opened
+ */
+video_t*
+open_video(const char *path, int field_height, int field_width, int scale,
+		int fps_num, int fps_den);
+
+/*
+ * Write the cells of the field as the next frame
+ */
+void
+write_video_frame(video_t *video, const cell_byte_t *cells);
+
+/*
+ * Close the video. Return 0 if some frame couldn't be written. Return 1
+ * in success
+ */
+int
+close_video(video_t *video);
+
+#endif /* VIDEO_H */
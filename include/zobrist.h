@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include <snake.h>
+#include <stdint.h>
+
+/*
+ * Keys of the Zobrist hash of a game: the hash is the XOR of the keys of
+ * everything in it, so a change only takes out the key of the old value
+ * and puts in the one of the new. Keys are a function of their arguments
+ * instead of a random table, so every machine gets the same hashes
+ */
+
+/*
+ * Return the key of the cell y * width + x having type
+ */
+uint64_t
+zobrist_cell(int cell, cell_t type);
+
+/*
+ * Return the key of a temporal item in cell lasting until destruction
+ */
+uint64_t
+zobrist_item(int cell, game_clock_t destruction);
+
+/*
+ * Return the key of player heading to direction with score
+ */
+uint64_t
+zobrist_player(int player, direction_t direction, unsigned int score);
+
+#endif /* ZOBRIST_H */
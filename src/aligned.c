@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <aligned.h>
+#include <stdlib.h>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+void*
+aligned_malloc(size_t alignment, size_t size)
+{
+#ifdef _WIN32
+	return (_aligned_malloc(size, alignment));
+#else
+	/* aligned_alloc wants a size that is a multiple of the alignment */
+	return (aligned_alloc(alignment, (size + alignment - 1) / alignment *
+				alignment));
+#endif
+}
+
+void
+aligned_free(void *ptr)
+{
+#ifdef _WIN32
+	_aligned_free(ptr);
+#else
+	free(ptr);
+#endif
+}
@@ -16,8 +16,10 @@
  */
 
 #include <arguments_parser.h>
+#include <bot_protocol.h>
 #include <config.h>
 #include <getopt.h>
+#include <obstacles.h>
 #include <stdlib.h>
 #include <stdio.h>
 
@@ -32,11 +34,16 @@ init_arguments()
 	args->height = -1;
 	args->width = -1;
 	args->use_terminal_dimensions = 0;
+	args->half_blocks = 0;
+	args->minimap = 0;
 	args->permill_obstacles = -1;
+	args->obstacle_layout = LAYOUT_UNIFORM;
 	args->starting_delay = -1;
 	args->minimum_delay = -1;
 	args->step_delay = -1;
 	args->two_players = 0;
+	args->ai_opponent = 0;
+	args->autopilot = 0;
 	args->duration_shortener = -1;
 	args->duration_decelerator = -1;
 	args->duration_extra_points = -1;
@@ -45,6 +52,11 @@ init_arguments()
 	args->probability_extra_points = -1;
 	args->score_step_map_change = -1;
 	args->disable_map_change = 0;
+	args->export_video = NULL;
+	args->video_scale = -1;
+	args->asciicast = NULL;
+	args->input = NULL;
+	args->bot_protocol = -1;
 
 	return (args);
 }
@@ -61,6 +73,10 @@ display_help(char *executable)
 	puts("\nSnake Curses game");
 	puts("\nPlayers:");
 	printf("\t%-*sEnable two players mode\n", OPT_WIDTH, "-2, --two-players");
+	printf("\t%-*sPlay two players mode against the computer\n", OPT_WIDTH,
+			"-A, --ai-opponent");
+	printf("\t%-*sThe computer plays alone, over a cycle of the map\n",
+			OPT_WIDTH, "-z, --autopilot");
 	puts("\nSize:");
 	printf("\t%-*sMap dimensions following terminal size\n", OPT_WIDTH,
 			"-t, --use-terminal-dimensions");
@@ -69,9 +85,23 @@ display_help(char *executable)
 			"-H, --height <height>", DEFAULT_W_GAME_HEIGHT);
 	printf("\t%-*sSet width of the map (Def: %d)\n", OPT_WIDTH,
 			"-W, --width <width>", DEFAULT_W_GAME_WIDTH);
+	puts("\nDisplay:");
+	printf("\t%-*sDraw two rows of the map per terminal row (Unicode)\n",
+			OPT_WIDTH, "-b, --half-blocks");
+	printf("\t%-*sShow a minimap of the field instead of the keys\n",
+			OPT_WIDTH, "-M, --minimap");
 	puts("\nObstacles:");
 	printf("\t%-*sSet permill of obstacles in the map (Def: %d)\n", OPT_WIDTH,
 			"-o, --obstacles <permill>", DEFAULT_PERMILL_OBSTACLES);
+	printf("\t%-*sSet layout of the obstacles (Def: uniform):\n",
+			OPT_WIDTH, "-L, --obstacle-layout <layout>");
+	printf("\t%-*s  uniform: scattered cells\n", OPT_WIDTH, "");
+	printf("\t%-*s  caves: permill is the starting noise (Def: %d)\n",
+			OPT_WIDTH, "", DEFAULT_PERMILL_CAVES);
+	printf("\t%-*s  maze: walls 1000/permill cells apart (Def: %d)\n",
+			OPT_WIDTH, "", DEFAULT_PERMILL_MAZE);
+	printf("\t%-*s  arena: mirrored blocks (Def: %d)\n",
+			OPT_WIDTH, "", DEFAULT_PERMILL_ARENA);
 	puts("\nDelay:");
 	printf("\t%-*sSet starting delay in milliseconds (Def: %d)\n", OPT_WIDTH,
 			"-s, --starting-delay <ms>", DEFAULT_STARTING_DELAY);
@@ -79,6 +109,17 @@ display_help(char *executable)
 			"-m, --minimum-delay <ms>", DEFAULT_MINIMUM_DELAY);
 	printf("\t%-*sSet reduction of delay in milliseconds when eating food (Def: %d)\n",
 			OPT_WIDTH, "-S, --step-delay <ms>", DEFAULT_STEP_DELAY);
+	puts("\nInput:");
+	printf("\t%-*sAlso take commands from file, or only from stdin if -\n",
+			OPT_WIDTH, "-i, --input <file|->");
+	printf("\t%-*s  one per line: <tick> <command> [player]\n", OPT_WIDTH, "");
+	printf("\t%-*s  or @<ms> <command> [player], commands: up, down,\n",
+			OPT_WIDTH, "");
+	printf("\t%-*s  left, right, quit\n", OPT_WIDTH, "");
+	printf("\t%-*sPlay without terminal through JSON lines in stdin and\n",
+			OPT_WIDTH, "-B, --bot-protocol <full|delta>");
+	printf("\t%-*sstdout, sending the whole map or only changes\n",
+			OPT_WIDTH, "");
 	puts("\nTemporal items duration:");
 	printf("\t%-*sSet duration of decelerators in seconds (Def: %d)\n",
 			OPT_WIDTH, "-d, --duration-decelerator <s>", DEFAULT_DURATION_DECELERATOR);
@@ -100,6 +141,14 @@ display_help(char *executable)
 	printf("\t%-*sSet the step of score between map changes (Def: %d)\n", OPT_WIDTH,
 			"-c, --score-step-map-change <score>", DEFAULT_SCORE_STEP_MAP_CHANGE);
 	printf("\t%-*sDisable map changing\n", OPT_WIDTH,	"-C, --disable-map-change");
+	puts("\nRecording:");
+	printf("\t%-*sWrite each tick as a frame of a Y4M video if file ends\n",
+			OPT_WIDTH, "-v, --export-video <file>");
+	printf("\t%-*sin .y4m, else of a stream of PPM images\n", OPT_WIDTH, "");
+	printf("\t%-*sSet pixels per cell side in the video (Def: %d)\n",
+			OPT_WIDTH, "-x, --video-scale <pixels>", DEFAULT_VIDEO_SCALE);
+	printf("\t%-*sRecord the terminal as an asciicast v2 file\n",
+			OPT_WIDTH, "-a, --asciicast <file>");
 	printf("\n\t%-*sDisplay this help\n", OPT_WIDTH, "-h, --help");
 }
 
@@ -113,11 +162,16 @@ parse_arguments(int argc, char *argv[])
 		{"use-terminal-dimensions", no_argument, NULL, 't'},
 		{"height", required_argument, NULL, 'H'},
 		{"width", required_argument, NULL, 'W'},
+		{"half-blocks", no_argument, NULL, 'b'},
+		{"minimap", no_argument, NULL, 'M'},
 		{"obstacles", required_argument, NULL, 'o'},
+		{"obstacle-layout", required_argument, NULL, 'L'},
 		{"starting-delay", required_argument, NULL, 's'},
 		{"minimum-delay", required_argument, NULL, 'm'},
 		{"step-delay", required_argument, NULL, 'S'},
 		{"two-players", no_argument, NULL, '2'},
+		{"ai-opponent", no_argument, NULL, 'A'},
+		{"autopilot", no_argument, NULL, 'z'},
 		{"duration-decelerator", required_argument, NULL, 'd'},
 		{"duration-shortener", required_argument, NULL, 'D'},
 		{"duration-extra-points", required_argument, NULL, 'e'},
@@ -126,10 +180,15 @@ parse_arguments(int argc, char *argv[])
 		{"probability-extra-points", required_argument, NULL, 'E'},
 		{"score-step-map-change", required_argument, NULL, 'c'},
 		{"disable-map-change", no_argument, NULL, 'C'},
+		{"export-video", required_argument, NULL, 'v'},
+		{"video-scale", required_argument, NULL, 'x'},
+		{"asciicast", required_argument, NULL, 'a'},
+		{"input", required_argument, NULL, 'i'},
+		{"bot-protocol", required_argument, NULL, 'B'},
 		{"help", no_argument, NULL, 'h'},
 		{0, 0, 0, 0}
 	};
-	while ((op = getopt_long(argc, argv, ":tH:W:o:s:m:S:2d:D:e:p:P:E:c:Ch",
+	while ((op = getopt_long(argc, argv, ":tH:W:bMo:L:s:m:S:2Azd:D:e:p:P:E:c:Cv:x:a:i:B:h",
 					long_options, NULL)) != -1)
 	{
 		switch (op)
@@ -143,9 +202,24 @@ parse_arguments(int argc, char *argv[])
 			case 'W':
 				args->width = atoi(optarg);
 				break;
+			case 'b':
+				args->half_blocks = 1;
+				break;
+			case 'M':
+				args->minimap = 1;
+				break;
 			case 'o':
 				args->permill_obstacles = atoi(optarg);
 				break;
+			case 'L':
+				args->obstacle_layout = parse_obstacle_layout(optarg);
+				if (args->obstacle_layout == -1)
+				{
+					fputs("Unknown obstacle layout\n", stderr);
+					delete_arguments(args);
+					exit(1);
+				}
+				break;
 			case 's':
 				args->starting_delay = atoi(optarg);
 				break;
@@ -158,6 +232,13 @@ parse_arguments(int argc, char *argv[])
 			case '2':
 				args->two_players = 1;
 				break;
+			case 'A':
+				args->two_players = 1;
+				args->ai_opponent = 1;
+				break;
+			case 'z':
+				args->autopilot = 1;
+				break;
 			case 'D':
 				args->duration_shortener = atoi(optarg);
 				break;
@@ -182,6 +263,33 @@ parse_arguments(int argc, char *argv[])
 			case 'C':
 				args->disable_map_change = 1;
 				break;
+			case 'v':
+				args->export_video = optarg;
+				break;
+			case 'x':
+				args->video_scale = atoi(optarg);
+				if (args->video_scale <= 0)
+				{
+					fputs("Video scale must be a positive number\n", stderr);
+					delete_arguments(args);
+					exit(1);
+				}
+				break;
+			case 'a':
+				args->asciicast = optarg;
+				break;
+			case 'i':
+				args->input = optarg;
+				break;
+			case 'B':
+				args->bot_protocol = parse_bot_protocol(optarg);
+				if (args->bot_protocol == -1)
+				{
+					fputs("Unknown bot protocol mode\n", stderr);
+					delete_arguments(args);
+					exit(1);
+				}
+				break;
 			case 'h':
 				display_help(argv[0]);
 				delete_arguments(args);
@@ -209,6 +317,30 @@ parse_arguments(int argc, char *argv[])
 		exit(1);
 	}
 
+	if (args->use_terminal_dimensions && args->bot_protocol != -1)
+	{
+		fputs("--use-terminal-dimensions incompatible with ", stderr);
+		fputs("--bot-protocol argument\n", stderr);
+		delete_arguments(args);
+		exit(1);
+	}
+
+	if (args->ai_opponent && args->bot_protocol != -1)
+	{
+		fputs("--ai-opponent incompatible with --bot-protocol argument\n",
+				stderr);
+		delete_arguments(args);
+		exit(1);
+	}
+
+	if (args->autopilot && (args->two_players || args->bot_protocol != -1))
+	{
+		fputs("--autopilot incompatible with --two-players, ", stderr);
+		fputs("--ai-opponent and --bot-protocol arguments\n", stderr);
+		delete_arguments(args);
+		exit(1);
+	}
+
 	return (args);
 }
 
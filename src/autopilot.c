@@ -0,0 +1,484 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <autopilot.h>
+#include <flat_map.h>
+#include <space.h>
+#include <string.h>
+
+/* Cells of the cycle shortcuts leave before the tail, room to grow */
+#define SHORTCUT_MARGIN 4
+
+/* Also leave one more cell every SHORTCUT_SLACK of length */
+#define SHORTCUT_SLACK 4
+
+/* Moves the body may take longer to leave a cell than expected, for growth */
+#define REENTRY_MARGIN 2
+
+/* Shortcuts are only taken while the snake is shorter than 1/SHORTCUT_RATIO of the cycle */
+#define SHORTCUT_RATIO 2
+
+struct autopilot_s
+{
+	int height, width, cells;
+	int *order;  /* [cells] Position of each cell in the cycle, -1 if out */
+	int *next;   /* [cells] Next cell in the cycle, -1 if out */
+	int length;  /* Cells in the cycle */
+	bitplane_t *obstacles;  /* Obstacles the cycle was made for */
+	int *queue;  /* [cells] For the groups of blocks */
+	space_t *space;  /* To measure the room of each move */
+	int *leaves;  /* [cells] Moves until the body leaves each cell, if body_mark */
+	unsigned *body_mark;
+	unsigned moves;  /* Calls to autopilot_move, what body_mark holds for the body */
+	unsigned long aligned;  /* Ticks the snake has followed the cycle since it left it */
+	int food;  /* Cell with the food in the last move, -1 if none */
+	unsigned long food_moves;  /* Moves since the food was put there */
+	int dropped;  /* Food given up on in the last move, -1 if none */
+};
+
+/*
+ * Return whether the 2x2 block with its top left corner in (y, x) is free
+ * of obstacles
+ */
+static int
+free_block(const bitplane_t *obstacles, int y, int x)
+{
+	return (!get_bit(obstacles, y, x) && !get_bit(obstacles, y, x + 1) &&
+			!get_bit(obstacles, y + 1, x) && !get_bit(obstacles, y + 1, x + 1));
+}
+
+/*
+ * Return whether cell is inside the borders, free of obstacles and out of
+ * the cycle
+ */
+static int
+free_cell(const autopilot_t *autopilot, int cell)
+{
+	int y = cell / autopilot->width, x = cell % autopilot->width;
+
+	return (y > 0 && y < autopilot->height - 1 && x > 0 && x < autopilot->width - 1 &&
+			!get_bit(autopilot->obstacles, y, x) && autopilot->next[cell] == -1);
+}
+
+/*
+ * Make the cycle around a spanning tree of the largest group of connected
+ * free blocks. Each block alone is a cycle of its 4 cells going
+ * counterclockwise; every edge of the tree joins the cycles of its two
+ * blocks by swapping the two facing sides for two crossings
+ */
+static void
+build_cycle(autopilot_t *autopilot)
+{
+	const bitplane_t *obstacles = autopilot->obstacles;
+	int w = autopilot->width, rows = (autopilot->height - 2) / 2;
+	int cols = (autopilot->width - 2) / 2, n_blocks = rows * cols;
+	int *parent = malloc(sizeof(int) * (n_blocks ? n_blocks : 1));
+	int *queue = autopilot->queue, head, tail, size, best = -1, best_size = 0;
+	int b, a, c, y, x, neighbours[4], tl, cell, step, spliced;
+
+	for (int i = 0; i < autopilot->cells; i++)
+	{
+		autopilot->order[i] = -1;
+		autopilot->next[i] = -1;
+	}
+	autopilot->length = 0;
+
+	/* Groups of free blocks, parent -2 for blocks with obstacles */
+	for (b = 0; b < n_blocks; b++)
+		parent[b] = free_block(obstacles, 1 + b / cols * 2, 1 + b % cols * 2) ?
+			-1 : -2;
+	for (int start = 0; start < n_blocks; start++)
+	{
+		if (parent[start] != -1)
+			continue;
+		parent[start] = start;
+		queue[0] = start;
+		for (head = 0, tail = 1; head < tail; head++)
+		{
+			b = queue[head];
+			neighbours[0] = b >= cols ? b - cols : -1;
+			neighbours[1] = b % cols < cols - 1 ? b + 1 : -1;
+			neighbours[2] = b % cols > 0 ? b - 1 : -1;
+			neighbours[3] = b + cols < n_blocks ? b + cols : -1;
+			for (int k = 0; k < 4; k++)
+			{
+				if ((c = neighbours[k]) != -1 && parent[c] == -1)
+				{
+					parent[c] = b;
+					queue[tail++] = c;
+				}
+			}
+		}
+		size = tail;
+		if (size > best_size)
+		{
+			best_size = size;
+			best = start;
+		}
+	}
+	if (best == -1)
+	{
+		free(parent);
+		return;
+	}
+
+	/* Blocks of the group by themselves, then joined along the tree */
+	for (b = 0; b < n_blocks; b++)
+	{
+		for (c = b; parent[c] >= 0 && parent[c] != c; c = parent[c])
+			;
+		if (c != best)
+			continue;
+		tl = (1 + b / cols * 2) * w + 1 + b % cols * 2;
+		autopilot->next[tl] = tl + w;
+		autopilot->next[tl + w] = tl + w + 1;
+		autopilot->next[tl + w + 1] = tl + 1;
+		autopilot->next[tl + 1] = tl;
+	}
+	for (b = 0; b < n_blocks; b++)
+	{
+		if (parent[b] < 0 || parent[b] == b ||
+				autopilot->next[(1 + b / cols * 2) * w + 1 + b % cols * 2] == -1)
+			continue;
+		a = parent[b] < b ? parent[b] : b;  /* Left or top one */
+		c = parent[b] < b ? b : parent[b];
+		tl = (1 + a / cols * 2) * w + 1 + a % cols * 2;
+		cell = (1 + c / cols * 2) * w + 1 + c % cols * 2;
+		if (c == a + 1)
+		{
+			autopilot->next[tl + w + 1] = cell + w;
+			autopilot->next[cell] = tl + 1;
+		}
+		else
+		{
+			autopilot->next[tl + w] = cell;
+			autopilot->next[cell + 1] = tl + w + 1;
+		}
+	}
+	free(parent);
+
+	/*
+	 * Cells out of the blocks of the group: every two of them side by side
+	 * along two cells that follow each other in the cycle go in between
+	 */
+	do
+	{
+		spliced = 0;
+		for (cell = 0; cell < autopilot->cells; cell++)
+		{
+			if ((c = autopilot->next[cell]) == -1)
+				continue;
+			for (int k = 0; k < 2; k++)
+			{
+				step = c - cell == 1 || c - cell == -1 ? (k ? w : -w) : (k ? 1 : -1);
+				if (free_cell(autopilot, cell + step) &&
+						free_cell(autopilot, c + step))
+				{
+					autopilot->next[cell] = cell + step;
+					autopilot->next[cell + step] = c + step;
+					autopilot->next[c + step] = c;
+					spliced = 1;
+					break;
+				}
+			}
+		}
+	}
+	while (spliced);
+
+	/* Positions in the cycle */
+	y = 1 + best / cols * 2;
+	x = 1 + best % cols * 2;
+	cell = y * w + x;
+	do
+	{
+		autopilot->order[cell] = autopilot->length++;
+		cell = autopilot->next[cell];
+	}
+	while (cell != y * w + x);
+}
+
+/*
+ * Return whether following the cycle from cell, entered on the next move,
+ * stays out of the body for "moves" moves
+ */
+static int
+clear_ahead(const autopilot_t *autopilot, const cell_byte_t *cells, int cell,
+		int moves)
+{
+	for (int s = 1; s <= moves; s++, cell = autopilot->next[cell])
+	{
+		if (autopilot->body_mark[cell] == autopilot->moves)
+		{
+			if (autopilot->leaves[cell] + REENTRY_MARGIN >= s)
+				return (0);
+		}
+		else if (!flat_passable[cells[cell]])
+			return (0);
+	}
+	return (1);
+}
+
+/*
+ * Return a cell of the cycle next to cell, other than from, where following
+ * the cycle after going through cell doesn't run into the body. -1 if none
+ */
+static int
+reentry(const autopilot_t *autopilot, const cell_byte_t *cells, int cell,
+		int from, int length)
+{
+	const int w = autopilot->width, offsets[4] = {-w, 1, -1, w};
+	int next, ahead = length + REENTRY_MARGIN < autopilot->length ?
+		length + REENTRY_MARGIN : autopilot->length;
+
+	for (int k = 0; k < 4; k++)
+	{
+		next = cell + offsets[k];
+		if (next != from && autopilot->order[next] != -1 &&
+				clear_ahead(autopilot, cells, next, ahead))
+			return (next);
+	}
+	return (-1);
+}
+
+/*
+ * Move from head back into the cycle where following it doesn't run into
+ * the body, or else the one with most room, if the room fits the snake,
+ * towards the food if chasing it out of the cycle. -1 if all crash
+ */
+static int
+fallback_move(autopilot_t *autopilot, const cell_byte_t *cells, int head,
+		int food, int length)
+{
+	const int w = autopilot->width, offsets[4] = {-w, 1, -1, w};
+	int next, room, best = -1, towards, clear, ahead, rooms[4];
+	long long score, best_score = -1;
+
+	measure_space(autopilot->space, cells, head, rooms);
+	ahead = length + REENTRY_MARGIN < autopilot->length ?
+		length + REENTRY_MARGIN : autopilot->length;
+	for (int d = 0; d < 4; d++)
+	{
+		next = head + offsets[d];
+		if (!flat_passable[cells[next]])
+			continue;
+		room = rooms[d];
+		clear = food == -1 && autopilot->order[next] != -1 &&
+			clear_ahead(autopilot, cells, next, ahead);
+		towards = food == -1 ? autopilot->order[next] != -1 :
+			(1 << 19) - abs(next / w - food / w) - abs(next % w - food % w);
+		score = ((long long)clear << 50) + ((long long)(room > length) << 40) +
+			((long long)towards << 20) + (room < (1 << 20) ? room : (1 << 20) - 1);
+		if (score > best_score)
+		{
+			best_score = score;
+			best = next;
+		}
+	}
+	return (best);
+}
+
+autopilot_t*
+init_autopilot(const engine_t *engine)
+{
+	const field_t *field = engine->field;
+	autopilot_t *autopilot = malloc(sizeof(autopilot_t));
+
+	autopilot->height = field->height;
+	autopilot->width = field->width;
+	autopilot->cells = field->height * field->width;
+	autopilot->order = malloc(sizeof(int) * autopilot->cells);
+	autopilot->next = malloc(sizeof(int) * autopilot->cells);
+	autopilot->queue = malloc(sizeof(int) * autopilot->cells);
+	autopilot->space = init_space(field->height, field->width);
+	autopilot->leaves = malloc(sizeof(int) * autopilot->cells);
+	autopilot->body_mark = calloc(autopilot->cells, sizeof(unsigned));
+	autopilot->moves = 0;
+	autopilot->aligned = 0;
+	autopilot->food = -1;
+	autopilot->food_moves = 0;
+	autopilot->dropped = -1;
+	autopilot->obstacles = init_bitplane(field->height, field->width);
+	memcpy(autopilot->obstacles->words, field->obstacles->words,
+			sizeof(uint64_t) * field->obstacles->stride * field->height);
+	build_cycle(autopilot);
+	return (autopilot);
+}
+
+direction_t
+autopilot_move(autopilot_t *autopilot, const engine_t *engine, int player)
+{
+	const field_t *field = engine->field;
+	const snake_t *snake = engine->snakes[player];
+	const cell_byte_t *found;
+	size_t words = sizeof(uint64_t) * field->obstacles->stride * field->height;
+	const int w = autopilot->width, offsets[4] = {-w, 1, -1, w};
+	int cycle = autopilot->length, length = 0, target = -1, chase = 0, goal = -1;
+	int head = snake->head->y * w + snake->head->x, ways = 0, beside = 0;
+	int tail = snake->tail->y * w + snake->tail->x, food, limit, reach, rel, next;
+
+	/* The obstacles changed since the cycle was made */
+	if (memcmp(autopilot->obstacles->words, field->obstacles->words, words))
+	{
+		memcpy(autopilot->obstacles->words, field->obstacles->words, words);
+		build_cycle(autopilot);
+		autopilot->aligned = 0;
+		cycle = autopilot->length;
+	}
+
+	/* When each cell of the body will be left behind */
+	autopilot->moves++;
+	for (const body_t *node = snake->tail; node; node = node->next)
+	{
+		next = node->y * w + node->x;
+		autopilot->body_mark[next] = autopilot->moves;
+		autopilot->leaves[next] = ++length;
+	}
+
+	found = memchr(field->cells, FOOD, (size_t)autopilot->cells);
+	food = found ? (int)(found - field->cells) : -1;
+	if (food != autopilot->food)
+	{
+		autopilot->food = food;
+		autopilot->food_moves = 0;
+	}
+	else
+		autopilot->food_moves++;
+	autopilot->dropped = -1;
+
+	/*
+	 * Food out of the cycle is taken when it's next to the head and there's
+	 * a way back into the cycle after it. Else the cycle leads to goal, the
+	 * first cell of the cycle ahead next to the food. Leaving the cycle to
+	 * chase it gets long snakes trapped, so food the cycle doesn't pass by,
+	 * in a dead end or left there for a whole lap is given up on instead.
+	 * It's only chased when there's no cycle at all
+	 */
+	if (food != -1 && autopilot->order[food] == -1)
+	{
+		chase = !cycle;
+		for (int k = 0; k < 4; k++)
+		{
+			next = food + offsets[k];
+			if (field->cells[next] != BORDER && field->cells[next] != OBSTACLE)
+				ways++;
+			if (next == head && reentry(autopilot, field->cells, food, head, length) != -1)
+				target = food;
+			if (autopilot->order[next] == -1)
+				continue;
+			beside = 1;
+			if (autopilot->order[head] != -1 && (goal == -1 ||
+					(autopilot->order[next] - autopilot->order[head] + cycle) % cycle <
+					(autopilot->order[goal] - autopilot->order[head] + cycle) % cycle))
+				goal = next;
+		}
+		if (cycle && target == -1 && (!beside || ways < 2 ||
+					autopilot->food_moves > (unsigned long)cycle))
+		{
+			autopilot->dropped = food;
+			goal = -1;
+		}
+	}
+	else
+		goal = food;
+
+	if (target == -1 && autopilot->order[head] != -1 && !chase)
+	{
+		target = autopilot->next[head];
+
+		/*
+		 * Shortcut: the furthest cell ahead in the cycle that doesn't go
+		 * past the goal or too close to the tail. The body, all of it
+		 * between the tail and the head in the cycle, stays that way
+		 */
+		if (engine->n_players == 1 && autopilot->aligned >= (unsigned long)length &&
+				length * SHORTCUT_RATIO < cycle && autopilot->order[tail] != -1)
+		{
+			limit = (autopilot->order[tail] - autopilot->order[head] + cycle) % cycle -
+				SHORTCUT_MARGIN - length / SHORTCUT_SLACK;
+			if (goal != -1)
+			{
+				rel = (autopilot->order[goal] - autopilot->order[head] + cycle) % cycle;
+				if (rel < limit)
+					limit = rel + 1;
+			}
+			reach = 1;
+			for (int k = 0; k < 4; k++)
+			{
+				next = head + offsets[k];
+				if (autopilot->order[next] == -1 || !flat_passable[field->cells[next]])
+					continue;
+				rel = (autopilot->order[next] - autopilot->order[head] + cycle) % cycle;
+				if (rel < limit && rel > reach)
+				{
+					reach = rel;
+					target = next;
+				}
+			}
+		}
+		if (!flat_passable[field->cells[target]])
+			target = -1;
+
+		/* Back in the cycle, the body may still be ahead */
+		else if (autopilot->aligned < (unsigned long)length &&
+				!clear_ahead(autopilot, field->cells, target,
+					length - (int)autopilot->aligned))
+			target = -1;
+	}
+
+	if (target == -1)
+	{
+		autopilot->aligned = 0;
+		target = fallback_move(autopilot, field->cells, head, chase ? food : -1,
+				length);
+		if (target == -1)
+			return (snake->direction);
+	}
+	else if (autopilot->order[target] != -1)
+		autopilot->aligned++;
+	else
+		autopilot->aligned = 0;
+
+	for (int d = 0; d < 4; d++)
+		if (target == head + offsets[d])
+			return ((direction_t)d);
+	return (snake->direction);
+}
+
+int
+autopilot_dropped_food(const autopilot_t *autopilot)
+{
+	return (autopilot->dropped);
+}
+
+int
+autopilot_cycle_length(const autopilot_t *autopilot)
+{
+	return (autopilot->length);
+}
+
+void
+delete_autopilot(autopilot_t *autopilot)
+{
+	free(autopilot->order);
+	free(autopilot->next);
+	free(autopilot->queue);
+	delete_space(autopilot->space);
+	free(autopilot->leaves);
+	free(autopilot->body_mark);
+	delete_bitplane(autopilot->obstacles);
+	free(autopilot);
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <bitplane.h>
+#include <stdlib.h>
+#include <string.h>
+
+bitplane_t*
+init_bitplane(int height, int width)
+{
+	bitplane_t *plane = malloc(sizeof(bitplane_t));
+
+	plane->height = height;
+	plane->width = width;
+	plane->stride = (width + 63) / 64;
+	plane->words = calloc((size_t)height * plane->stride, sizeof(uint64_t));
+
+	return (plane);
+}
+
+void
+clear_bitplane(bitplane_t *plane)
+{
+	memset(plane->words, 0,
+			sizeof(uint64_t) * (size_t)plane->height * plane->stride);
+}
+
+int
+get_bit(const bitplane_t *plane, int y, int x)
+{
+	return ((int)(plane->words[(size_t)y * plane->stride + x / 64] >> (x % 64) & 1));
+}
+
+void
+set_bit(bitplane_t *plane, int y, int x)
+{
+	plane->words[(size_t)y * plane->stride + x / 64] |= (uint64_t)1 << (x % 64);
+}
+
+void
+reset_bit(bitplane_t *plane, int y, int x)
+{
+	plane->words[(size_t)y * plane->stride + x / 64] &= ~((uint64_t)1 << (x % 64));
+}
+
+int
+lowest_bit(uint64_t word)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return (__builtin_ctzll(word));
+#else
+	int i = 0;
+
+	while (!(word & 1))
+	{
+		word >>= 1;
+		i++;
+	}
+	return (i);
+#endif
+}
+
+int
+highest_bit(uint64_t word)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return (63 - __builtin_clzll(word));
+#else
+	int i = 63;
+
+	while (!(word >> i & 1))
+		i--;
+	return (i);
+#endif
+}
+
+int
+count_bits(uint64_t word)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return (__builtin_popcountll(word));
+#else
+	int n = 0;
+
+	for (; word; n++)
+		word &= word - 1;
+	return (n);
+#endif
+}
+
+void
+delete_bitplane(bitplane_t *plane)
+{
+	free(plane->words);
+	free(plane);
+}
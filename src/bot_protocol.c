@@ -0,0 +1,290 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <bot_protocol.h>
+#include <engine.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Bytes of the longest line of moves, and of the stdout buffer */
+#define BOT_LINE_SIZE (1 << 16)
+
+/* Character of each cell type in the messages */
+static const char cell_chars[CELL_TYPES] = {
+	[EMPTY] = ' ',
+	[SNAKE] = '#',
+	[HEAD] = '1',
+	[HEAD2] = '2',
+	[FOOD] = 'f',
+	[BORDER] = '*',
+	[OBSTACLE] = 'x',
+	[SHORTENER] = 's',
+	[DECELERATOR] = 'd',
+	[EXTRA_POINTS] = 'e',
+};
+
+static const char *direction_names[] = {"up", "right", "left", "down"};
+
+/*
+ * What the bot has been told so far
+ */
+typedef struct
+{
+	engine_t *engine;
+	bot_protocol_t mode;
+	cell_byte_t *sent;  /* [height * width], the map as of the last message */
+	int *food, n_food;  /* Cells (as y * width + x) with food */
+} bot_t;
+
+/*
+ * Forget the food in cell i, if it's known
+ */
+static void
+forget_food(bot_t *bot, int i)
+{
+	for (int k = 0; k < bot->n_food; k++)
+	{
+		if (bot->food[k] == i)
+		{
+			bot->food[k] = bot->food[--bot->n_food];
+			return;
+		}
+	}
+}
+
+/*
+ * Compare the damaged cells of the field with the ones sent before,
+ * writing the changes as [y, x, "c"] if write_changes, and reset the
+ * damage
+ */
+static void
+take_changes(bot_t *bot, int write_changes)
+{
+	field_t *field = bot->engine->field;
+	cell_byte_t *row, *sent;
+	int first = 1, i;
+
+	for (coord_t y = 0; y < field->height; y++)
+	{
+		row = field->matrix[y];
+		sent = bot->sent + (size_t)y * field->width;
+		for (coord_t x = field->damage_from[y]; x < field->damage_to[y]; x++)
+		{
+			if (row[x] == sent[x])
+				continue;
+
+			i = y * field->width + x;
+			if (sent[x] == FOOD)
+				forget_food(bot, i);
+			if (row[x] == FOOD)
+				bot->food[bot->n_food++] = i;
+			sent[x] = row[x];
+
+			if (write_changes)
+			{
+				printf("%s[%d,%d,\"%c\"]", first ? "" : ",", y, x,
+						cell_chars[row[x]]);
+				first = 0;
+			}
+		}
+		field->damage_from[y] = field->width;
+		field->damage_to[y] = 0;
+	}
+}
+
+/*
+ * Write the whole map as an array of strings, one per row
+ */
+static void
+write_cells(const field_t *field)
+{
+	putchar('[');
+	for (coord_t y = 0; y < field->height; y++)
+	{
+		printf("%s\"", y ? "," : "");
+		for (coord_t x = 0; x < field->width; x++)
+			putchar(cell_chars[field->matrix[y][x]]);
+		putchar('"');
+	}
+	putchar(']');
+}
+
+/*
+ * Write the message with the state of the game after a turn
+ */
+static void
+write_state(bot_t *bot)
+{
+	engine_t *engine = bot->engine;
+	field_t *field = engine->field;
+	temp_item_t *item;
+
+	printf("{\"type\":\"state\",\"tick\":%lu,\"clock\":%lu,\"delay\":%d,",
+			engine->tick, field->clock, engine->delay);
+
+	printf("\"scores\":[");
+	for (int i = 0; i < engine->n_players; i++)
+		printf("%s%u", i ? "," : "", engine->scores[i]);
+
+	printf("],\"heads\":[");
+	for (int i = 0; i < engine->n_players; i++)
+		printf("%s[%d,%d,\"%s\"]", i ? "," : "", engine->snakes[i]->head->y,
+				engine->snakes[i]->head->x,
+				direction_names[engine->snakes[i]->direction]);
+
+	if (bot->mode == BOT_DELTA)
+	{
+		printf("],\"changed\":[");
+		take_changes(bot, 1);
+		putchar(']');
+	}
+	else
+	{
+		take_changes(bot, 0);
+		printf("],\"cells\":");
+		write_cells(field);
+	}
+
+	printf(",\"food\":[");
+	for (int k = 0; k < bot->n_food; k++)
+		printf("%s[%d,%d]", k ? "," : "", bot->food[k] / field->width,
+				bot->food[k] % field->width);
+
+	/* Items, with the milliseconds of game time they have left */
+	printf("],\"items\":[");
+	for (item = field->til; item; item = item->next)
+		printf("%s[%d,%d,\"%c\",%lu]", item == field->til ? "" : ",",
+				item->y, item->x, cell_chars[field->matrix[item->y][item->x]],
+				item->scheduled_destruction - field->clock);
+	printf("]}\n");
+	fflush(stdout);
+}
+
+/*
+ * Take the moves of the next turn from the line of the bot, starting at
+ * *cursor, into moves. Return 0 if the line has no more moves, -1 if it
+ * asks to quit
+ */
+static int
+next_turn(char **cursor, int n_players, int *moves)
+{
+	char *start, *end;
+	int n = 0;
+
+	while (n < n_players && (start = strchr(*cursor, '"')))
+	{
+		if (!(end = strchr(start + 1, '"')))
+			return (0);
+		*end = '\0';
+		*cursor = end + 1;
+
+		if (!strcmp(start + 1, "quit"))
+			return (-1);
+		moves[n] = -1;
+		for (int d = 0; d < 4; d++)
+			if (!strcmp(start + 1, direction_names[d]))
+				moves[n] = d;
+		if (moves[n] != -1 || !strcmp(start + 1, "-"))
+			n++;
+	}
+
+	return (n == n_players);
+}
+
+int
+parse_bot_protocol(const char *name)
+{
+	if (strcmp(name, "full") == 0)
+		return (BOT_FULL);
+	if (strcmp(name, "delta") == 0)
+		return (BOT_DELTA);
+	return (-1);
+}
+
+int
+run_bot_protocol(const arguments_t *args, bot_protocol_t mode)
+{
+	bot_t bot;
+	field_t *field;
+	char *line = malloc(BOT_LINE_SIZE), *cursor;
+	int moves[MAX_PLAYERS], turn, quit = 0;
+
+	setvbuf(stdout, NULL, _IOFBF, BOT_LINE_SIZE);
+	bot.engine = init_engine(args);
+	bot.mode = mode;
+	field = bot.engine->field;
+	bot.sent = malloc(sizeof(cell_byte_t) * field->height * field->width);
+	memcpy(bot.sent, field->cells,
+			sizeof(cell_byte_t) * field->height * field->width);
+	bot.food = malloc(sizeof(int) * field->height * field->width);
+	bot.n_food = 0;
+	for (int i = 0; i < field->height * field->width; i++)
+		if (field->cells[i] == FOOD)
+			bot.food[bot.n_food++] = i;
+	for (coord_t y = 0; y < field->height; y++)
+	{
+		field->damage_from[y] = field->width;
+		field->damage_to[y] = 0;
+	}
+
+	printf("{\"type\":\"start\",\"height\":%d,\"width\":%d,\"players\":%d,"
+			"\"mode\":\"%s\",\"cells\":", field->height, field->width,
+			bot.engine->n_players, mode == BOT_DELTA ? "delta" : "full");
+	write_cells(field);
+	printf("}\n");
+	write_state(&bot);
+
+	/* Each line plays its turns, then the bot gets the state after them */
+	while (bot.engine->running && !quit && fgets(line, BOT_LINE_SIZE, stdin))
+	{
+		cursor = line;
+		while (bot.engine->running &&
+				(turn = next_turn(&cursor, bot.engine->n_players, moves)))
+		{
+			if (turn == -1)
+			{
+				quit = 1;
+				break;
+			}
+			for (int i = 0; i < bot.engine->n_players; i++)
+				if (moves[i] != -1)
+					steer(bot.engine, i, moves[i]);
+			advance_clock(field, (game_clock_t)bot.engine->delay);
+			step_engine(bot.engine, -1);
+		}
+		if (bot.engine->running && !quit)
+			write_state(&bot);
+	}
+
+	printf("{\"type\":\"end\",\"tick\":%lu,\"loser\":", bot.engine->tick);
+	if (bot.engine->loser == -1)
+		printf("null");
+	else
+		printf("%d", bot.engine->loser + 1);
+	printf(",\"scores\":[");
+	for (int i = 0; i < bot.engine->n_players; i++)
+		printf("%s%u", i ? "," : "", bot.engine->scores[i]);
+	printf("]}\n");
+	fflush(stdout);
+
+	delete_engine(bot.engine);
+	free(bot.sent);
+	free(bot.food);
+	free(line);
+	return (0);
+}
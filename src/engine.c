@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <engine.h>
+#include <config.h>
+#include <food_distance.h>
+#include <journal.h>
+#include <zobrist.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+engine_t*
+init_engine(const arguments_t *args)
+{
+	engine_t *engine = malloc(sizeof(engine_t));
+
+	engine->args = args;
+	engine->field = init_field(args->height, args->width, args->obstacle_layout,
+			args->permill_obstacles);
+	engine->n_players = args->two_players ? 2 : 1;
+	engine->snakes[0] = init_snake(engine->field, HEAD);
+	engine->snakes[1] = args->two_players ?
+		init_snake(engine->field, HEAD2) : NULL;
+	add_food(engine->field, engine->snakes[0]->head->y,
+			engine->snakes[0]->head->x);
+
+	engine->scores[0] = 0;
+	engine->scores[1] = 0;
+	engine->score_last_change = 0;
+	engine->delay = args->starting_delay;
+	engine->running = 1;
+	engine->loser = -1;
+	engine->tick = 0;
+
+	return (engine);
+}
+
+void
+steer(engine_t *engine, int player, direction_t direction)
+{
+	if (player < 0 || player >= engine->n_players)
+		return;
+	if (engine->field->journal)
+		record_direction(engine->field->journal, engine->snakes[player],
+				engine->snakes[player]->direction);
+	engine->snakes[player]->direction = direction;
+}
+
+/*
+ * Advance the snake of player and apply the effects of what it ate or hit
+ */
+static void
+move_player(engine_t *engine, int player)
+{
+	const arguments_t *args = engine->args;
+	field_t *field = engine->field;
+	snake_t *snake = engine->snakes[player];
+	unsigned int *score = &engine->scores[player];
+
+	switch (advance(field, snake))
+	{
+		case EMPTY:
+			break;
+		case SNAKE:
+		case HEAD:
+		case HEAD2:
+		case BORDER:
+		case OBSTACLE:
+			engine->loser = player;
+			engine->running = 0;
+			break;
+		case FOOD:
+			add_food(field, snake->head->y, snake->head->x);
+			*score += POINTS_FOOD;
+
+			/* Delay reduction */
+			if (engine->delay > args->minimum_delay)
+				engine->delay -= args->step_delay;
+			else
+				engine->delay = args->minimum_delay;
+
+			/* Items generation */
+			if (rand() % args->probability_shortener == 0)
+				add_temp_item(field, SHORTENER,
+						(game_clock_t)args->duration_shortener * 1000,
+						snake->head->y, snake->head->x);
+			if (rand() % args->probability_decelerator == 0)
+				add_temp_item(field, DECELERATOR,
+						(game_clock_t)args->duration_decelerator * 1000,
+						snake->head->y, snake->head->x);
+			if (rand() % args->probability_extra_points == 0)
+				add_temp_item(field, EXTRA_POINTS,
+						(game_clock_t)args->duration_extra_points * 1000,
+						snake->head->y, snake->head->x);
+			break;
+		case SHORTENER:
+			*score += POINTS_SHORTENER;
+			break;
+		case DECELERATOR:
+			*score += POINTS_DECELERATOR;
+			engine->delay = args->starting_delay;
+			break;
+		case EXTRA_POINTS:
+			*score += POINTS_EXTRA_POINTS;
+			break;
+	}
+
+	/* Map change */
+	if (!args->disable_map_change &&
+			*score >= engine->score_last_change + args->score_step_map_change)
+	{
+		change_obstacles(field);
+		engine->score_last_change = *score;
+	}
+}
+
+void
+step_engine(engine_t *engine, int player)
+{
+	for (int i = 0; i < engine->n_players && engine->running; i++)
+		if (player == -1 || player == i)
+			move_player(engine, i);
+
+	place_obstacles(engine->field);
+	remove_expired_items(engine->field);
+	engine->tick++;
+	if (engine->field->journal)
+		record_tick(engine->field->journal, engine);
+	if (engine->field->food_distance)
+		refresh_food_distance(engine->field->food_distance, engine->field);
+
+#ifdef CNAKE_CHECK_HASH
+	if (engine->field->hash != hash_field(engine->field))
+	{
+		fprintf(stderr, "Hash of the field out of date in tick %lu\n",
+				engine->tick);
+		abort();
+	}
+#endif
+}
+
+uint64_t
+hash_engine(const engine_t *engine)
+{
+	uint64_t hash = engine->field->hash;
+
+	for (int i = 0; i < engine->n_players; i++)
+		hash ^= zobrist_player(i, engine->snakes[i]->direction,
+				engine->scores[i]);
+	return (hash);
+}
+
+void
+quit_engine(engine_t *engine)
+{
+	engine->running = 0;
+}
+
+void
+delete_engine(engine_t *engine)
+{
+	for (int i = 0; i < engine->n_players; i++)
+		delete_snake(engine->snakes[i]);
+	delete_field(engine->field);
+	free(engine);
+}
@@ -16,194 +16,525 @@
  */
 
 #include <field.h>
+#include <flat_map.h>
+#include <food_distance.h>
+#include <journal.h>
+#include <union_find.h>
+#include <zobrist.h>
 #include <stddef.h>
 
 /*
- * Add an item to a temp_item_list_t
+ * When the regions reachable from a spawn hold at least 1/SAMPLING_RATIO of
+ * the empty cells, random empty cells are tried up to SAMPLING_ATTEMPTS
+ * times before flooding the regions
+ */
+#define SAMPLING_RATIO 8
+#define SAMPLING_ATTEMPTS 64
+
+/*
+ * Cells each side of a cell that may split a region floods before giving
+ * up on finding the pieces and leaving the regions for a relabel
+ */
+#define SPLIT_BUDGET 16384
+
+/*
+ * Work of a map change in a tick, give or take a word of obstacles: cells
+ * it changes, each NODES_PER_CELL region nodes it gives as the regions
+ * split counting as one more
+ */
+#define OBSTACLE_CELLS_PER_TICK 256
+#define NODES_PER_CELL 8
+
+/*
+ * Add an item to the field's temp_item_list_t and register it in its cell
  */
 static void
-_add_temp_item(temp_item_list_t *til, coord_t y, coord_t x, time_t duration)
+_add_temp_item(field_t *field, coord_t y, coord_t x, game_clock_t destruction)
 {
 	temp_item_t *new_item = malloc(sizeof(temp_item_t));
-	temp_item_t *aux;
 
 	new_item->y = y;
 	new_item->x = x;
-	new_item->scheduled_destruction = time(NULL) + duration;
-	new_item->next = NULL;
+	new_item->scheduled_destruction = destruction;
+	new_item->prev = NULL;
+	new_item->next = field->til;
+	if (field->journal)
+		record_item_added(field->journal, y, x);
+
+	if (field->til)
+		field->til->prev = new_item;
+	field->til = new_item;
+	field->item_at[y * field->width + x] = new_item;
+	field->hash ^= zobrist_item(y * field->width + x, destruction);
+}
+
+/*
+ * Unlink an item from the field's temp_item_list_t and its cell, then
+ * deallocate it
+ */
+static void
+unlink_temp_item(field_t *field, temp_item_t *item)
+{
+	if (field->journal)
+		record_item_taken(field->journal, item);
+	if (item->prev)
+		item->prev->next = item->next;
+	else
+		field->til = item->next;
+	if (item->next)
+		item->next->prev = item->prev;
+
+	field->item_at[item->y * field->width + item->x] = NULL;
+	field->hash ^= zobrist_item(item->y * field->width + item->x,
+			item->scheduled_destruction);
+	free(item);
+}
 
-	if (*til)
+/*
+ * Deallocates content of a temp_item_list_t
+ */
+static void
+delete_temp_item_list_content(temp_item_list_t til)
+{
+	temp_item_t *aux;
+
+	while (til)
 	{
-		aux = *til;
-		while (aux->next != NULL)
-			aux = aux->next;
-		aux->next = new_item;
+		aux = til->next;
+		free(til);
+		til = aux;
 	}
-	else
-		*til = new_item;
 }
 
 /*
- * Get (*y, *x) coordinates of an expired item. Set them to -1 if no
- * expired items are available. It also deallocates the item from the til
+ * Return whether a snake can go through a cell of this type
+ */
+static int
+is_passable(cell_t type)
+{
+	switch (type)
+	{
+		case EMPTY:
+		case FOOD:
+		case SHORTENER:
+		case DECELERATOR:
+		case EXTRA_POINTS:
+			return (1);
+		default:
+			return (0);
+	}
+}
+
+/*
+ * Return whether blocking the interior cell (y, x) may split the region it
+ * belongs to: its passable 4-neighbours aren't all linked through the ring
+ * of 8 cells around it
+ */
+static int
+may_split(field_t *field, coord_t y, coord_t x)
+{
+	static const int ring_y[8] = {-1, -1, 0, 1, 1, 1, 0, -1};
+	static const int ring_x[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+	int passable[8], k, runs = 0, n_passable = 0;
+
+	for (k = 0; k < 8; k++)
+	{
+		passable[k] = is_passable(field->matrix[y + ring_y[k]][x + ring_x[k]]);
+		n_passable += passable[k];
+	}
+	if (n_passable == 8)
+		return (0);
+
+	/*
+	 * Count the runs of the ring that have a 4-neighbour (even k). A run
+	 * without one is a lone diagonal cell
+	 */
+	for (k = 0; k < 8; k++)
+		if (passable[k] && !passable[(k + 7) % 8] &&
+				(k % 2 == 0 || passable[(k + 1) % 8]))
+			runs++;
+	return (runs > 1);
+}
+
+/*
+ * Label the regions of passable cells from scratch
  */
 static void
-get_expired_item(temp_item_list_t *til, coord_t *y, coord_t *x)
+label_regions(field_t *field)
 {
-	temp_item_t *curr, *prev;
-	time_t now;
+	int y, x, i;
 
-	*y = *x = -1;
-	if (*til)
+	field->n_region_nodes = 0;
+	for (y = 1; y < field->height - 1; y++)
 	{
-		now = time(NULL);
-		prev = NULL;
-		curr = *til;
-		while (curr)
+		for (x = 1; x < field->width - 1; x++)
 		{
-			if (now >= curr->scheduled_destruction)
-			{
-				*y = curr->y;
-				*x = curr->x;
-				if (prev)
-					prev->next = curr->next;
-				else
-					*til = curr->next;
-				free(curr);
-				break;
-			}
-			curr = curr->next;
+			if (!is_passable(field->matrix[y][x]))
+				continue;
+			i = y * field->width + x;
+			field->region_node[i] = field->n_region_nodes++;
+			field->region_parent[field->region_node[i]] = -1;
+			if (is_passable(field->matrix[y - 1][x]))
+				unite(field->region_parent, field->region_node[i],
+						field->region_node[i - field->width]);
+			if (is_passable(field->matrix[y][x - 1]))
+				unite(field->region_parent, field->region_node[i],
+						field->region_node[i - 1]);
 		}
 	}
+	field->regions_dirty = 0;
 }
 
 /*
- * Deallocates content of a temp_item_list_t
+ * Keep the regions up to date after the interior cell (y, x) became
+ * passable. It gets a new node, its old one may belong to a region it
+ * isn't linked to anymore
  */
 static void
-delete_temp_item_list_content(temp_item_list_t til)
+join_regions(field_t *field, coord_t y, coord_t x)
 {
-	if (til)
+	static const int step_y[4] = {-1, 0, 0, 1}, step_x[4] = {0, -1, 1, 0};
+	int i = y * field->width + x, k;
+
+	if (field->n_region_nodes == 2 * field->height * field->width)
 	{
-		if (til->next)
-			delete_temp_item_list_content(til->next);
-		free(til);
+		field->regions_dirty = 1;  /* Out of nodes, relabel to reclaim them */
+		return;
 	}
+	field->region_node[i] = field->n_region_nodes++;
+	field->region_parent[field->region_node[i]] = -1;
+	for (k = 0; k < 4; k++)
+		if (is_passable(field->matrix[y + step_y[k]][x + step_x[k]]))
+			unite(field->region_parent, field->region_node[i],
+					field->region_node[i + step_y[k] * field->width + step_x[k]]);
 }
 
 /*
- * Stores in (*y, *x) the coordinate of a random empty cell. Returns 0 if
- * no empty cells are found
+ * Keep the regions up to date after the interior cell (y, x) was blocked
+ * and may_split it. Its passable 4-neighbours flood a cell at a time each,
+ * giving new nodes to what they reach and joining as they meet, until at
+ * most one of the pieces is still growing. Every finished piece is a
+ * region of its own; what's still growing keeps the rest of the old
+ * region. So this takes time of the pieces cut off, not of the region,
+ * unless some side goes over SPLIT_BUDGET and the regions get dirty
  */
-static int
-get_random_empty_cell(field_t *field, coord_t *y, coord_t *x)
+static void
+split_regions(field_t *field, coord_t y, coord_t x)
 {
-    int rows = ((field->width - 2) * (field->height - 2)),
-            cols = 2,
-            i,
-            j,
-            size = 0;
-    coord_t **empty_cells;
+	const int offsets[4] = {-field->width, -1, 1, field->width};
+	int cells = field->height * field->width, budget = SPLIT_BUDGET;
+	int i = y * field->width + x, base = field->n_region_nodes;
+	int *queue[4], head[4], tail[4], open[4], n_sides = 0, n_open;
+	int s, t, k, cell, next, root, cut_off = 0, kept = 0;
+
+	if (budget > cells / 4)
+		budget = cells / 4;
+	if (base > 2 * cells - 4 * budget)
+	{
+		field->regions_dirty = 1;  /* Out of nodes, relabel to reclaim them */
+		return;
+	}
 
-    {
-        size_t alignment = offsetof(struct { coord_t *a; coord_t b; }, b) - sizeof(coord_t *);
-        coord_t *cells_row_start_ptr;
+	for (k = 0; k < 4; k++)
+	{
+		if (!is_passable(field->cells[i + offsets[k]]))
+			continue;
+		queue[n_sides] = field->fill_queue + n_sides * budget;
+		queue[n_sides][0] = i + offsets[k];
+		head[n_sides] = 0;
+		tail[n_sides] = 1;
+		field->region_node[i + offsets[k]] = field->n_region_nodes++;
+		field->region_parent[field->region_node[i + offsets[k]]] = -1;
+		n_sides++;
+	}
 
-        empty_cells = calloc(1,
-            sizeof(empty_cells) * rows
-            + alignment
-            + sizeof(**empty_cells) * cols * rows);
+	/* Nodes from base on were given by this flood, so they were reached */
+	do
+	{
+		for (s = 0; s < n_sides; s++)
+		{
+			if (head[s] == tail[s])
+				continue;
+			cell = queue[s][head[s]++];
+			for (k = 0; k < 4; k++)
+			{
+				next = cell + offsets[k];
+				if (!is_passable(field->cells[next]))
+					continue;
+				if (field->region_node[next] >= base)
+				{
+					unite(field->region_parent, field->region_node[cell],
+							field->region_node[next]);
+					continue;
+				}
+				if (tail[s] == budget)
+				{
+					field->regions_dirty = 1;
+					return;
+				}
+				field->region_node[next] = field->n_region_nodes++;
+				field->region_parent[field->region_node[next]] = -1;
+				unite(field->region_parent, field->region_node[cell],
+						field->region_node[next]);
+				queue[s][tail[s]++] = next;
+			}
+		}
 
-        if (empty_cells == NULL) exit(EXIT_FAILURE);
+		/* Pieces still growing, by the root of one of their sides */
+		n_open = 0;
+		for (s = 0; s < n_sides; s++)
+		{
+			if (head[s] == tail[s])
+				continue;
+			root = find_root(field->region_parent, field->region_node[queue[s][0]]);
+			for (t = 0; t < n_open && open[t] != root; t++)
+				;
+			if (t == n_open)
+				open[n_open++] = root;
+		}
+	} while (n_open > 1);
+
+	/*
+	 * The piece still growing, if any, takes the old region back. Its size
+	 * counts the cells that left it, and the flooded ones twice, so they
+	 * come off. Blocked cells never did, sizes are only an upper bound
+	 */
+	if (n_open == 0)
+		return;
+	for (s = 0; s < n_sides; s++)
+	{
+		if (find_root(field->region_parent,
+					field->region_node[queue[s][0]]) == open[0])
+			kept += tail[s];
+		else
+			cut_off += tail[s];
+	}
+	root = unite(field->region_parent, open[0], field->region_node[i]);
+	field->region_parent[root] += kept + cut_off + 1;
+}
+
+/*
+ * Return the region of the passable cell (y, x)
+ */
+static int
+region_of(field_t *field, coord_t y, coord_t x)
+{
+	return (find_root(field->region_parent,
+				field->region_node[y * field->width + x]));
+}
 
-        cells_row_start_ptr = (coord_t *) ((char *) (empty_cells + rows) + alignment);
+/*
+ * Return a seed for a rng_t taken from rand(), so the whole game can be
+ * reproduced from srand()
+ */
+static uint64_t
+random_seed(void)
+{
+	return ((uint64_t)rand() << 32 ^ (uint64_t)rand() << 16 ^ (uint64_t)rand());
+}
 
-        for (i = 0; i < rows; i++, cells_row_start_ptr += cols) empty_cells[i] = cells_row_start_ptr;
-    }
+/*
+ * Stores in (*y, *x) the coordinate of a random empty cell reachable from
+ * (near_y, near_x), or of any empty cell if near_y is -1 or none of those
+ * is. Returns 0 if no empty cells are found
+ */
+static int
+get_random_empty_cell(field_t *field, coord_t near_y, coord_t near_x,
+		coord_t *y, coord_t *x)
+{
+	static const int step_y[4] = {-1, 0, 0, 1}, step_x[4] = {0, -1, 1, 0};
+	int roots[4], n_roots = 0, size = 0, i, k, r, found = 0;
+	int cell = -1;
+	rng_t rng;
 
+	if (field->n_empty == 0)
+		return (0);
 
-	/* Find all the EMPTY cells and store their coordinates in empty_cells */
-	for (i = 1; i <= field->height - 2; i++)
+	if (near_y != -1)
 	{
-		for (j = 1; j <= field->width - 2; j++)
+		if (field->regions_dirty)
+			label_regions(field);
+		for (k = 0; k < 4; k++)
 		{
-			if (field->matrix[i][j] == EMPTY)
+			if (!is_passable(field->matrix[near_y + step_y[k]][near_x + step_x[k]]))
+				continue;
+			roots[n_roots] = region_of(field, near_y + step_y[k], near_x + step_x[k]);
+			for (r = 0; roots[r] != roots[n_roots]; r++)
+				;
+			if (r == n_roots)
 			{
-				empty_cells[size][0] = i;
-				empty_cells[size][1] = j;
-				size++;
+				size += -field->region_parent[roots[n_roots]];
+				n_roots++;
 			}
 		}
 	}
 
-	if (size > 0)
+	/*
+	 * No region to stick to: any empty cell will do. If the reachable
+	 * regions are a good part of the map, pick empty cells until one falls
+	 * in them
+	 */
+	if (n_roots == 0)
 	{
-		i = rand() % size;  /* Choose a random item of empty_cells */
-		*y = empty_cells[i][0];
-		*x = empty_cells[i][1];
+		cell = field->empty_cells[rand() % field->n_empty];
+		found = 1;
+	}
+	else if (size * SAMPLING_RATIO >= field->n_empty)
+	{
+		for (i = 0; i < SAMPLING_ATTEMPTS && !found; i++)
+		{
+			cell = field->empty_cells[rand() % field->n_empty];
+			r = region_of(field, cell / field->width, cell % field->width);
+			for (k = 0; k < n_roots && !found; k++)
+				found = roots[k] == r;
+		}
 	}
-    free(empty_cells);
 
-	return size > 0 ? 1 : 0;
+	/*
+	 * Otherwise flood the reachable regions to choose uniformly among
+	 * their empty cells, in time of their size. The flood marks the matrix
+	 * for a moment, not through set_cell, but leaves it as it was. If
+	 * they're all taken by food and items, unreachable cells are better
+	 * than no food at all
+	 */
+	if (!found)
+	{
+		seed_rng(&rng, random_seed());
+		cell = flat_random_reachable(field->cells, field->width,
+				field->height * field->width, &rng, field->fill_queue,
+				near_y * field->width + near_x);
+		if (cell == -1)
+			cell = field->empty_cells[rand() % field->n_empty];
+	}
+
+	*y = cell / field->width;
+	*x = cell % field->width;
+	return (1);
 }
 
-/*
- * Add a random cell with food into the matrix. Return 0 if there wasn't
- * space for it. Return 1 in success
- */
-static int
-add_obstacle(field_t *field)
+void
+set_cell(field_t *field, coord_t y, coord_t x, cell_t type)
 {
-	coord_t y, x;
+	int i = y * field->width + x, last;
+	cell_t old = field->matrix[y][x];
+
+	if (old == type)
+		return;
+	if (field->journal)
+		record_cell(field->journal, y, x, old);
+	field->matrix[y][x] = type;
+	field->hash ^= zobrist_cell(i, old) ^ zobrist_cell(i, type);
+
+	if (x < field->damage_from[y])
+		field->damage_from[y] = x;
+	if (x >= field->damage_to[y])
+		field->damage_to[y] = x + 1;
+	if (field->food_distance)
+		note_cell(field->food_distance, field, y, x, old);
+
+	/* Set of empty cells: the last one takes the place of the removed one */
+	if (old == EMPTY)
+	{
+		last = field->empty_cells[--field->n_empty];
+		field->empty_cells[field->empty_slot[i]] = last;
+		field->empty_slot[last] = field->empty_slot[i];
+		field->empty_slot[i] = -1;
+	}
+	else if (type == EMPTY)
+	{
+		field->empty_slot[i] = field->n_empty;
+		field->empty_cells[field->n_empty++] = i;
+	}
 
-	if (get_random_empty_cell(field, &y, &x))
+	/*
+	 * Regions only need work when blocking a cell may split one. While
+	 * they're dirty there's no point in keeping them
+	 */
+	if (field->regions_dirty)
+		return;
+	if (is_passable(old) && !is_passable(type))
 	{
-		field->matrix[y][x] = OBSTACLE;
-		return (1);
+		if (may_split(field, y, x))
+			split_regions(field, y, x);
 	}
-	return (0);
+	else if (!is_passable(old) && is_passable(type))
+		join_regions(field, y, x);
 }
 
 /*
- * Removes all the obstacles from the map and returns how many there were
+ * Place the words of next_layout from next_word on in the matrix, until
+ * about budget cells changed, see OBSTACLE_CELLS_PER_TICK. Busy cells
+ * don't get an obstacle
  */
-static int
-clear_obstacles(field_t *field)
+static void
+place_layout(field_t *field, int budget)
 {
-	int i, j, n_obstacles = 0;
-
-	for (i = 1; i < field->height; i++)
+	bitplane_t *obstacles = field->obstacles, *layout = field->next_layout;
+	int words = layout->height * layout->stride, changed = 0, i, y, x;
+	int nodes = field->n_region_nodes;
+	uint64_t removed, added, word;
+
+	if (field->next_word == words)
+		return;
+	if (field->journal)
+		record_obstacles(field->journal, NULL, field->next_word);
+
+	for (; field->next_word < words && changed +
+			(field->n_region_nodes - nodes) / NODES_PER_CELL < budget;
+			field->next_word++)
 	{
-		for (j = 1; j < field->width; j++)
+		i = field->next_word;
+		removed = obstacles->words[i] & ~layout->words[i];
+		added = layout->words[i] & ~obstacles->words[i];
+		if (!(removed | added))
+			continue;
+
+		y = i / layout->stride;
+		word = obstacles->words[i] & ~removed;
+		for (; removed; removed &= removed - 1, changed++)
+		{
+			x = i % layout->stride * 64 + lowest_bit(removed);
+			if (field->matrix[y][x] == OBSTACLE)
+				set_cell(field, y, x, EMPTY);
+		}
+		for (; added; added &= added - 1)
 		{
-			if (field->matrix[i][j] == OBSTACLE)
+			x = i % layout->stride * 64 + lowest_bit(added);
+			if (field->matrix[y][x] == EMPTY)
 			{
-				field->matrix[i][j] = EMPTY;
-				n_obstacles++;
+				set_cell(field, y, x, OBSTACLE);
+				word |= added & -added;
+				changed++;
 			}
 		}
-	}
 
-	return (n_obstacles);
+		if (field->journal)
+			record_obstacle_word(field->journal, i, obstacles->words[i]);
+		obstacles->words[i] = word;
+	}
 }
 
 field_t*
-init_field(int height, int width, int permill_obstacles)
+init_field(int height, int width, obstacle_layout_t layout,
+		int permill_obstacles)
 {
 	field_t *field;
-	int i, j, number_obstacles;
+	int i, j, cells = height * width;
 
 	field = malloc(sizeof(field_t));
 
 	/* Size */
 	field->width = width;
 	field->height = height;
+	field->journal = NULL;
+	field->food_distance = NULL;
 
-	/* Matrix (map) */
-	field->matrix = malloc(sizeof(cell_t*) * height);
+	/* Matrix (map), in a single block so it can be copied at once */
+	field->cells = malloc(sizeof(cell_byte_t) * cells);
+	field->matrix = malloc(sizeof(cell_byte_t*) * height);
 	for (i = 0; i < height; i++)
 	{
-		field->matrix[i] = malloc(sizeof(cell_t) * width);
+		field->matrix[i] = field->cells + (size_t)i * width;
 		for (j = 0; j < width; j++)
 			field->matrix[i][j] = EMPTY;
 	}
@@ -224,13 +555,57 @@ init_field(int height, int width, int permill_obstacles)
 	for (i = 0; i < height; i++)
 		field->matrix[i][width - 1] = BORDER;
 
-	/* Obstacles placing */
-	number_obstacles = (height-2) * (width-2) * permill_obstacles / 1000;
-	for (i = 0; i < number_obstacles; i++)
-		add_obstacle(field);
+	/* Hash of what's in the matrix so far, set_cell follows from here */
+	field->hash = 0;
+	for (i = 0; i < cells; i++)
+		field->hash ^= zobrist_cell(i, field->cells[i]);
+
+	/* Set of empty cells */
+	field->empty_cells = malloc(sizeof(int) * cells);
+	field->empty_slot = malloc(sizeof(int) * cells);
+	field->n_empty = 0;
+	for (i = 0; i < cells; i++)
+	{
+		field->empty_slot[i] = -1;
+		if (field->matrix[i / width][i % width] == EMPTY)
+		{
+			field->empty_slot[i] = field->n_empty;
+			field->empty_cells[field->n_empty++] = i;
+		}
+	}
+
+	/* Regions, labelled when first needed */
+	field->region_node = malloc(sizeof(int) * cells);
+	field->region_parent = malloc(sizeof(int) * 2 * cells);
+	field->fill_queue = malloc(sizeof(int) * cells);
+	field->n_region_nodes = 0;
+	field->regions_dirty = 1;
+
+	/* No damage yet */
+	field->damage_from = malloc(sizeof(coord_t) * height);
+	field->damage_to = malloc(sizeof(coord_t) * height);
+	for (i = 0; i < height; i++)
+	{
+		field->damage_from[i] = width;
+		field->damage_to[i] = 0;
+	}
 
-	/* List of temporal items */
+	/* Obstacles placing, and the layout of the first map change */
+	field->layout = layout;
+	field->permill_obstacles = permill_obstacles;
+	field->obstacles = init_bitplane(height, width);
+	field->next_layout = init_bitplane(height, width);
+	field->next_word = 0;
+	generate_obstacles(field->next_layout, layout, permill_obstacles,
+			random_seed());
+	place_layout(field, cells);
+	field->next_obstacles = start_obstacle_plan(height, width, layout,
+			permill_obstacles, random_seed());
+
+	/* List of temporal items and their lookup by cell */
 	field->til = NULL;
+	field->item_at = calloc((size_t)height * width, sizeof(temp_item_t*));
+	field->clock = 0;
 
 	return (field);
 }
@@ -238,77 +613,125 @@ init_field(int height, int width, int permill_obstacles)
 void
 change_obstacles(field_t *field)
 {
-	int n_obstacles;
+	/* A map change still under way is left where it got to */
+	if (field->journal)
+		record_obstacles(field->journal, field->next_layout, field->next_word);
+	else
+		delete_bitplane(field->next_layout);
+	field->next_layout = finish_obstacle_plan(field->next_obstacles);
+	field->next_word = 0;
+	field->next_obstacles = start_obstacle_plan(field->height, field->width,
+			field->layout, field->permill_obstacles, random_seed());
+}
 
-	n_obstacles = clear_obstacles(field);
-	while (n_obstacles--)
-		add_obstacle(field);
+void
+place_obstacles(field_t *field)
+{
+	place_layout(field, OBSTACLE_CELLS_PER_TICK);
 }
 
 int
-add_food(field_t *field)
+add_food(field_t *field, coord_t near_y, coord_t near_x)
 {
 	coord_t y, x;
 
-	if (get_random_empty_cell(field, &y, &x))
+	if (get_random_empty_cell(field, near_y, near_x, &y, &x))
 	{
-		field->matrix[y][x] = FOOD;
+		set_cell(field, y, x, FOOD);
 		return (1);
 	}
 	return (0);
 }
 
 int
-add_temp_item(field_t *field, cell_t type, time_t duration)
+add_temp_item(field_t *field, cell_t type, game_clock_t duration,
+		coord_t near_y, coord_t near_x)
 {
 	coord_t y, x;
 
-	if (get_random_empty_cell(field, &y, &x))
+	if (get_random_empty_cell(field, near_y, near_x, &y, &x))
 	{
-		field->matrix[y][x] = type;
-		_add_temp_item(&field->til, y, x, duration);
+		set_cell(field, y, x, type);
+		_add_temp_item(field, y, x, field->clock + duration);
 		return (1);
 	}
 	return (0);
 }
 
 void
-prolong_temp_items(field_t *field, time_t extra_seconds)
+advance_clock(field_t *field, game_clock_t elapsed)
 {
-	temp_item_t *curr;
+	if (field->journal)
+		record_clock(field->journal, field->clock);
+	field->clock += elapsed;
+}
 
-	curr = field->til;
-	while (curr)
-	{
-		curr->scheduled_destruction += extra_seconds;
-		curr = curr->next;
-	}
+void
+take_temp_item(field_t *field, coord_t y, coord_t x)
+{
+	temp_item_t *item = field->item_at[y * field->width + x];
+
+	if (item)
+		unlink_temp_item(field, item);
+}
+
+void
+restore_temp_item(field_t *field, coord_t y, coord_t x,
+		game_clock_t destruction)
+{
+	_add_temp_item(field, y, x, destruction);
 }
 
 void
 remove_expired_items(field_t *field)
 {
-	coord_t y, x;
-	int keep = 1;
+	temp_item_t *curr, *next;
 
-	while (keep)
+	/* Every item in the list is still in the map, so clearing its cell is safe */
+	for (curr = field->til; curr; curr = next)
 	{
-		get_expired_item(&field->til, &y, &x);
-		if (y != -1 && x != -1)
-			field->matrix[y][x] = EMPTY;
-		else
-			keep = 0;
+		next = curr->next;
+		if (field->clock >= curr->scheduled_destruction)
+		{
+			set_cell(field, curr->y, curr->x, EMPTY);
+			unlink_temp_item(field, curr);
+		}
 	}
 }
 
+uint64_t
+hash_field(const field_t *field)
+{
+	uint64_t hash = 0;
+
+	for (int i = 0; i < field->height * field->width; i++)
+		hash ^= zobrist_cell(i, field->cells[i]);
+	for (const temp_item_t *item = field->til; item; item = item->next)
+		hash ^= zobrist_item(item->y * field->width + item->x,
+				item->scheduled_destruction);
+	return (hash);
+}
+
 void
 delete_field(field_t *field)
 {
-	for (int i = 0; i < field->height; i++)
-		free(field->matrix[i]);
 	free(field->matrix);
+	free(field->cells);
+
+	free(field->empty_cells);
+	free(field->empty_slot);
+	free(field->region_node);
+	free(field->region_parent);
+	free(field->fill_queue);
+	free(field->damage_from);
+	free(field->damage_to);
 
 	delete_temp_item_list_content(field->til);
+	free(field->item_at);
+
+	delete_bitplane(finish_obstacle_plan(field->next_obstacles));
+	delete_bitplane(field->obstacles);
+	delete_bitplane(field->next_layout);
 
 	free(field);
 }
@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <flat_map.h>
+
+/* Mark of the cells reached by a flood fill, cleared before it returns */
+#define VISITED 0x80
+
+/* Random cells tried before going through all of them, as in the field */
+#define SAMPLING_ATTEMPTS 64
+
+const unsigned char flat_passable[256] = {
+	[EMPTY] = 1,
+	[FOOD] = 1,
+	[SHORTENER] = 1,
+	[DECELERATOR] = 1,
+	[EXTRA_POINTS] = 1,
+};
+
+int
+flat_may_split(const cell_byte_t *map, int width, int cell)
+{
+	const int ring[8] = {-width, -width + 1, 1, width + 1, width, width - 1,
+		-1, -width - 1};
+	unsigned int open = 0, before, after, starts;
+
+	for (int k = 0; k < 8; k++)
+		open |= (unsigned int)flat_passable[map[cell + ring[k]]] << k;
+
+	/*
+	 * Bit k of before (after) is the ring cell before (after) k. Runs that
+	 * start at k count if they have a 4-neighbour (even k) in them
+	 */
+	before = (open << 1 | open >> 7) & 0xFF;
+	after = (open >> 1 | open << 7) & 0xFF;
+	starts = open & ~before & (0x55 | after);
+	return ((starts & (starts - 1)) != 0);
+}
+
+int
+flat_random_empty(const cell_byte_t *map, int cells, rng_t *rng)
+{
+	int cell = -1, empty = 0;
+
+	for (int i = 0; i < SAMPLING_ATTEMPTS; i++)
+	{
+		cell = (int)rng_below(rng, (uint32_t)cells);
+		if (map[cell] == EMPTY)
+			return (cell);
+	}
+
+	for (int i = 0; i < cells; i++)
+		if (map[i] == EMPTY && rng_below(rng, (uint32_t)++empty) == 0)
+			cell = i;
+	return (empty ? cell : -1);
+}
+
+int
+flat_random_reachable(cell_byte_t *map, int width, int cells, rng_t *rng,
+		int *queue, int near)
+{
+	const int offsets[4] = {-width, 1, -1, width};
+	int n = 0, empty = 0, pick, cell, next, found = -1;
+
+	for (int k = 0; k < 4; k++)
+	{
+		if (flat_passable[map[near + offsets[k]]])
+		{
+			map[near + offsets[k]] |= VISITED;
+			queue[n++] = near + offsets[k];
+		}
+	}
+	if (n == 0)  /* Boxed in, anything will do as in the field */
+		return (flat_random_empty(map, cells, rng));
+
+	/* The queue ends up holding every reachable cell, marked in the map */
+	for (int i = 0; i < n; i++)
+	{
+		cell = queue[i];
+		empty += map[cell] == (EMPTY | VISITED);
+		for (int k = 0; k < 4; k++)
+		{
+			next = cell + offsets[k];
+			if (flat_passable[map[next]])
+			{
+				map[next] |= VISITED;
+				queue[n++] = next;
+			}
+		}
+	}
+
+	pick = empty ? (int)rng_below(rng, (uint32_t)empty) : -1;
+	for (int i = 0; i < n; i++)
+	{
+		map[queue[i]] &= ~VISITED;
+		if (map[queue[i]] == EMPTY && pick-- == 0)
+			found = queue[i];
+	}
+	return (found);
+}
+
+int
+flat_connected(cell_byte_t *map, int width, int cells, int *queue)
+{
+	const int offsets[4] = {-width, 1, -1, width};
+	int n = 0, passable = 0, next;
+
+	for (int i = 0; i < cells; i++)
+	{
+		if (!flat_passable[map[i]])
+			continue;
+		if (passable++ == 0)
+		{
+			map[i] |= VISITED;
+			queue[n++] = i;
+		}
+	}
+
+	/* Borders all around, so the neighbours of passable cells exist */
+	for (int i = 0; i < n; i++)
+	{
+		for (int k = 0; k < 4; k++)
+		{
+			next = queue[i] + offsets[k];
+			if (flat_passable[map[next]])
+			{
+				map[next] |= VISITED;
+				queue[n++] = next;
+			}
+		}
+	}
+
+	for (int i = 0; i < n; i++)
+		map[queue[i]] &= ~VISITED;
+	return (n == passable);
+}
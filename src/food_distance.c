@@ -0,0 +1,304 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <food_distance.h>
+#include <flat_map.h>
+#include <limits.h>
+#include <string.h>
+
+/* Distance of the cells that can't reach food or items */
+#define FAR INT_MAX
+
+struct food_distance_s
+{
+	int width, cells;
+	int *distance;         /* [cells] Steps to the nearest food or item */
+	int *queue;            /* [cells] Circular, cells waiting to be relaxed */
+	unsigned char *queued; /* [cells] Whether each cell is in the queue */
+	int *lost;             /* [cells] Cells being worked out again */
+	unsigned *seen, *dropped;  /* [cells] Check that reached each cell last, */
+	unsigned stamp;            /* and the one that dropped its distance */
+	int dirty;  /* Computed again from scratch at the end of the tick */
+};
+
+/* Cells the distances are measured to */
+static const unsigned char is_target[256] = {
+	[FOOD] = 1,
+	[SHORTENER] = 1,
+	[DECELERATOR] = 1,
+	[EXTRA_POINTS] = 1,
+};
+
+/*
+ * Breadth-first search from all the food and items at once
+ */
+static void
+compute(food_distance_t *distances, const cell_byte_t *cells)
+{
+	const int w = distances->width, offsets[4] = {-w, 1, -1, w};
+	int *distance = distances->distance, *queue = distances->queue;
+	int head = 0, tail = 0, cell, next;
+
+	for (int i = 0; i < distances->cells; i++)
+	{
+		distance[i] = is_target[cells[i]] ? 0 : FAR;
+		if (!distance[i])
+			queue[tail++] = i;
+	}
+	while (head < tail)
+	{
+		cell = queue[head++];
+		for (int k = 0; k < 4; k++)
+		{
+			next = cell + offsets[k];
+			if (flat_passable[cells[next]] && distance[next] == FAR)
+			{
+				distance[next] = distance[cell] + 1;
+				queue[tail++] = next;
+			}
+		}
+	}
+	distances->dirty = 0;
+}
+
+/*
+ * Add cell to the circular queue that starts at *head and has *n cells,
+ * unless it's already there
+ */
+static void
+enqueue(food_distance_t *distances, int cell, int head, int *n)
+{
+	if (distances->queued[cell])
+		return;
+	distances->queued[cell] = 1;
+	distances->queue[(head + (*n)++) % distances->cells] = cell;
+}
+
+/*
+ * Lower the distances around the n cells in the queue from head until
+ * none can go lower
+ */
+static void
+relax(food_distance_t *distances, const cell_byte_t *cells, int head, int n)
+{
+	const int w = distances->width, offsets[4] = {-w, 1, -1, w};
+	int *distance = distances->distance, cell, next;
+
+	while (n)
+	{
+		cell = distances->queue[head];
+		head = (head + 1) % distances->cells;
+		n--;
+		distances->queued[cell] = 0;
+		for (int k = 0; k < 4; k++)
+		{
+			next = cell + offsets[k];
+			if (flat_passable[cells[next]] && distance[next] > distance[cell] + 1)
+			{
+				distance[next] = distance[cell] + 1;
+				enqueue(distances, next, head, &n);
+			}
+		}
+	}
+}
+
+/*
+ * Return the distance of cell from its neighbours, FAR if none has one
+ */
+static int
+from_neighbours(const food_distance_t *distances, int cell)
+{
+	const int w = distances->width, offsets[4] = {-w, 1, -1, w};
+	int best = FAR, d;
+
+	for (int k = 0; k < 4; k++)
+	{
+		d = distances->distance[cell + offsets[k]];
+		if (d != FAR && d + 1 < best)
+			best = d + 1;
+	}
+	return (best);
+}
+
+/*
+ * The passable cell became food or an item, or stopped being busy
+ */
+static void
+open_cell(food_distance_t *distances, const cell_byte_t *cells, int cell)
+{
+	int n = 0;
+
+	distances->distance[cell] = is_target[cells[cell]] ? 0 :
+		from_neighbours(distances, cell);
+	if (distances->distance[cell] == FAR)
+		return;
+	enqueue(distances, cell, 0, &n);
+	relax(distances, cells, 0, n);
+}
+
+/*
+ * The cell became busy. The cells that had their distance through it,
+ * which have no neighbour one step nearer left, lose it, and so on from
+ * them: going through them in order of distance, one step nearer has been
+ * settled before each. Those are worked out again from their neighbours
+ */
+static void
+close_cell(food_distance_t *distances, const cell_byte_t *cells, int cell)
+{
+	const int w = distances->width, offsets[4] = {-w, 1, -1, w};
+	int *distance = distances->distance, *queue = distances->queue;
+	int head = 0, tail = 0, n_lost = 0, supported, next, n;
+	unsigned stamp = ++distances->stamp;
+
+	if (distance[cell] == FAR)
+		return;
+	distances->seen[cell] = stamp;
+	queue[tail++] = cell;
+	while (head < tail)
+	{
+		cell = queue[head++];
+		supported = 0;
+		if (flat_passable[cells[cell]])
+		{
+			for (int k = 0; k < 4 && !supported; k++)
+			{
+				next = cell + offsets[k];
+				supported = distance[next] == distance[cell] - 1 &&
+					distances->dropped[next] != stamp;
+			}
+		}
+		if (supported)
+			continue;
+
+		distances->dropped[cell] = stamp;
+		distances->lost[n_lost++] = cell;
+		for (int k = 0; k < 4; k++)
+		{
+			next = cell + offsets[k];
+			if (distances->seen[next] != stamp &&
+					distance[next] == distance[cell] + 1)
+			{
+				distances->seen[next] = stamp;
+				queue[tail++] = next;
+			}
+		}
+	}
+
+	for (int i = 0; i < n_lost; i++)
+		distance[distances->lost[i]] = FAR;
+	n = 0;
+	for (int i = 0; i < n_lost; i++)
+	{
+		cell = distances->lost[i];
+		if (!flat_passable[cells[cell]])
+			continue;
+		distance[cell] = from_neighbours(distances, cell);
+		if (distance[cell] != FAR)
+			enqueue(distances, cell, 0, &n);
+	}
+	relax(distances, cells, 0, n);
+}
+
+food_distance_t*
+init_food_distance(const field_t *field)
+{
+	food_distance_t *distances = malloc(sizeof(food_distance_t));
+
+	distances->width = field->width;
+	distances->cells = field->height * field->width;
+	distances->distance = malloc(sizeof(int) * distances->cells);
+	distances->queue = malloc(sizeof(int) * distances->cells);
+	distances->queued = calloc(distances->cells, 1);
+	distances->lost = malloc(sizeof(int) * distances->cells);
+	distances->seen = calloc(distances->cells, sizeof(unsigned));
+	distances->dropped = calloc(distances->cells, sizeof(unsigned));
+	distances->stamp = 0;
+	compute(distances, field->cells);
+	return (distances);
+}
+
+void
+attach_food_distance(engine_t *engine, food_distance_t *distances)
+{
+	engine->field->food_distance = distances;
+	if (distances)
+		compute(distances, engine->field->cells);
+}
+
+void
+note_cell(food_distance_t *distances, const field_t *field, coord_t y,
+		coord_t x, cell_t old)
+{
+	int cell = y * field->width + x;
+	cell_t type = field->cells[cell];
+
+	/* Whatever they pass, the next search from scratch takes it */
+	if (distances->dirty)
+		return;
+	if (old == OBSTACLE || type == OBSTACLE || (is_target[old] && !is_target[type]))
+		distances->dirty = 1;
+	else if (is_target[type] || (!flat_passable[old] && flat_passable[type]))
+		open_cell(distances, field->cells, cell);
+	else if (flat_passable[old] && !flat_passable[type])
+		close_cell(distances, field->cells, cell);
+}
+
+void
+refresh_food_distance(food_distance_t *distances, const field_t *field)
+{
+	if (distances->dirty)
+		compute(distances, field->cells);
+}
+
+int
+food_distance(const food_distance_t *distances, coord_t y, coord_t x)
+{
+	int d = distances->distance[y * distances->width + x];
+
+	return (d == FAR ? -1 : d);
+}
+
+direction_t
+toward_food(const food_distance_t *distances, const snake_t *snake)
+{
+	const int w = distances->width, offsets[4] = {-w, 1, -1, w};
+	int head = snake->head->y * w + snake->head->x, best = FAR, d;
+	direction_t direction = snake->direction;
+
+	for (int k = 0; k < 4; k++)
+	{
+		d = distances->distance[head + offsets[k]];
+		if (d < best)
+		{
+			best = d;
+			direction = (direction_t)k;
+		}
+	}
+	return (direction);
+}
+
+void
+delete_food_distance(food_distance_t *distances)
+{
+	free(distances->distance);
+	free(distances->queue);
+	free(distances->queued);
+	free(distances->lost);
+	free(distances->seen);
+	free(distances->dropped);
+	free(distances);
+}
@@ -15,14 +15,44 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+/* Wide character curses, for the half block glyphs */
+#define _XOPEN_SOURCE_EXTENDED 1
+
 #include <config.h>
-#include <field.h>
-#include <snake.h>
+#include <autopilot.h>
+#include <bot_protocol.h>
+#include <engine.h>
+#include <input.h>
+#include <mcts.h>
+#include <minimap.h>
+#include <recorder.h>
+#include <spsc_ring.h>
+#include <video.h>
 #include <arguments_parser.h>
 #include <curses.h>
+#include <locale.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#ifndef _WIN32
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+/* Milliseconds the render thread waits for keys before checking frames */
+#define INPUT_POLL_DELAY 5
+
+/* Slots of the rings between the simulation and the render threads */
+#define FRAME_SLOTS 4
+#define COMMAND_SLOTS 64
+
+/*
+ * Bytes waiting to be sent to the terminal above which it isn't updated,
+ * so a slow link can't pile up frames ahead of the player's input
+ */
+#define OUTPUT_BACKLOG_LIMIT 2048
 
 /* Color pairs */
 enum
@@ -40,8 +70,59 @@ enum
 	PAIR_TITLE,
 	PAIR_PLAYER,
 	PAIR_PLAYER2,
+	PAIR_HALF_BLOCKS,  /* First of CELL_TYPES * CELL_TYPES, see init_half_block_glyphs */
 };
 
+/*
+ * Snapshot of what the simulation thread publishes after each tick
+ */
+typedef struct
+{
+	direction_t directions[MAX_PLAYERS];
+	unsigned int scores[MAX_PLAYERS];
+	int paused, finished;
+	cell_byte_t cells[];  /* [height * width], then the minimap blocks if any */
+} frame_t;
+
+/*
+ * Shared by the simulation thread, which owns the engine, and the render
+ * thread, which owns curses
+ */
+typedef struct
+{
+	engine_t *engine;
+	minimap_t *minimap;     /* NULL if there isn't one */
+	video_t *video;         /* NULL if not recording */
+	input_t *input;         /* Script of commands, NULL if there isn't one */
+	mcts_t *bot;            /* Plays player 2, NULL if a person does */
+	autopilot_t *autopilot; /* Plays player 1, NULL if a person does */
+	game_clock_t started;   /* When the simulation started, for the script */
+	spsc_ring_t *frames;    /* Simulation -> render */
+	spsc_ring_t *commands;  /* Render (keyboard) -> simulation */
+	size_t frame_size;
+
+	/* Only used to let the simulation sleep until a command arrives */
+	pthread_mutex_t lock;
+	pthread_cond_t command_ready;
+} session_t;
+
+/*
+ * Reads a monotonic wall clock in milliseconds. Only used to pace the ticks,
+ * the script and the screen, never fed to the game clock
+ */
+static game_clock_t
+monotonic_ms(void)
+{
+	struct timespec ts;
+
+#ifdef _WIN32
+	timespec_get(&ts, TIME_UTC);
+#else
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+	return ((game_clock_t)ts.tv_sec * 1000 + (game_clock_t)ts.tv_nsec / 1000000);
+}
+
 /*
  * Prepares colors
  */
@@ -73,7 +154,7 @@ set_curses_properties()
  * Updates score marker. Display in two players mode if score2 is not NULL
  */
 static void
-redraw_score(WINDOW *w_score, unsigned int score, const int *score2)
+redraw_score(WINDOW *w_score, unsigned int score, const unsigned int *score2)
 {
 	if (score2)
 	{
@@ -151,117 +232,616 @@ draw_keys(WINDOW *w_keys, int two_players)
 }
 
 /*
- * Updates game window acording to the field's map
+ * Glyph of each cell type. Heads are patched with their direction
+ * before each redraw
+ */
+static chtype cell_glyphs[CELL_TYPES];
+
+/*
+ * Fills cell_glyphs
  */
 static void
-redraw_game(WINDOW *w_game, field_t *field,
-		direction_t dir, direction_t dir2)
+init_cell_glyphs()
 {
-	int i, j;
+	cell_glyphs[EMPTY] = ' ' | COLOR_PAIR(PAIR_DEFAULT);
+	cell_glyphs[SNAKE] = '#' | COLOR_PAIR(PAIR_SNAKE);
+	cell_glyphs[HEAD] = '^' | COLOR_PAIR(PAIR_HEAD);
+	cell_glyphs[HEAD2] = '^' | COLOR_PAIR(PAIR_HEAD2);
+	cell_glyphs[FOOD] = 'f' | COLOR_PAIR(PAIR_FOOD);
+	cell_glyphs[BORDER] = '*' | COLOR_PAIR(PAIR_BORDER);
+	cell_glyphs[OBSTACLE] = 'x' | COLOR_PAIR(PAIR_BORDER);
+	cell_glyphs[SHORTENER] = 's' | COLOR_PAIR(PAIR_SHORTENER);
+	cell_glyphs[DECELERATOR] = 'd' | COLOR_PAIR(PAIR_DECELERATOR);
+	cell_glyphs[EXTRA_POINTS] = 'e' | COLOR_PAIR(PAIR_EXTRA_POINTS);
+}
+
+/*
+ * Glyph of each priority of the minimap blocks
+ */
+static chtype minimap_glyphs[MINIMAP_PRIORITIES];
 
-	werase(w_game);
+/*
+ * Fills minimap_glyphs
+ */
+static void
+init_minimap_glyphs()
+{
+	minimap_glyphs[MINIMAP_EMPTY] = ' ' | COLOR_PAIR(PAIR_DEFAULT);
+	minimap_glyphs[MINIMAP_OBSTACLE] = '.' | COLOR_PAIR(PAIR_BORDER);
+	minimap_glyphs[MINIMAP_BODY] = '#' | COLOR_PAIR(PAIR_SNAKE);
+	minimap_glyphs[MINIMAP_ITEM] = '+' | COLOR_PAIR(PAIR_EXTRA_POINTS);
+	minimap_glyphs[MINIMAP_FOOD] = 'f' | COLOR_PAIR(PAIR_FOOD);
+	minimap_glyphs[MINIMAP_HEAD2] = '@' | COLOR_PAIR(PAIR_HEAD2);
+	minimap_glyphs[MINIMAP_HEAD] = '@' | COLOR_PAIR(PAIR_HEAD);
+}
 
-	for (i = 0; i < field->height; i++)
+/*
+ * Draws the frame of the minimap window
+ */
+static void
+draw_minimap_frame(WINDOW *w_minimap)
+{
+	wborder(w_minimap, 0, 0, 0, 0, 0, 0, 0, 0);
+
+	wattron(w_minimap, A_BOLD);
+	mvwaddstr(w_minimap, 0, WIDTH_W_KEYS/2 - 2, " Map ");
+	wattroff(w_minimap, A_BOLD);
+
+	wnoutrefresh(w_minimap);
+}
+
+/*
+ * Updates the minimap window with rows x cols blocks, a whole row at a
+ * time. line must have room for cols glyphs
+ */
+static void
+redraw_minimap(WINDOW *w_minimap, const unsigned char *blocks, int rows,
+		int cols, chtype *line)
+{
+	for (int i = 0; i < rows; i++)
+	{
+		for (int j = 0; j < cols; j++)
+			line[j] = minimap_glyphs[blocks[i * cols + j]];
+		mvwaddchnstr(w_minimap, i + 1, 1, line, cols);
+	}
+
+	wnoutrefresh(w_minimap);
+}
+
+/*
+ * Color each cell type is painted with in half blocks mode, -1 is the
+ * terminal's default background. Heads can't show their direction there,
+ * so they get bright colors if available
+ */
+static short
+half_block_color(cell_t type)
+{
+	switch (type)
+	{
+		case SNAKE:
+			return (COLOR_RED);
+		case HEAD:
+			return (COLORS >= 16 ? 8 + COLOR_GREEN : COLOR_GREEN);
+		case HEAD2:
+			return (COLORS >= 16 ? 8 + COLOR_CYAN : COLOR_CYAN);
+		case FOOD:
+			return (COLOR_WHITE);
+		case BORDER:
+		case OBSTACLE:
+			return (COLOR_MAGENTA);
+		case SHORTENER:
+			return (COLOR_BLUE);
+		case DECELERATOR:
+			return (COLORS >= 16 ? COLOR_GREEN : COLOR_CYAN);
+		case EXTRA_POINTS:
+			return (COLOR_YELLOW);
+		default:
+			return (-1);
+	}
+}
+
+/*
+ * Glyph of each pair of vertically adjacent cells, by [top][bottom] type
+ */
+static cchar_t half_block_glyphs[CELL_TYPES][CELL_TYPES];
+
+/*
+ * Fills half_block_glyphs, each one with its own color pair. Return 0 if
+ * the terminal doesn't have enough color pairs
+ */
+static int
+init_half_block_glyphs()
+{
+	const wchar_t upper_half[] = L"\u2580", lower_half[] = L"\u2584",
+		  space[] = L" ";
+	short top, bottom;
+	int pair;
+
+	if (COLOR_PAIRS < PAIR_HALF_BLOCKS + CELL_TYPES * CELL_TYPES)
+		return (0);
+
+	for (int i = 0; i < CELL_TYPES; i++)
 	{
-		for (j = 0; j < field->width; j++)
+		for (int j = 0; j < CELL_TYPES; j++)
 		{
-			switch (field->matrix[i][j])
+			top = half_block_color(i);
+			bottom = half_block_color(j);
+			pair = PAIR_HALF_BLOCKS + i * CELL_TYPES + j;
+
+			/*
+			 * The default background can't be a foreground color, so a
+			 * colored cell over an empty one is a lower half. Same colors
+			 * are a plain space, which is cheaper to send
+			 */
+			if (top == bottom)
 			{
-				case EMPTY:
-					break;
-				case SNAKE:
-					mvwaddch(w_game, i, j, '#' | COLOR_PAIR(PAIR_SNAKE));
-					break;
-				case HEAD:
-				case HEAD2:
-					if (field->matrix[i][j] == HEAD)
-						wattron(w_game, COLOR_PAIR(PAIR_HEAD));
-					else
-						wattron(w_game, COLOR_PAIR(PAIR_HEAD2));
-					switch (field->matrix[i][j] == HEAD ? dir : dir2)
-					{
-						case NORTH:
-							mvwaddch(w_game, i, j, '^');
-							break;
-						case EAST:
-							mvwaddch(w_game, i, j, '>');
-							break;
-						case WEST:
-							mvwaddch(w_game, i, j, '<');
-							break;
-						case SOUTH:
-							mvwaddch(w_game, i, j, 'v');
-					}
-					if (field->matrix[i][j] == HEAD)
-						wattroff(w_game, COLOR_PAIR(PAIR_HEAD));
-					else
-						wattroff(w_game, COLOR_PAIR(PAIR_HEAD2));
-					break;
-				case FOOD:
-					mvwaddch(w_game, i, j, 'f' | COLOR_PAIR(PAIR_FOOD));
-					break;
-				case BORDER:
-					mvwaddch(w_game, i, j, '*' | COLOR_PAIR(PAIR_BORDER));
-					break;
-				case OBSTACLE:
-					mvwaddch(w_game, i, j, 'x' | COLOR_PAIR(PAIR_BORDER));
-					break;
-				case SHORTENER:
-					mvwaddch(w_game, i, j, 's' | COLOR_PAIR(PAIR_SHORTENER));
-					break;
-				case DECELERATOR:
-					mvwaddch(w_game, i, j, 'd' | COLOR_PAIR(PAIR_DECELERATOR));
-					break;
-				case EXTRA_POINTS:
-					mvwaddch(w_game, i, j, 'e' | COLOR_PAIR(PAIR_EXTRA_POINTS));
-					break;
+				init_pair(pair, -1, top);
+				setcchar(&half_block_glyphs[i][j], space, A_NORMAL, pair, NULL);
+			}
+			else if (top == -1)
+			{
+				init_pair(pair, bottom, -1);
+				setcchar(&half_block_glyphs[i][j], lower_half, A_NORMAL, pair, NULL);
+			}
+			else
+			{
+				init_pair(pair, top, bottom);
+				setcchar(&half_block_glyphs[i][j], upper_half, A_NORMAL, pair, NULL);
 			}
 		}
 	}
 
+	return (1);
+}
+
+/*
+ * Updates game window acording to the cells of a height x width map, a
+ * whole row at a time. line must have room for width glyphs
+ */
+static void
+redraw_game(WINDOW *w_game, const cell_byte_t *cells, int height, int width,
+		chtype *line, direction_t dir, direction_t dir2)
+{
+	static const chtype head_chars[] = {'^', '>', '<', 'v'};  /* By direction */
+	const cell_byte_t *row;
+	int i, j;
+
+	cell_glyphs[HEAD] = head_chars[dir] | COLOR_PAIR(PAIR_HEAD);
+	cell_glyphs[HEAD2] = head_chars[dir2] | COLOR_PAIR(PAIR_HEAD2);
+
+	for (i = 0; i < height; i++)
+	{
+		row = cells + (size_t)i * width;
+		for (j = 0; j < width; j++)
+			line[j] = cell_glyphs[row[j]];
+		mvwaddchnstr(w_game, i, 0, line, width);
+	}
+
 	wnoutrefresh(w_game);
 }
 
 /*
- * Pause game and display PAUSED banner in w_game
+ * Same as redraw_game but each row of w_game shows two rows of the map as
+ * half blocks. An odd last row is paired with empty cells
  */
 static void
-pause(WINDOW *w_game, field_t *field, time_t delay)
+redraw_game_half_blocks(WINDOW *w_game, const cell_byte_t *cells, int height,
+		int width, cchar_t *line)
+{
+	const cell_byte_t *top, *bottom;
+	int i, j;
+
+	for (i = 0; i + 1 < height; i += 2)
+	{
+		top = cells + (size_t)i * width;
+		bottom = top + width;
+		for (j = 0; j < width; j++)
+			line[j] = half_block_glyphs[top[j]][bottom[j]];
+		mvwadd_wchnstr(w_game, i / 2, 0, line, width);
+	}
+	if (i < height)
+	{
+		top = cells + (size_t)i * width;
+		for (j = 0; j < width; j++)
+			line[j] = half_block_glyphs[top[j]][EMPTY];
+		mvwadd_wchnstr(w_game, i / 2, 0, line, width);
+	}
+
+	wnoutrefresh(w_game);
+}
+
+/*
+ * Return the bytes written to the terminal that it hasn't taken yet, or 0
+ * if that can't be known. While recording stdout is the recorder's pipe,
+ * which fills up when the terminal holds up the recorder, so the bytes
+ * waiting in it are counted instead
+ */
+static int
+output_backlog(void)
+{
+	int queued = 0;
+
+#ifdef TIOCOUTQ
+	if (ioctl(STDOUT_FILENO, TIOCOUTQ, &queued) == -1 &&
+			ioctl(STDOUT_FILENO, FIONREAD, &queued) == -1)
+		queued = 0;
+#endif
+	return (queued);
+}
+
+/*
+ * Send the changes in the windows to the terminal if it keeps up with
+ * them, else leave them to pile up with the next ones. *next_update is
+ * when the terminal may be updated again: after a slow doupdate it gets
+ * that long to itself before the next one. Return 1 if it was updated
+ */
+static int
+update_terminal(game_clock_t *next_update, int force)
+{
+	game_clock_t update_start = monotonic_ms();
+
+	if (!force && (update_start < *next_update ||
+				output_backlog() > OUTPUT_BACKLOG_LIMIT))
+		return (0);
+
+	doupdate();
+	*next_update = 2 * monotonic_ms() - update_start;
+	return (1);
+}
+
+/*
+ * Display PAUSED banner in w_game
+ */
+static void
+draw_pause(WINDOW *w_game)
 {
 	int max_y, max_x;
-	time_t before_pause;
 
 	getmaxyx(w_game, max_y, max_x);
 	wattron(w_game, A_REVERSE);
 	mvwaddstr(w_game, max_y / 2, max_x / 2 - 3, "PAUSED");
 	wattroff(w_game, A_REVERSE);
-	wrefresh(w_game);
+	wnoutrefresh(w_game);
+}
+
+/*
+ * Copy the state of the engine into the next frame slot. If the render
+ * thread is behind and there's no free slot the frame is skipped, unless
+ * it's a paused or final one
+ */
+static void
+publish_frame(session_t *session, int paused, int finished)
+{
+	const struct timespec retry = {0, 1000000};
+	engine_t *engine = session->engine;
+	size_t n_cells = sizeof(cell_byte_t) *
+		engine->field->height * engine->field->width;
+	frame_t *frame;
+
+	while (!(frame = peek_free_slot(session->frames)))
+	{
+		if (!paused && !finished)
+			return;
+		nanosleep(&retry, NULL);
+	}
+
+	for (int i = 0; i < engine->n_players; i++)
+	{
+		frame->directions[i] = engine->snakes[i]->direction;
+		frame->scores[i] = engine->scores[i];
+	}
+	frame->paused = paused;
+	frame->finished = finished;
+	memcpy(frame->cells, engine->field->cells, n_cells);
+
+	/* The damage piles up in the field while frames are skipped */
+	if (session->minimap)
+	{
+		update_minimap(session->minimap, engine->field);
+		memcpy(frame->cells + n_cells, session->minimap->blocks,
+				(size_t)session->minimap->rows * session->minimap->cols);
+	}
+	push_slot(session->frames);
+}
+
+/*
+ * Take the next command into *command, waiting for it until deadline
+ * (monotonic milliseconds), or forever if deadline is NULL. Return 0 if
+ * the deadline passed first
+ */
+static int
+wait_command(session_t *session, const game_clock_t *deadline,
+		command_t *command)
+{
+	command_t *slot;
+	struct timespec until;
+
+	pthread_mutex_lock(&session->lock);
+	while (!(slot = peek_full_slot(session->commands)))
+	{
+		if (!deadline)
+			pthread_cond_wait(&session->command_ready, &session->lock);
+		else if (monotonic_ms() >= *deadline)
+			break;
+		else
+		{
+			until.tv_sec = (time_t)(*deadline / 1000);
+			until.tv_nsec = (long)(*deadline % 1000) * 1000000;
+			pthread_cond_timedwait(&session->command_ready, &session->lock, &until);
+		}
+	}
+	pthread_mutex_unlock(&session->lock);
 
-	timeout(-1);  /* Take out timeout */
-	before_pause = time(NULL);
-	getch();
-	prolong_temp_items(field, time(NULL) - before_pause);
-	timeout((int)delay);  /* Restore timeout */
+	if (!slot)
+		return (0);
+	*command = *slot;
+	pop_slot(session->commands);
+	return (1);
 }
 
 /*
- * Initialize data structures and run game mainloop
+ * Queue a command for the simulation thread and wake it up. Commands that
+ * don't fit in the queue are dropped
  */
 static void
-start(arguments_t *args)
+send_command(session_t *session, command_t command)
 {
-	WINDOW *w_score, *w_game, *w_keys;
-	field_t *field;
-	snake_t *snake, *snake2, *snakex;
-	int w_game_y, w_keys_height, score, score2, keep_mainloop, died;
-	unsigned int score_last_change;
-	int *scorex;
-	time_t delay;
+	command_t *slot = peek_free_slot(session->commands);
+
+	if (!slot)
+		return;
+	*slot = command;
+	push_slot(session->commands);
 
-	/* Stores who pressed the key */
-	enum {AC_TIMEOUT, AC_PLAYER, AC_PLAYER2} action_who;
+	pthread_mutex_lock(&session->lock);
+	pthread_cond_signal(&session->command_ready);
+	pthread_mutex_unlock(&session->lock);
+}
+
+/*
+ * Return whether a person may steer the snake of player: there's one, and
+ * neither the bot nor the autopilot plays it
+ */
+static int
+steerable(const session_t *session, int player)
+{
+	return (player >= 0 && player < session->engine->n_players &&
+			!(session->bot && player == 1) && !(session->autopilot && player == 0));
+}
+
+/*
+ * Take the next command, from the script or the keyboard, waiting for it
+ * until deadline. Return 0 if the deadline passed first
+ */
+static int
+next_command(session_t *session, game_clock_t deadline, command_t *command)
+{
+	game_clock_t wait_until;
+
+	for (;;)
+	{
+		if (session->input && poll_input(session->input,
+					session->engine->tick, monotonic_ms() - session->started,
+					command))
+			return (1);
+
+		/* While the script may bring more, it's checked every now and then */
+		wait_until = deadline;
+		if (session->input && input_open(session->input) &&
+				monotonic_ms() + INPUT_POLL_DELAY < deadline)
+			wait_until = monotonic_ms() + INPUT_POLL_DELAY;
+		if (wait_command(session, &wait_until, command))
+			return (1);
+		if (wait_until == deadline)
+			return (0);
+	}
+}
+
+/*
+ * Simulation thread: runs the engine ticks, each one lasting the current
+ * delay or until a player presses a key or the script sends a command,
+ * and publishes a frame after each
+ */
+static void*
+simulate(void *arg)
+{
+	session_t *session = arg;
+	engine_t *engine = session->engine;
+	game_clock_t deadline;
+	command_t command;
+	game_state_t *state;
+	direction_t bot_move = NORTH;
+	int player, got_command, food;
+
+	session->started = monotonic_ms();
+	if (session->video)
+		write_video_frame(session->video, engine->field->cells);
+	publish_frame(session, 0, 0);
+	while (engine->running)
+	{
+		deadline = monotonic_ms() + (game_clock_t)engine->delay;
+
+		/* The computer thinks its move while waiting for the players */
+		if (session->bot)
+		{
+			state = capture_game(engine, engine->tick);
+			start_mcts(session->bot, state, 1, (game_clock_t)engine->delay *
+					MCTS_TIME_SHARE / 100);
+			delete_game_state(state);
+		}
+
+		/* Steering a snake nobody may steer is no command either */
+		do
+			got_command = next_command(session, deadline, &command);
+		while (got_command && (command.type == CMD_OTHER ||
+					(command.type == CMD_STEER &&
+					 !steerable(session, command.player))));
+		if (session->bot)
+			bot_move = finish_mcts(session->bot);
+
+		player = -1;
+		if (got_command)
+		{
+			switch (command.type)
+			{
+				case CMD_STEER:
+					steer(engine, command.player, command.direction);
+					player = command.player;
+					break;
+				case CMD_PAUSE:
+					/* The game clock stands still until any key is pressed */
+					publish_frame(session, 1, 0);
+					wait_command(session, NULL, &command);
+					publish_frame(session, 0, 0);
+					continue;
+				case CMD_QUIT:
+					quit_engine(engine);
+					continue;
+				case CMD_OTHER:
+					break;
+			}
+		}
+
+		/* Its move only applies when both snakes advance */
+		if (session->bot && player == -1)
+			steer(engine, 1, bot_move);
+		if (session->autopilot && player == -1)
+		{
+			steer(engine, 0, autopilot_move(session->autopilot, engine, 0));
+
+			/* Food the autopilot can't take is put somewhere else */
+			if ((food = autopilot_dropped_food(session->autopilot)) != -1 &&
+					add_food(engine->field, engine->snakes[0]->head->y,
+						engine->snakes[0]->head->x))
+				set_cell(engine->field, food / engine->field->width,
+						food % engine->field->width, EMPTY);
+		}
+
+		/*
+		 * Every tick is a delay of game time, however long it was waited
+		 * for, so items expire the same way in a replay at any speed
+		 */
+		advance_clock(engine->field, (game_clock_t)engine->delay);
+		step_engine(engine, player);
+		if (session->video)
+			write_video_frame(session->video, engine->field->cells);
+		publish_frame(session, 0, 0);
+	}
+
+	publish_frame(session, 0, 1);
+	return (NULL);
+}
+
+/*
+ * Translate a key into a command. Keys functionality depends on
+ * two_players mode
+ */
+static command_t
+key_to_command(int key, int two_players)
+{
+	command_t command = {CMD_STEER, 0, NORTH};
+
+	switch (key)
+	{
+		case 'w':
+		case 'k':
+			command.direction = NORTH;
+			break;
+		case 'a':
+		case 'h':
+			command.direction = WEST;
+			break;
+		case 's':
+		case 'j':
+			command.direction = SOUTH;
+			break;
+		case 'd':
+		case 'l':
+			command.direction = EAST;
+			break;
+		case KEY_UP:
+			command.player = two_players;
+			command.direction = NORTH;
+			break;
+		case KEY_LEFT:
+			command.player = two_players;
+			command.direction = WEST;
+			break;
+		case KEY_RIGHT:
+			command.player = two_players;
+			command.direction = EAST;
+			break;
+		case KEY_DOWN:
+			command.player = two_players;
+			command.direction = SOUTH;
+			break;
+		case 'p':
+			command.type = CMD_PAUSE;
+			break;
+		case 'q':
+			command.type = CMD_QUIT;
+			break;
+		default:
+			command.type = CMD_OTHER;
+	}
+
+	return (command);
+}
+
+/*
+ * Return the number of processors, to think with all of them
+ */
+static int
+processors(void)
+{
+#ifdef _WIN32
+	return (1);
+#else
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return (n > 0 ? (int)n : 1);
+#endif
+}
+
+/*
+ * Return the terminal rows the map takes
+ */
+static int
+screen_rows(const arguments_t *args)
+{
+	return (args->half_blocks ? (args->height + 1) / 2 : args->height);
+}
+
+/*
+ * Initialize data structures, start the simulation thread and render its
+ * frames until the game ends. This thread makes all the curses calls
+ */
+static void
+start(arguments_t *args)
+{
+	WINDOW *w_score, *w_game, *w_keys;  /* w_keys shows the minimap if any */
+	session_t session;
+	pthread_t simulation;
+	pthread_condattr_t cond_attributes;
+	engine_t *engine;
+	frame_t *frame;
+	chtype *line = NULL, *minimap_line = NULL;
+	cchar_t *wide_line = NULL;
+	game_clock_t next_update = 0;
+	int rows = screen_rows(args), w_game_y, w_keys_height, key;
+	int finished = 0, pending = 0;
+	int keyboard = !args->input || strcmp(args->input, "-");
+	const struct timespec poll_delay = {0, INPUT_POLL_DELAY * 1000000L};
 
 	set_curses_properties();
+	init_cell_glyphs();
+	init_minimap_glyphs();
+	if (args->half_blocks && !init_half_block_glyphs())
+	{
+		endwin();
+		fputs("Terminal without enough colors for --half-blocks\n", stderr);
+		exit(1);
+	}
 
 	/* Title */
 	attron(COLOR_PAIR(PAIR_TITLE) | A_BOLD);
@@ -269,179 +849,122 @@ start(arguments_t *args)
 	attroff(COLOR_PAIR(PAIR_TITLE) | A_BOLD);
 	wnoutrefresh(stdscr);
 
-	w_game_y = (LINES+3)/2 - args->height/2;  /* Starting line of w_game */
+	w_game_y = (LINES+3)/2 - rows/2;  /* Starting line of w_game */
 	w_score = newwin(1, COLS - WIDTH_W_KEYS - 4, w_game_y - 1, 1);
-	w_game = newwin(args->height, args->width, w_game_y, 1);
-	w_keys_height = args->two_players ? 18 : 11;
+	w_game = newwin(rows, args->width, w_game_y, 1);
+	if (args->half_blocks)
+		wide_line = malloc(sizeof(cchar_t) * args->width);
+	else
+		line = malloc(sizeof(chtype) * args->width);
+
+	engine = init_engine(args);
+	session.engine = engine;
+	session.minimap = NULL;
+	session.video = NULL;
+	if (args->export_video && !(session.video = open_video(args->export_video,
+					args->height, args->width, args->video_scale,
+					1000, args->starting_delay)))
+	{
+		endwin();
+		fputs("Could not open the video file\n", stderr);
+		exit(1);
+	}
+	session.bot = args->ai_opponent ? init_mcts(processors()) : NULL;
+	session.autopilot = args->autopilot ? init_autopilot(engine) : NULL;
+	session.input = NULL;
+	if (args->input && !(session.input = open_input(args->input)))
+	{
+		endwin();
+		fputs("Could not open the input file\n", stderr);
+		exit(1);
+	}
+	session.frame_size = sizeof(frame_t) +
+		sizeof(cell_byte_t) * args->height * args->width;
+
+	/* The minimap fits in the place of the keys, leaving room for a border */
+	if (args->minimap)
+	{
+		session.minimap = init_minimap(engine->field, LINES - 4,
+				WIDTH_W_KEYS - 2);
+		session.frame_size +=
+			(size_t)session.minimap->rows * session.minimap->cols;
+		minimap_line = malloc(sizeof(chtype) * session.minimap->cols);
+		w_keys_height = session.minimap->rows + 2;
+	}
+	else
+		w_keys_height = args->two_players && !args->ai_opponent ? 18 : 11;
 	w_keys = newwin(w_keys_height, WIDTH_W_KEYS, LINES/2 - w_keys_height/2,
 			COLS - WIDTH_W_KEYS - 1);
+	if (args->minimap)
+		draw_minimap_frame(w_keys);
+	else
+		draw_keys(w_keys, args->two_players && !args->ai_opponent);
 
-	field = init_field(args->height, args->width, args->permill_obstacles);
-	snake = init_snake(field, HEAD);
-	snake2= args->two_players ? init_snake(field, HEAD2) : NULL;
-	add_food(field);
-
-	draw_keys(w_keys, args->two_players);
-
-	/* Mainloop */
-	score = 0;
-	score2 = 0;
-	score_last_change = 0;
-	died = 0;
-	keep_mainloop = 1;
-	delay = args->starting_delay;
-	timeout((int)delay);
-	while (keep_mainloop)
+	/* Simulation thread */
+	session.frames = init_spsc_ring(FRAME_SLOTS, session.frame_size);
+	session.commands = init_spsc_ring(COMMAND_SLOTS, sizeof(command_t));
+	pthread_mutex_init(&session.lock, NULL);
+	pthread_condattr_init(&cond_attributes);
+#ifndef _WIN32
+	pthread_condattr_setclock(&cond_attributes, CLOCK_MONOTONIC);
+#endif
+	pthread_cond_init(&session.command_ready, &cond_attributes);
+	pthread_condattr_destroy(&cond_attributes);
+	if (pthread_create(&simulation, NULL, simulate, &session) != 0)
 	{
-		remove_expired_items(field);
-		if (args->two_players)
-			redraw_score(w_score, score, &score2);
-		else
-			redraw_score(w_score, score, NULL);
-		redraw_game(w_game, field, snake->direction,
-				args->two_players ? snake2->direction : 0);
-		doupdate();
-
-		/* Get user input */
-		action_who = AC_PLAYER;
-		switch (getch())
-		{
-			case ERR:
-				action_who = AC_TIMEOUT;
-				break;
-			case 'w':
-			case 'k':
-				snake->direction = NORTH;
-				break;
-			case 'a':
-			case 'h':
-				snake->direction = WEST;
-				break;
-			case 's':
-			case 'j':
-				snake->direction = SOUTH;
-				break;
-			case 'd':
-			case 'l':
-				snake->direction = EAST;
-				break;
+		endwin();
+		fputs("Could not start the simulation thread\n", stderr);
+		exit(1);
+	}
 
-				/* Keys functionality depends on two_players mode */
-			case KEY_UP:
-				if (args->two_players)
-				{
-					snake2->direction = NORTH;
-					action_who = AC_PLAYER2;
-				}
-				else
-					snake->direction = NORTH;
-				break;
-			case KEY_LEFT:
-				if (args->two_players)
-				{
-					snake2->direction = WEST;
-					action_who = AC_PLAYER2;
-				}
-				else
-					snake->direction = WEST;
-				break;
-			case KEY_RIGHT:
-				if (args->two_players)
-				{
-					snake2->direction = EAST;
-					action_who = AC_PLAYER2;
-				}
-				else
-					snake->direction = EAST;
-				break;
-			case KEY_DOWN:
-				if (args->two_players)
-				{
-					snake2->direction = SOUTH;
-					action_who = AC_PLAYER2;
-				}
-				else
-					snake->direction = SOUTH;
-				break;
-			case 'p':
-				pause(w_game, field, delay);
-				break;
-			case 'q':
-				keep_mainloop = 0;
-		}
+	/*
+	 * Mainloop: forward keys and draw the frames that are ready. When the
+	 * script comes from stdin there's no keyboard, and curses must not
+	 * look at stdin for typeahead either
+	 */
+	if (keyboard)
+		timeout(INPUT_POLL_DELAY);
+	else
+		typeahead(-1);
+	while (!finished)
+	{
+		if (!keyboard)
+			nanosleep(&poll_delay, NULL);
+		else if ((key = getch()) != ERR)
+			send_command(&session, key_to_command(key,
+						args->two_players && !args->ai_opponent));
 
-		/* Move the snake */
-		for (int i = 0; i <= 1 && keep_mainloop; i++)
+		/*
+		 * Each frame is a whole snapshot, so only the newest one is drawn.
+		 * Drawing doesn't output anything yet: while the terminal is behind
+		 * the windows gather the changes of every frame skipped meanwhile
+		 */
+		if ((frame = skip_to_last_slot(session.frames)))
 		{
-			if (i == 0) /* Player turn */
-			{
-				/* Skip to player2 if the action was of him */
-				if (action_who == AC_PLAYER2)
-					continue;
-				snakex = snake;
-				scorex = &score;
-			}
-			else /* Player2 turn */
-			{
-				if (!args->two_players || action_who == AC_PLAYER)
-					break;
-				snakex = snake2;
-				scorex = &score2;
-			}
-
-			switch (advance(field, snakex))
-			{
-				case EMPTY:
-					break;
-				case SNAKE:
-				case HEAD:
-				case HEAD2:
-				case BORDER:
-				case OBSTACLE:
-					died = 1;
-					keep_mainloop = 0;
-					break;
-				case FOOD:
-					add_food(field);
-					*scorex += POINTS_FOOD;
-
-					/* Delay reduction */
-					if (delay > args->minimum_delay)
-						delay -= args->step_delay;
-					else
-						delay = args->minimum_delay;
-					timeout((int)delay);
-
-					/* Items generation */
-					if (rand() % args->probability_shortener == 0)
-						add_temp_item(field, SHORTENER, args->duration_shortener);
-					if (rand() % args->probability_decelerator == 0)
-						add_temp_item(field, DECELERATOR, args->duration_decelerator);
-					if (rand() % args->probability_extra_points == 0)
-						add_temp_item(field, EXTRA_POINTS, args->duration_extra_points);
-					break;
-				case SHORTENER:
-					*scorex += POINTS_SHORTENER;
-					break;
-				case DECELERATOR:
-					*scorex += POINTS_DECELERATOR;
-					delay = args->starting_delay;
-					timeout((int)delay);
-					break;
-				case EXTRA_POINTS:
-					*scorex += POINTS_EXTRA_POINTS;
-					break;
-			}
-
-			/* Map change */
-			if (!args->disable_map_change &&
-					*scorex >= score_last_change + args->score_step_map_change)
-			{
-				change_obstacles(field);
-				score_last_change = *scorex;
-			}
+			if (args->two_players)
+				redraw_score(w_score, frame->scores[0], &frame->scores[1]);
+			else
+				redraw_score(w_score, frame->scores[0], NULL);
+			if (args->half_blocks)
+				redraw_game_half_blocks(w_game, frame->cells, args->height,
+						args->width, wide_line);
+			else
+				redraw_game(w_game, frame->cells, args->height, args->width, line,
+						frame->directions[0], frame->directions[args->two_players]);
+			if (session.minimap)
+				redraw_minimap(w_keys, frame->cells + args->height * args->width,
+						session.minimap->rows, session.minimap->cols, minimap_line);
+			if (frame->paused)
+				draw_pause(w_game);
+			finished = frame->finished;
+			pop_slot(session.frames);
+			pending = 1;
 		}
+
+		if (pending && update_terminal(&next_update, finished))
+			pending = 0;
 	}
+	pthread_join(simulation, NULL);
 
 	/* Kill Ncurses */
 	delwin(w_score);
@@ -451,28 +974,41 @@ start(arguments_t *args)
 
 	if (args->two_players)
 	{
-		if (died)
+		if (engine->loser != -1)
 		{
-			printf("Player %d died first\n", snakex == snake ? 1 : 2);
+			printf("Player %d died first\n", engine->loser + 1);
 			puts("====================");
 		}
-		printf("Player 1 score: %u\n", score);
-		printf("Player 2 score: %u\n", score2);
+		printf("Player 1 score: %u\n", engine->scores[0]);
+		printf("Player 2 score: %u\n", engine->scores[1]);
 	}
 	else
-		printf("Your score: %u\n", score);
+		printf("Your score: %u\n", engine->scores[0]);
+	if (session.video && !close_video(session.video))
+		fputs("Could not write the whole video\n", stderr);
 
 	/* Free the memory */
-	delete_snake(snake);
-	if (args->two_players)
-		delete_snake(snake2);
-	delete_field(field);
-
+	delete_engine(engine);
+	if (session.input)
+		close_input(session.input);
+	if (session.minimap)
+		delete_minimap(session.minimap);
+	if (session.bot)
+		delete_mcts(session.bot);
+	if (session.autopilot)
+		delete_autopilot(session.autopilot);
+	delete_spsc_ring(session.frames);
+	delete_spsc_ring(session.commands);
+	pthread_mutex_destroy(&session.lock);
+	pthread_cond_destroy(&session.command_ready);
+	free(line);
+	free(wide_line);
+	free(minimap_line);
 }
 
 /*
  * Set default values in unspecified options. Also checks terminal size.
- * NEEDS INITIALIZED NCURSES
+ * NEEDS INITIALIZED NCURSES, unless playing through the bot protocol
  */
 static void
 set_default_options(arguments_t *args)
@@ -480,7 +1016,7 @@ set_default_options(arguments_t *args)
 	/* Size settings */
 	if (args->use_terminal_dimensions)
 	{
-		args->height = LINES - 4;
+		args->height = args->half_blocks ? 2 * (LINES - 4) : LINES - 4;
 		args->width = COLS - WIDTH_W_KEYS - 3;
 	}
 	else
@@ -492,14 +1028,14 @@ set_default_options(arguments_t *args)
 	}
 
 	/* Check terminal size */
-	if (args->height + 3 > LINES)
+	if (args->bot_protocol == -1 && screen_rows(args) + 3 > LINES)
 	{
 		endwin();
 		delete_arguments(args);
 		fputs("Terminal height too small\n", stderr);
 		exit(1);
 	}
-	if (args->width + WIDTH_W_KEYS + 3 > COLS)
+	if (args->bot_protocol == -1 && args->width + WIDTH_W_KEYS + 3 > COLS)
 	{
 		endwin();
 		delete_arguments(args);
@@ -509,7 +1045,22 @@ set_default_options(arguments_t *args)
 
 	/* Obstacles settings */
 	if (args->permill_obstacles == -1)
-		args->permill_obstacles = DEFAULT_PERMILL_OBSTACLES;
+	{
+		switch (args->obstacle_layout)
+		{
+			case LAYOUT_UNIFORM:
+				args->permill_obstacles = DEFAULT_PERMILL_OBSTACLES;
+				break;
+			case LAYOUT_CAVES:
+				args->permill_obstacles = DEFAULT_PERMILL_CAVES;
+				break;
+			case LAYOUT_MAZE:
+				args->permill_obstacles = DEFAULT_PERMILL_MAZE;
+				break;
+			case LAYOUT_ARENA:
+				args->permill_obstacles = DEFAULT_PERMILL_ARENA;
+		}
+	}
 
 	/* Delay settings */
 	if (args->starting_delay == -1)
@@ -540,14 +1091,38 @@ set_default_options(arguments_t *args)
 	/* Map change */
 	if (args->score_step_map_change == -1)
 		args->score_step_map_change = DEFAULT_SCORE_STEP_MAP_CHANGE;
+
+	/* Recording settings */
+	if (args->video_scale == -1)
+		args->video_scale = DEFAULT_VIDEO_SCALE;
 }
 
 int
 main(int argc, char *argv[])
 {
 	arguments_t *args = parse_arguments(argc, argv);
+	recorder_t *recorder = NULL;
+	int status;
+
+	/* Bots play without terminal */
+	if (args->bot_protocol != -1)
+	{
+		srand((unsigned int)time(NULL));
+		set_default_options(args);
+		status = run_bot_protocol(args, args->bot_protocol);
+		delete_arguments(args);
+		return (status);
+	}
+
+	if (args->asciicast && !(recorder = start_recording(args->asciicast)))
+	{
+		delete_arguments(args);
+		fputs("Could not start the recording\n", stderr);
+		exit(1);
+	}
 
 	srand((unsigned int)time(NULL));
+	setlocale(LC_ALL, "");
 	initscr();
 
 	cbreak();             /* Do not buffer keypresses */
@@ -559,5 +1134,8 @@ main(int argc, char *argv[])
 	start(args);
 	delete_arguments(args);
 
+	if (recorder && !finish_recording(recorder))
+		fputs("Could not write the whole recording\n", stderr);
+
 	return (0);
 }
@@ -0,0 +1,488 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <game_state.h>
+#include <config.h>
+#include <flat_map.h>
+#include <string.h>
+
+/*
+ * Return the bytes of the map rounded up so the body rings are aligned
+ */
+static size_t
+map_size(int cells)
+{
+	return (((size_t)cells + sizeof(int) - 1) / sizeof(int) * sizeof(int));
+}
+
+/*
+ * Return the ring of body cells of player
+ */
+static int*
+body_of(const game_state_t *state, int player)
+{
+	return ((int*)(state->map + map_size(state->cells)) +
+			(size_t)player * state->cells);
+}
+
+/*
+ * Set the size of the map and the number of players of state
+ */
+static void
+shape_game_state(game_state_t *state, int height, int width, int n_players)
+{
+	state->height = height;
+	state->width = width;
+	state->cells = height * width;
+	state->n_players = n_players;
+}
+
+/*
+ * Allocate a state for a height x width map and n_players, with its own
+ * room for flood fills after the body rings
+ */
+static game_state_t*
+alloc_game_state(int height, int width, int n_players)
+{
+	size_t size = game_state_size(height, width, n_players);
+	game_state_t *state = malloc(size + sizeof(int) * height * width);
+
+	shape_game_state(state, height, width, n_players);
+	state->queue = (int*)((unsigned char*)state + size);
+	return (state);
+}
+
+/*
+ * Return a random empty cell reachable from the cell near, or -1 if
+ * there's none
+ */
+static int
+random_reachable_cell(game_state_t *state, int near)
+{
+	if (!state->split)
+		return (flat_random_empty(state->map, state->cells, &state->rng));
+	return (flat_random_reachable(state->map, state->width, state->cells,
+				&state->rng, state->queue, near));
+}
+
+/*
+ * Place a temporal item of type reachable from near, lasting duration
+ * milliseconds
+ */
+static void
+add_item(game_state_t *state, cell_t type, game_clock_t duration, int near)
+{
+	int cell;
+
+	if (state->n_items == GAME_STATE_MAX_ITEMS ||
+			(cell = random_reachable_cell(state, near)) == -1)
+		return;
+
+	state->map[cell] = type;
+	state->item_cell[state->n_items] = cell;
+	state->item_end[state->n_items] = state->clock + duration;
+	state->n_items++;
+}
+
+/*
+ * Forget the item in cell, if any, without touching the map
+ */
+static void
+take_item(game_state_t *state, int cell)
+{
+	for (int k = 0; k < state->n_items; k++)
+	{
+		if (state->item_cell[k] == cell)
+		{
+			state->n_items--;
+			state->item_cell[k] = state->item_cell[state->n_items];
+			state->item_end[k] = state->item_end[state->n_items];
+			return;
+		}
+	}
+}
+
+/*
+ * Apply the obstacles of a random layout to the map. Busy cells don't get
+ * an obstacle, as in the field
+ */
+static void
+change_layout(game_state_t *state)
+{
+	const cell_byte_t *layout = state->layouts + (size_t)state->cells *
+		rng_below(&state->rng, (uint32_t)state->n_layouts);
+
+	for (int i = 0; i < state->cells; i++)
+	{
+		if (state->map[i] == OBSTACLE && layout[i] != OBSTACLE)
+			state->map[i] = EMPTY;
+		else if (state->map[i] == EMPTY && layout[i] == OBSTACLE)
+			state->map[i] = OBSTACLE;
+	}
+
+	/* Snakes may keep apart what the layout connected */
+	state->split = 1;
+}
+
+/*
+ * Move the head of snake to cell, leaving the tail where it was. Whoever
+ * calls it has already checked whether blocking cell may split the map
+ */
+static void
+move_head(game_state_t *state, int player, int cell)
+{
+	state_snake_t *snake = &state->snakes[player];
+	int slot = snake->tail + snake->length;
+
+	if (slot >= state->cells)
+		slot -= state->cells;
+	state->map[snake->head] = SNAKE;
+	state->map[cell] = snake->head_type;
+	body_of(state, player)[slot] = cell;
+	snake->head = cell;
+	snake->length++;
+}
+
+/*
+ * Move the head of snake to cell, leaving the tail where it was
+ */
+static void
+append_head(game_state_t *state, int player, int cell)
+{
+	if (!state->split)
+		state->split = flat_may_split(state->map, state->width, cell);
+	move_head(state, player, cell);
+}
+
+/*
+ * Take n cells from the tail of the snake of player
+ */
+static void
+delete_tail(game_state_t *state, int player, int n)
+{
+	state_snake_t *snake = &state->snakes[player];
+	const int *body = body_of(state, player);
+
+	for (int i = 0; i < n; i++)
+	{
+		state->map[body[snake->tail]] = EMPTY;
+		if (++snake->tail == state->cells)
+			snake->tail = 0;
+	}
+	snake->length -= n;
+}
+
+/*
+ * Advance the snake of player and apply what it finds, as move_player
+ */
+static void
+move_player(game_state_t *state, int player)
+{
+	const arguments_t *args = state->args;
+	const int offsets[4] = {-state->width, 1, -1, state->width};
+	state_snake_t *snake = &state->snakes[player];
+	int next = snake->head + offsets[snake->direction], neck;
+	cell_t type = state->map[next];
+
+	/* Going against the neck turns the snake around, as in advance */
+	if (type == SNAKE && snake->length > 1)
+	{
+		neck = snake->tail + snake->length - 2;
+		if (neck >= state->cells)
+			neck -= state->cells;
+		if (next == body_of(state, player)[neck])
+		{
+			snake->direction = (unsigned char)(SOUTH - snake->direction);
+			next = snake->head + offsets[snake->direction];
+			type = state->map[next];
+		}
+	}
+
+	switch (type)
+	{
+		case SHORTENER:
+			delete_tail(state, player, (snake->length - 1) / 2);
+			state->scores[player] += POINTS_SHORTENER;
+			take_item(state, next);
+			append_head(state, player, next);
+			delete_tail(state, player, 1);
+			break;
+		case DECELERATOR:
+			state->scores[player] += POINTS_DECELERATOR;
+			state->delay = args->starting_delay;
+			take_item(state, next);
+			append_head(state, player, next);
+			delete_tail(state, player, 1);
+			break;
+		case EXTRA_POINTS:
+			state->scores[player] += POINTS_EXTRA_POINTS;
+			take_item(state, next);
+			append_head(state, player, next);
+			delete_tail(state, player, 1);
+			break;
+		case EMPTY:
+			append_head(state, player, next);
+			delete_tail(state, player, 1);
+			break;
+		case FOOD:
+			append_head(state, player, next);
+			if ((state->food = random_reachable_cell(state, next)) != -1)
+				state->map[state->food] = FOOD;
+			state->scores[player] += POINTS_FOOD;
+
+			if (state->delay > args->minimum_delay)
+				state->delay -= args->step_delay;
+			else
+				state->delay = args->minimum_delay;
+
+			if (rng_below(&state->rng, (uint32_t)args->probability_shortener) == 0)
+				add_item(state, SHORTENER,
+						(game_clock_t)args->duration_shortener * 1000, snake->head);
+			if (rng_below(&state->rng, (uint32_t)args->probability_decelerator) == 0)
+				add_item(state, DECELERATOR,
+						(game_clock_t)args->duration_decelerator * 1000, snake->head);
+			if (rng_below(&state->rng, (uint32_t)args->probability_extra_points) == 0)
+				add_item(state, EXTRA_POINTS,
+						(game_clock_t)args->duration_extra_points * 1000, snake->head);
+			break;
+		default:
+			state->loser = player;
+			state->running = 0;
+			return;
+	}
+
+	/* Map change */
+	if (state->layouts && !args->disable_map_change &&
+			state->scores[player] >= state->score_last_change +
+			(unsigned int)args->score_step_map_change)
+	{
+		change_layout(state);
+		state->score_last_change = state->scores[player];
+	}
+}
+
+size_t
+game_state_size(int height, int width, int n_players)
+{
+	size_t cells = (size_t)height * width;
+	size_t size = sizeof(game_state_t) + map_size((int)cells) +
+		sizeof(int) * cells * (size_t)n_players;
+
+	return ((size + _Alignof(game_state_t) - 1) / _Alignof(game_state_t) *
+			_Alignof(game_state_t));
+}
+
+void
+new_game_state(game_state_t *state, const arguments_t *args, int n_players,
+		const cell_byte_t *layouts, int n_layouts, int *queue, uint64_t seed)
+{
+	shape_game_state(state, args->height, args->width, n_players);
+	state->args = args;
+	state->layouts = layouts;
+	state->n_layouts = n_layouts;
+	state->queue = queue;
+	seed_rng(&state->rng, seed);
+	restart_game_state(state);
+}
+
+void
+restart_game_state(game_state_t *state)
+{
+	const cell_byte_t head_types[MAX_PLAYERS] = {HEAD, HEAD2};
+	state_snake_t *snake;
+	int y, x;
+
+	memcpy(state->map, state->layouts + (size_t)state->cells *
+			rng_below(&state->rng, (uint32_t)state->n_layouts),
+			(size_t)state->cells);
+
+	/* Snakes of one cell without direct contact with the borders */
+	state->split = 0;
+	for (int i = 0; i < state->n_players; i++)
+	{
+		snake = &state->snakes[i];
+		snake->direction = (unsigned char)rng_below(&state->rng, 4);
+		do
+		{
+			y = (int)rng_below(&state->rng, (uint32_t)state->height - 4) + 2;
+			x = (int)rng_below(&state->rng, (uint32_t)state->width - 4) + 2;
+		} while (i > 0 && state->map[y * state->width + x] == HEAD);
+		snake->head = y * state->width + x;
+		snake->head_type = head_types[i];
+		snake->tail = 0;
+		snake->length = 1;
+		body_of(state, i)[0] = snake->head;
+		if (!state->split)
+			state->split = flat_passable[state->map[snake->head]] &&
+				flat_may_split(state->map, state->width, snake->head);
+		state->map[snake->head] = snake->head_type;
+		state->scores[i] = 0;
+	}
+
+	state->score_last_change = 0;
+	state->delay = state->args->starting_delay;
+	state->running = 1;
+	state->loser = -1;
+	state->clock = 0;
+	state->tick = 0;
+	state->n_items = 0;
+
+	if ((state->food = random_reachable_cell(state, state->snakes[0].head)) != -1)
+		state->map[state->food] = FOOD;
+}
+
+game_state_t*
+capture_game(const engine_t *engine, uint64_t seed)
+{
+	const field_t *field = engine->field;
+	game_state_t *state = alloc_game_state(field->height, field->width,
+			engine->n_players);
+	const temp_item_t *item;
+	state_snake_t *snake;
+	int *body;
+
+	state->args = engine->args;
+	state->score_last_change = engine->score_last_change;
+	state->layouts = NULL;
+	state->n_layouts = 0;
+	state->delay = engine->delay;
+	state->running = engine->running;
+	state->loser = engine->loser;
+	state->clock = field->clock;
+	state->tick = engine->tick;
+	seed_rng(&state->rng, seed);
+	memcpy(state->map, field->cells, (size_t)state->cells);
+	state->food = -1;
+	for (int i = 0; i < state->cells; i++)
+		if (state->map[i] == FOOD)
+			state->food = i;
+
+	for (int i = 0; i < engine->n_players; i++)
+	{
+		snake = &state->snakes[i];
+		body = body_of(state, i);
+		state->scores[i] = engine->scores[i];
+		snake->direction = (unsigned char)engine->snakes[i]->direction;
+		snake->head_type = (unsigned char)engine->snakes[i]->head_type;
+		snake->tail = 0;
+		snake->length = 0;
+		for (const body_t *node = engine->snakes[i]->tail; node; node = node->next)
+			body[snake->length++] = node->y * state->width + node->x;
+		snake->head = body[snake->length - 1];
+	}
+
+	/* Items past the slots stay in the map without expiring */
+	state->n_items = 0;
+	for (item = field->til; item && state->n_items < GAME_STATE_MAX_ITEMS;
+			item = item->next)
+	{
+		state->item_cell[state->n_items] = item->y * state->width + item->x;
+		state->item_end[state->n_items] = item->scheduled_destruction;
+		state->n_items++;
+	}
+
+	state->split = !flat_connected(state->map, state->width, state->cells,
+			state->queue);
+	return (state);
+}
+
+game_state_t*
+copy_game(const game_state_t *state)
+{
+	game_state_t *copy = alloc_game_state(state->height, state->width,
+			state->n_players);
+
+	clone_game(copy, state);
+	return (copy);
+}
+
+void
+clone_game(game_state_t *dst, const game_state_t *src)
+{
+	const state_snake_t *snake;
+	const int *from;
+	int *to, first, *queue = dst->queue;
+
+	/* Header and map at once, then only the slots of the rings in use */
+	memcpy(dst, src, offsetof(game_state_t, map) + (size_t)src->cells);
+	dst->queue = queue;
+	for (int i = 0; i < src->n_players; i++)
+	{
+		snake = &src->snakes[i];
+		from = body_of(src, i);
+		to = body_of(dst, i);
+		first = snake->length < src->cells - snake->tail ?
+			snake->length : src->cells - snake->tail;
+		memcpy(to + snake->tail, from + snake->tail, sizeof(int) * first);
+		memcpy(to, from, sizeof(int) * (snake->length - first));
+	}
+}
+
+int
+state_body_cell(const game_state_t *state, int player, int position)
+{
+	int slot = state->snakes[player].tail + position;
+
+	if (slot >= state->cells)
+		slot -= state->cells;
+	return (body_of(state, player)[slot]);
+}
+
+void
+step_game_state(game_state_t *state, const int *moves)
+{
+	for (int i = 0; i < state->n_players; i++)
+		if (moves[i] >= 0 && moves[i] < 4)
+			state->snakes[i].direction = (unsigned char)moves[i];
+	state->clock += (game_clock_t)state->delay;
+
+	for (int i = 0; i < state->n_players && state->running; i++)
+		move_player(state, i);
+
+	/* Expired items */
+	for (int k = state->n_items - 1; k >= 0; k--)
+	{
+		if (state->clock >= state->item_end[k])
+		{
+			state->map[state->item_cell[k]] = EMPTY;
+			state->n_items--;
+			state->item_cell[k] = state->item_cell[state->n_items];
+			state->item_end[k] = state->item_end[state->n_items];
+		}
+	}
+	state->tick++;
+}
+
+void
+slide_game_state(game_state_t *state, int direction, int split)
+{
+	const int offsets[4] = {-state->width, 1, -1, state->width};
+	state_snake_t *snake = &state->snakes[0];
+
+	snake->direction = (unsigned char)direction;
+	state->clock += (game_clock_t)state->delay;
+	state->split = split;
+	move_head(state, 0, snake->head + offsets[direction]);
+	delete_tail(state, 0, 1);
+	state->tick++;
+}
+
+void
+delete_game_state(game_state_t *state)
+{
+	free(state);
+}
@@ -0,0 +1,260 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <input.h>
+#include <stdlib.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Bytes of the script read ahead, also the limit of a line */
+#define INPUT_BUFFER_SIZE (1 << 16)
+
+struct input_s
+{
+	int fd;
+	int flags;  /* File status flags of fd before opening, to restore them */
+	int ended;  /* Nothing else will come from fd */
+	int overlong;  /* Dropping the rest of a line too long for the buffer */
+
+	char buffer[INPUT_BUFFER_SIZE];
+	size_t start, end;  /* Bytes not parsed yet */
+
+	/* Next command, waiting to be due */
+	int has_pending, timed;
+	unsigned long due;  /* Tick, or milliseconds if timed */
+	command_t pending;
+};
+
+/*
+ * Read whatever fd has ready, without waiting
+ */
+static void
+fill_buffer(input_t *input)
+{
+	ssize_t length;
+
+	if (input->ended)
+		return;
+	if (input->start > 0)
+	{
+		memmove(input->buffer, input->buffer + input->start,
+				input->end - input->start);
+		input->end -= input->start;
+		input->start = 0;
+	}
+
+	/* One byte is kept to end the last line if it has no newline */
+	length = read(input->fd, input->buffer + input->end,
+			INPUT_BUFFER_SIZE - 1 - input->end);
+	if (length > 0)
+		input->end += (size_t)length;
+	else if (length == 0 || (errno != EAGAIN && errno != EWOULDBLOCK &&
+				errno != EINTR))
+		input->ended = 1;
+}
+
+/*
+ * Return the next whole line of the buffer, without its newline, or NULL
+ * if there isn't any yet. Lines too long for the buffer are dropped up to
+ * their newline
+ */
+static char*
+next_line(input_t *input)
+{
+	char *line = input->buffer + input->start, *end;
+
+	end = memchr(line, '\n', input->end - input->start);
+	if (input->overlong)
+	{
+		input->start = end ? (size_t)(end - input->buffer) + 1 : input->end;
+		if (!end)
+			return (NULL);
+		input->overlong = 0;
+		line = end + 1;
+		end = memchr(line, '\n', input->end - input->start);
+	}
+
+	if (end)
+		input->start = (size_t)(end - input->buffer) + 1;
+	else if (input->ended && input->start < input->end)
+	{
+		end = input->buffer + input->end;
+		input->start = input->end;
+	}
+	else
+	{
+		if (input->end - input->start == INPUT_BUFFER_SIZE - 1)
+		{
+			input->start = input->end;
+			input->overlong = 1;
+		}
+		return (NULL);
+	}
+
+	*end = '\0';
+	return (line);
+}
+
+/*
+ * Parse line into the pending command. Return 0 if it has no command
+ */
+static int
+parse_line(input_t *input, char *line)
+{
+	static const struct
+	{
+		const char *name;
+		int type;
+		direction_t direction;
+	} commands[] = {
+		{"up", CMD_STEER, NORTH},
+		{"down", CMD_STEER, SOUTH},
+		{"left", CMD_STEER, WEST},
+		{"right", CMD_STEER, EAST},
+		{"quit", CMD_QUIT, NORTH},
+	};
+	char *word, *rest;
+	int player = 1;
+
+	line += strspn(line, " \t\r");
+	if (*line == '\0' || *line == '#')
+		return (0);
+
+	input->timed = *line == '@';
+	input->due = strtoul(line + input->timed, &rest, 10);
+	if (rest == line + input->timed)
+		return (0);
+	if (!(word = strtok(rest, " \t\r")))
+		return (0);
+	if ((rest = strtok(NULL, " \t\r")))
+		player = atoi(rest);
+	if (player != 1 && player != 2)
+		return (0);
+
+	for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++)
+	{
+		if (!strcmp(word, commands[i].name))
+		{
+			input->pending.type = commands[i].type;
+			input->pending.direction = commands[i].direction;
+			input->pending.player = player - 1;
+			return (1);
+		}
+	}
+
+	return (0);
+}
+
+input_t*
+open_input(const char *path)
+{
+	input_t *input;
+	int fd = strcmp(path, "-") ? open(path, O_RDONLY) : STDIN_FILENO;
+
+	if (fd == -1)
+		return (NULL);
+
+	input = malloc(sizeof(input_t));
+	input->fd = fd;
+	input->flags = fcntl(fd, F_GETFL);
+	fcntl(fd, F_SETFL, input->flags | O_NONBLOCK);
+	input->ended = input->overlong = 0;
+	input->start = input->end = 0;
+	input->has_pending = 0;
+
+	return (input);
+}
+
+int
+poll_input(input_t *input, unsigned long tick, game_clock_t time,
+		command_t *command)
+{
+	char *line;
+
+	while (!input->has_pending)
+	{
+		if (!(line = next_line(input)))
+		{
+			fill_buffer(input);
+			if (!(line = next_line(input)))
+				return (0);
+		}
+		input->has_pending = parse_line(input, line);
+	}
+
+	if ((input->timed ? time : tick) < input->due)
+		return (0);
+	*command = input->pending;
+	input->has_pending = 0;
+	return (1);
+}
+
+int
+input_open(const input_t *input)
+{
+	return (!input->ended || input->has_pending || input->start < input->end);
+}
+
+void
+close_input(input_t *input)
+{
+	fcntl(input->fd, F_SETFL, input->flags);
+	if (input->fd != STDIN_FILENO)
+		close(input->fd);
+	free(input);
+}
+
+#else
+
+/* Scripts need non-blocking reads, left for POSIX systems */
+
+input_t*
+open_input(const char *path)
+{
+	(void)path;
+	return (NULL);
+}
+
+int
+poll_input(input_t *input, unsigned long tick, game_clock_t time,
+		command_t *command)
+{
+	(void)input;
+	(void)tick;
+	(void)time;
+	(void)command;
+	return (0);
+}
+
+int
+input_open(const input_t *input)
+{
+	(void)input;
+	return (0);
+}
+
+void
+close_input(input_t *input)
+{
+	(void)input;
+}
+
+#endif
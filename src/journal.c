@@ -0,0 +1,368 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <journal.h>
+#include <food_distance.h>
+#include <string.h>
+
+typedef enum
+{
+	ENTRY_CELL,
+	ENTRY_HEAD,
+	ENTRY_TAIL,
+	ENTRY_DIRECTION,
+	ENTRY_ITEM_ADDED,
+	ENTRY_ITEM_TAKEN,
+	ENTRY_CLOCK,
+	ENTRY_OBSTACLES,
+	ENTRY_OBSTACLE_WORD,
+	ENTRY_TICK,
+} entry_type_t;
+
+/*
+ * A change and what it replaced
+ */
+typedef struct
+{
+	entry_type_t type;
+	union
+	{
+		struct { coord_t y, x; cell_t old; } cell;
+		struct { snake_t *snake; body_t *node; } body;  /* Old neck or tail */
+		struct { snake_t *snake; direction_t old; } direction;
+		struct { coord_t y, x; game_clock_t destruction; } item;
+		game_clock_t clock;
+		struct { bitplane_t *layout; int next_word; } obstacles;
+		struct { int word; uint64_t old; } obstacle_word;
+		struct
+		{
+			unsigned int scores[MAX_PLAYERS], score_last_change;
+			int delay, running, loser;
+			unsigned long tick;
+		} tick;
+	} u;
+} entry_t;
+
+/*
+ * Entries [first, n_entries) of entries, oldest first. Ticks are the
+ * changes between two ENTRY_TICK, which hold the state of the engine
+ * once they were done
+ */
+struct journal_s
+{
+	entry_t *entries;
+	size_t first, n_entries, size;
+	unsigned long n_ticks;  /* ENTRY_TICK in the journal */
+};
+
+journal_t*
+init_journal(void)
+{
+	journal_t *journal = malloc(sizeof(journal_t));
+
+	journal->size = 256;
+	journal->entries = malloc(sizeof(entry_t) * journal->size);
+	journal->first = 0;
+	journal->n_entries = 0;
+	journal->n_ticks = 0;
+	return (journal);
+}
+
+/*
+ * Deallocate what entry owns, as it's forgotten
+ */
+static void
+release_entry(entry_t *entry)
+{
+	if (entry->type == ENTRY_TAIL)
+		free(entry->u.body.node);
+	else if (entry->type == ENTRY_OBSTACLES && entry->u.obstacles.layout)
+		delete_bitplane(entry->u.obstacles.layout);
+}
+
+/*
+ * Return a new entry of type at the end of journal
+ */
+static entry_t*
+push_entry(journal_t *journal, entry_type_t type)
+{
+	entry_t *entry;
+
+	if (journal->n_entries == journal->size)
+	{
+		/* Room left by forgotten ticks goes first */
+		if (journal->first > journal->size / 2)
+		{
+			memmove(journal->entries, journal->entries + journal->first,
+					sizeof(entry_t) * (journal->n_entries - journal->first));
+			journal->n_entries -= journal->first;
+			journal->first = 0;
+		}
+		else
+		{
+			journal->size *= 2;
+			journal->entries = realloc(journal->entries,
+					sizeof(entry_t) * journal->size);
+		}
+	}
+
+	entry = &journal->entries[journal->n_entries++];
+	entry->type = type;
+	return (entry);
+}
+
+void
+attach_journal(engine_t *engine, journal_t *journal)
+{
+	engine->field->journal = journal;
+	if (journal)
+	{
+		/* Nothing from before applies to this game, it starts here */
+		for (size_t i = journal->first; i < journal->n_entries; i++)
+			release_entry(&journal->entries[i]);
+		journal->first = 0;
+		journal->n_entries = 0;
+		journal->n_ticks = 0;
+		record_tick(journal, engine);
+	}
+}
+
+/*
+ * Put back what entry replaced
+ */
+static void
+undo_entry(engine_t *engine, const entry_t *entry)
+{
+	field_t *field = engine->field;
+	snake_t *snake;
+	body_t *old_head;
+
+	switch (entry->type)
+	{
+		case ENTRY_CELL:
+			set_cell(field, entry->u.cell.y, entry->u.cell.x, entry->u.cell.old);
+			break;
+		case ENTRY_HEAD:
+			/* The neck is the old head, the same node since the journal keeps them */
+			snake = entry->u.body.snake;
+			old_head = snake->neck;
+			free(snake->head);
+			old_head->next = NULL;
+			snake->head = old_head;
+			snake->neck = entry->u.body.node;
+			break;
+		case ENTRY_TAIL:
+			snake = entry->u.body.snake;
+			entry->u.body.node->next = snake->tail;
+			snake->tail = entry->u.body.node;
+			break;
+		case ENTRY_DIRECTION:
+			entry->u.direction.snake->direction = entry->u.direction.old;
+			break;
+		case ENTRY_ITEM_ADDED:
+			take_temp_item(field, entry->u.item.y, entry->u.item.x);
+			break;
+		case ENTRY_ITEM_TAKEN:
+			restore_temp_item(field, entry->u.item.y, entry->u.item.x,
+					entry->u.item.destruction);
+			break;
+		case ENTRY_CLOCK:
+			field->clock = entry->u.clock;
+			break;
+		case ENTRY_OBSTACLES:
+			if (entry->u.obstacles.layout)
+			{
+				delete_bitplane(field->next_layout);
+				field->next_layout = entry->u.obstacles.layout;
+			}
+			field->next_word = entry->u.obstacles.next_word;
+			break;
+		case ENTRY_OBSTACLE_WORD:
+			field->obstacles->words[entry->u.obstacle_word.word] =
+				entry->u.obstacle_word.old;
+			break;
+		case ENTRY_TICK:
+			memcpy(engine->scores, entry->u.tick.scores, sizeof(engine->scores));
+			engine->score_last_change = entry->u.tick.score_last_change;
+			engine->delay = entry->u.tick.delay;
+			engine->running = entry->u.tick.running;
+			engine->loser = entry->u.tick.loser;
+			engine->tick = entry->u.tick.tick;
+	}
+}
+
+int
+undo_tick(engine_t *engine)
+{
+	journal_t *journal = engine->field->journal;
+	entry_t *entry;
+	int ticks_seen = 0;
+
+	if (!journal || journal->n_ticks < 2)
+		return (0);
+
+	/*
+	 * Back to the end of the tick before the last one, undoing whatever
+	 * came after it. Nothing is recorded meanwhile
+	 */
+	engine->field->journal = NULL;
+	for (;;)
+	{
+		entry = &journal->entries[journal->n_entries - 1];
+		if (entry->type == ENTRY_TICK && ++ticks_seen == 2)
+			break;
+		if (entry->type != ENTRY_TICK)
+			undo_entry(engine, entry);
+		journal->n_entries--;
+	}
+	undo_entry(engine, entry);
+	journal->n_ticks--;
+	engine->field->journal = journal;
+	if (engine->field->food_distance)
+		refresh_food_distance(engine->field->food_distance, engine->field);
+	return (1);
+}
+
+unsigned long
+journal_ticks(const journal_t *journal)
+{
+	return (journal->n_ticks ? journal->n_ticks - 1 : 0);
+}
+
+void
+forget_ticks(journal_t *journal, unsigned long keep)
+{
+	entry_t *entry;
+
+	/* The oldest ENTRY_TICK stays, it's the state the first tick undoes to */
+	while (journal->n_ticks > keep + 1)
+	{
+		release_entry(&journal->entries[journal->first++]);
+		for (;;)
+		{
+			entry = &journal->entries[journal->first];
+			if (entry->type == ENTRY_TICK)
+				break;
+			release_entry(entry);
+			journal->first++;
+		}
+		journal->n_ticks--;
+	}
+}
+
+void
+delete_journal(journal_t *journal)
+{
+	for (size_t i = journal->first; i < journal->n_entries; i++)
+		release_entry(&journal->entries[i]);
+	free(journal->entries);
+	free(journal);
+}
+
+void
+record_cell(journal_t *journal, coord_t y, coord_t x, cell_t old)
+{
+	entry_t *entry = push_entry(journal, ENTRY_CELL);
+
+	entry->u.cell.y = y;
+	entry->u.cell.x = x;
+	entry->u.cell.old = old;
+}
+
+void
+record_head(journal_t *journal, snake_t *snake, body_t *old_neck)
+{
+	entry_t *entry = push_entry(journal, ENTRY_HEAD);
+
+	entry->u.body.snake = snake;
+	entry->u.body.node = old_neck;
+}
+
+void
+record_tail(journal_t *journal, snake_t *snake, body_t *tail)
+{
+	entry_t *entry = push_entry(journal, ENTRY_TAIL);
+
+	entry->u.body.snake = snake;
+	entry->u.body.node = tail;
+}
+
+void
+record_direction(journal_t *journal, snake_t *snake, direction_t old)
+{
+	entry_t *entry = push_entry(journal, ENTRY_DIRECTION);
+
+	entry->u.direction.snake = snake;
+	entry->u.direction.old = old;
+}
+
+void
+record_item_added(journal_t *journal, coord_t y, coord_t x)
+{
+	entry_t *entry = push_entry(journal, ENTRY_ITEM_ADDED);
+
+	entry->u.item.y = y;
+	entry->u.item.x = x;
+}
+
+void
+record_item_taken(journal_t *journal, const temp_item_t *item)
+{
+	entry_t *entry = push_entry(journal, ENTRY_ITEM_TAKEN);
+
+	entry->u.item.y = item->y;
+	entry->u.item.x = item->x;
+	entry->u.item.destruction = item->scheduled_destruction;
+}
+
+void
+record_clock(journal_t *journal, game_clock_t old)
+{
+	push_entry(journal, ENTRY_CLOCK)->u.clock = old;
+}
+
+void
+record_obstacles(journal_t *journal, bitplane_t *layout, int next_word)
+{
+	entry_t *entry = push_entry(journal, ENTRY_OBSTACLES);
+
+	entry->u.obstacles.layout = layout;
+	entry->u.obstacles.next_word = next_word;
+}
+
+void
+record_obstacle_word(journal_t *journal, int word, uint64_t old)
+{
+	entry_t *entry = push_entry(journal, ENTRY_OBSTACLE_WORD);
+
+	entry->u.obstacle_word.word = word;
+	entry->u.obstacle_word.old = old;
+}
+
+void
+record_tick(journal_t *journal, const engine_t *engine)
+{
+	entry_t *entry = push_entry(journal, ENTRY_TICK);
+
+	memcpy(entry->u.tick.scores, engine->scores, sizeof(engine->scores));
+	entry->u.tick.score_last_change = engine->score_last_change;
+	entry->u.tick.delay = engine->delay;
+	entry->u.tick.running = engine->running;
+	entry->u.tick.loser = engine->loser;
+	entry->u.tick.tick = engine->tick;
+	journal->n_ticks++;
+}
@@ -0,0 +1,482 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <mcts.h>
+#include <config.h>
+#include <bitplane.h>
+#include <flat_map.h>
+#include <thread_pool.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+
+/* Nodes of the tree at most, it stops growing once they're used */
+#define MCTS_NODES (1 << 18)
+
+/* Moves of a game down the tree at most, then ticks played at random */
+#define MAX_DEPTH 64
+#define ROLLOUT_TICKS 32
+
+/* 1/ROLLOUT_GREED of the moves of random games are random, the rest greedy */
+#define ROLLOUT_GREED 4
+
+/* Rewards go from 0 (lost) to REWARD_SCALE (won) */
+#define REWARD_SCALE 1024
+
+/* Weight of trying moves with few games against the ones that won most */
+#define EXPLORATION 0.3f
+
+/* Moves are relative to where each snake heads: straight, left or right */
+#define MOVES 3
+
+static const direction_t turns[4][MOVES] = {
+	[NORTH] = {NORTH, WEST, EAST},
+	[EAST] = {EAST, NORTH, SOUTH},
+	[WEST] = {WEST, SOUTH, NORTH},
+	[SOUTH] = {SOUTH, EAST, WEST},
+};
+
+/*
+ * Statistics of the games that went through a position, for each move of
+ * each snake. Children are indexed by the moves of both snakes
+ */
+typedef struct
+{
+	atomic_int child[MOVES * MOVES];  /* Node index, 0 if not expanded */
+	atomic_int visits;
+	atomic_int games[MAX_PLAYERS][MOVES];
+	atomic_llong reward[MAX_PLAYERS][MOVES];
+} node_t;
+
+struct mcts_s
+{
+	thread_pool_t *pool;
+	node_t *nodes;  /* [MCTS_NODES], the root is 0 */
+	atomic_int n_nodes;
+	game_state_t *root;
+	game_state_t **games;  /* Copy of the root for each worker */
+	int player;
+	uint64_t seed;
+	struct timespec deadline;
+	atomic_int stop;
+	atomic_ulong rollouts;
+	pthread_t thread;
+	int running;  /* Whether thread searches */
+};
+
+/*
+ * Return whether the monotonic clock reached deadline
+ */
+static int
+past(const struct timespec *deadline)
+{
+	struct timespec now;
+
+#ifdef _WIN32
+	timespec_get(&now, TIME_UTC);
+#else
+	clock_gettime(CLOCK_MONOTONIC, &now);
+#endif
+	return (now.tv_sec > deadline->tv_sec || (now.tv_sec == deadline->tv_sec &&
+				now.tv_nsec >= deadline->tv_nsec));
+}
+
+/*
+ * Square root good to a fraction of a percent, enough for exploration
+ */
+static float
+approx_sqrt(float x)
+{
+	union { float f; uint32_t i; } u = {x};
+
+	if (x <= 0)
+		return (0);
+	u.i = (u.i >> 1) + 0x1FC00000u;
+	u.f = 0.5f * (u.f + x / u.f);
+	return (0.5f * (u.f + x / u.f));
+}
+
+/*
+ * Natural logarithm of n > 0 good to a few percent: the highest bit and a
+ * straight line between powers of 2
+ */
+static float
+approx_log(int n)
+{
+	int e = highest_bit((uint64_t)n);
+
+	return (0.6931472f * (e + (float)n / (float)(1u << e) - 1.0f));
+}
+
+/*
+ * Return which of the moves of player don't crash right away, as bits
+ */
+static int
+safe_moves(const game_state_t *state, int player)
+{
+	const int offsets[4] = {-state->width, 1, -1, state->width};
+	const state_snake_t *snake = &state->snakes[player];
+	int safe = 0;
+
+	for (int m = 0; m < MOVES; m++)
+		if (flat_passable[state->map[snake->head +
+					offsets[turns[snake->direction][m]]]])
+			safe |= 1 << m;
+	return (safe ? safe : (1 << MOVES) - 1);
+}
+
+/*
+ * Return a random move among safe ones
+ */
+static int
+random_move(int safe, rng_t *rng)
+{
+	int moves[MOVES], n = 0;
+
+	for (int m = 0; m < MOVES; m++)
+		if (safe & (1 << m))
+			moves[n++] = m;
+	return (moves[rng_below(rng, (uint32_t)n)]);
+}
+
+/*
+ * Move of player in a game played at random: mostly the safe one that
+ * gets closest to the food, so random games eat as real ones do
+ */
+static int
+rollout_move(const game_state_t *game, int player, rng_t *rng)
+{
+	const int offsets[4] = {-game->width, 1, -1, game->width};
+	const state_snake_t *snake = &game->snakes[player];
+	int safe = safe_moves(game, player), next, distance, best = -1;
+	int best_distance = 1 << 30;
+
+	if (game->food == -1 || rng_below(rng, ROLLOUT_GREED) == 0)
+		return (random_move(safe, rng));
+	for (int m = 0; m < MOVES; m++)
+	{
+		if (!(safe & (1 << m)))
+			continue;
+		next = snake->head + offsets[turns[snake->direction][m]];
+		distance = abs(next / game->width - game->food / game->width) +
+			abs(next % game->width - game->food % game->width);
+		if (distance < best_distance)
+		{
+			best_distance = distance;
+			best = m;
+		}
+	}
+	return (best);
+}
+
+/*
+ * Pick the move of player in node with the best upper confidence bound
+ * among the safe ones, one without games first, and count a game for it
+ */
+static int
+select_move(node_t *node, int player, int safe, rng_t *rng)
+{
+	float log_visits, score, best_score = -1;
+	int games, best = -1, untried = 0;
+	long long reward;
+
+	for (int m = 0; m < MOVES; m++)
+		if (safe & (1 << m) &&
+				!atomic_load_explicit(&node->games[player][m], memory_order_relaxed))
+			untried |= 1 << m;
+
+	if (untried)
+		best = random_move(untried, rng);
+	else
+	{
+		log_visits = approx_log(atomic_load_explicit(&node->visits,
+					memory_order_relaxed) + 1);
+		for (int m = 0; m < MOVES; m++)
+		{
+			if (!(safe & (1 << m)))
+				continue;
+			games = atomic_load_explicit(&node->games[player][m],
+					memory_order_relaxed);
+			reward = atomic_load_explicit(&node->reward[player][m],
+					memory_order_relaxed);
+			score = (float)reward / ((float)games * REWARD_SCALE) +
+				EXPLORATION * approx_sqrt(log_visits / (float)games);
+			if (score > best_score)
+			{
+				best_score = score;
+				best = m;
+			}
+		}
+	}
+
+	/* Lost until the game comes back with its reward: virtual loss */
+	atomic_fetch_add_explicit(&node->games[player][best], 1,
+			memory_order_relaxed);
+	return (best);
+}
+
+/*
+ * Rewards of the game for each player: whoever died lost, otherwise it's
+ * about who won more points since the root, and who is closer to the food
+ * as a fraction of the points of eating it
+ */
+static void
+rewards_of(const game_state_t *game, const game_state_t *root, int *rewards)
+{
+	int gain[MAX_PLAYERS], diff, head;
+
+	for (int i = 0; i < game->n_players; i++)
+	{
+		gain[i] = (int)(game->scores[i] - root->scores[i]) * game->cells;
+		if (game->food != -1)
+		{
+			head = game->snakes[i].head;
+			gain[i] -= POINTS_FOOD * game->cells *
+				(abs(head / game->width - game->food / game->width) +
+				 abs(head % game->width - game->food % game->width)) /
+				(game->height + game->width);
+		}
+	}
+
+	for (int i = 0; i < game->n_players; i++)
+	{
+		if (game->loser != -1)
+		{
+			rewards[i] = game->loser == i ? 0 : REWARD_SCALE;
+			continue;
+		}
+		diff = game->n_players > 1 ? gain[i] - gain[1 - i] : gain[i];
+		rewards[i] = REWARD_SCALE / 2 + (int)((long long)REWARD_SCALE / 2 * diff /
+			((diff < 0 ? -diff : diff) + 2 * POINTS_FOOD * game->cells));
+	}
+}
+
+/*
+ * Allocate a node of the tree, or return 0 if it's full
+ */
+static int
+new_node(mcts_t *mcts)
+{
+	int i = atomic_fetch_add_explicit(&mcts->n_nodes, 1, memory_order_relaxed);
+
+	return (i < MCTS_NODES ? i : 0);
+}
+
+/*
+ * Play a game from the root down the tree, adding a node where it leaves
+ * it, and at random from there. Then give its rewards to the moves taken
+ */
+static void
+play_game(mcts_t *mcts, game_state_t *game, rng_t *rng)
+{
+	struct { int node, moves[MAX_PLAYERS]; } path[MAX_DEPTH];
+	int moves[MAX_PLAYERS], rewards[MAX_PLAYERS], depth = 0, index = 0, child;
+	int expected;
+	node_t *node;
+
+	clone_game(game, mcts->root);
+	seed_rng(&game->rng, next_rng(rng));
+
+	while (game->running && depth < MAX_DEPTH)
+	{
+		node = &mcts->nodes[index];
+		atomic_fetch_add_explicit(&node->visits, 1, memory_order_relaxed);
+		path[depth].node = index;
+		for (int i = 0; i < game->n_players; i++)
+		{
+			path[depth].moves[i] = select_move(node, i, safe_moves(game, i), rng);
+			moves[i] = turns[game->snakes[i].direction][path[depth].moves[i]];
+		}
+		child = path[depth].moves[0] * MOVES +
+			(game->n_players > 1 ? path[depth].moves[1] : 0);
+		depth++;
+		step_game_state(game, moves);
+
+		if ((index = atomic_load_explicit(&node->child[child],
+						memory_order_acquire)))
+			continue;
+
+		/* Leaving the tree. If another worker expanded it first, its node stays */
+		if ((index = new_node(mcts)))
+		{
+			expected = 0;
+			atomic_compare_exchange_strong_explicit(&node->child[child],
+					&expected, index, memory_order_acq_rel, memory_order_acquire);
+		}
+		break;
+	}
+
+	for (int t = 0; t < ROLLOUT_TICKS && game->running; t++)
+	{
+		for (int i = 0; i < game->n_players; i++)
+			moves[i] = turns[game->snakes[i].direction][rollout_move(game, i,
+					rng)];
+		step_game_state(game, moves);
+	}
+
+	rewards_of(game, mcts->root, rewards);
+	while (depth--)
+	{
+		node = &mcts->nodes[path[depth].node];
+		for (int i = 0; i < game->n_players; i++)
+			atomic_fetch_add_explicit(&node->reward[i][path[depth].moves[i]],
+					rewards[i], memory_order_relaxed);
+	}
+	atomic_fetch_add_explicit(&mcts->rollouts, 1, memory_order_relaxed);
+}
+
+/*
+ * Job of each worker: play games on its copy until time is up
+ */
+static void
+search_job(void *arg, int worker, int n_workers)
+{
+	mcts_t *mcts = arg;
+	rng_t rng;
+
+	(void)n_workers;
+	seed_rng(&rng, mcts->seed + (uint64_t)worker * 0x9E3779B97F4A7C15u);
+	while (!atomic_load_explicit(&mcts->stop, memory_order_relaxed) &&
+			!past(&mcts->deadline))
+		play_game(mcts, mcts->games[worker], &rng);
+}
+
+/*
+ * Search thread: the first worker of the pool
+ */
+static void*
+search(void *arg)
+{
+	mcts_t *mcts = arg;
+
+	run_thread_pool(mcts->pool, search_job, mcts);
+	return (NULL);
+}
+
+mcts_t*
+init_mcts(int n_workers)
+{
+	mcts_t *mcts = malloc(sizeof(mcts_t));
+
+	mcts->pool = init_thread_pool(n_workers);
+	mcts->nodes = calloc(MCTS_NODES, sizeof(node_t));
+	atomic_init(&mcts->n_nodes, 1);
+	mcts->root = NULL;
+	mcts->games = calloc(pool_workers(mcts->pool), sizeof(game_state_t*));
+	mcts->seed = 0;
+	atomic_init(&mcts->stop, 0);
+	atomic_init(&mcts->rollouts, 0);
+	mcts->running = 0;
+	return (mcts);
+}
+
+void
+start_mcts(mcts_t *mcts, const game_state_t *state, int player,
+		game_clock_t budget)
+{
+	int n_workers = pool_workers(mcts->pool), used;
+
+	/* Copies for the workers, made again only if the map changes size */
+	if (mcts->root && (mcts->root->cells != state->cells ||
+				mcts->root->n_players != state->n_players))
+	{
+		delete_game_state(mcts->root);
+		for (int i = 0; i < n_workers; i++)
+			delete_game_state(mcts->games[i]);
+		mcts->root = NULL;
+	}
+	if (!mcts->root)
+	{
+		mcts->root = copy_game(state);
+		for (int i = 0; i < n_workers; i++)
+			mcts->games[i] = copy_game(state);
+	}
+	else
+		clone_game(mcts->root, state);
+
+	/* Only the nodes used by the last search have to be cleared */
+	used = atomic_load(&mcts->n_nodes);
+	memset(mcts->nodes, 0, sizeof(node_t) * (used < MCTS_NODES ? used : MCTS_NODES));
+	atomic_store(&mcts->n_nodes, 1);
+
+	mcts->player = player;
+	mcts->seed += 0xD1B54A32D192ED03u;
+	atomic_store(&mcts->stop, 0);
+	atomic_store(&mcts->rollouts, 0);
+#ifdef _WIN32
+	timespec_get(&mcts->deadline, TIME_UTC);
+#else
+	clock_gettime(CLOCK_MONOTONIC, &mcts->deadline);
+#endif
+	mcts->deadline.tv_sec += (time_t)(budget / 1000);
+	mcts->deadline.tv_nsec += (long)(budget % 1000) * 1000000L;
+	if (mcts->deadline.tv_nsec >= 1000000000L)
+	{
+		mcts->deadline.tv_sec++;
+		mcts->deadline.tv_nsec -= 1000000000L;
+	}
+	mcts->running = pthread_create(&mcts->thread, NULL, search, mcts) == 0;
+	if (!mcts->running)  /* No thread was available, search now */
+		search(mcts);
+}
+
+direction_t
+finish_mcts(mcts_t *mcts)
+{
+	const node_t *root = &mcts->nodes[0];
+	int player = mcts->player, safe, best = -1, games, most = -1;
+
+	atomic_store(&mcts->stop, 1);
+	if (mcts->running)
+		pthread_join(mcts->thread, NULL);
+	mcts->running = 0;
+
+	/* The safe move played the most, straight ahead if none was */
+	safe = safe_moves(mcts->root, player);
+	for (int m = 0; m < MOVES; m++)
+	{
+		games = atomic_load(&root->games[player][m]);
+		if (safe & (1 << m) && games > most)
+		{
+			most = games;
+			best = m;
+		}
+	}
+	return (turns[mcts->root->snakes[player].direction][best]);
+}
+
+unsigned long
+mcts_rollouts(const mcts_t *mcts)
+{
+	return (atomic_load(&mcts->rollouts));
+}
+
+void
+delete_mcts(mcts_t *mcts)
+{
+	if (mcts->root)
+	{
+		delete_game_state(mcts->root);
+		for (int i = 0; i < pool_workers(mcts->pool); i++)
+			delete_game_state(mcts->games[i]);
+	}
+	delete_thread_pool(mcts->pool);
+	free(mcts->nodes);
+	free(mcts->games);
+	free(mcts);
+}
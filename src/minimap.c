@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <minimap.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MINIMAP_SSSE3
+#include <tmmintrin.h>
+#endif
+
+/* A cell type must fit in a pshufb index */
+_Static_assert(CELL_TYPES <= 16, "cell types don't fit in the priority table");
+
+/* Priority of each cell type, padded to 16 for pshufb */
+static const unsigned char priorities[16] = {
+	[EMPTY] = MINIMAP_EMPTY,
+	[SNAKE] = MINIMAP_BODY,
+	[HEAD] = MINIMAP_HEAD,
+	[HEAD2] = MINIMAP_HEAD2,
+	[FOOD] = MINIMAP_FOOD,
+	[BORDER] = MINIMAP_OBSTACLE,
+	[OBSTACLE] = MINIMAP_OBSTACLE,
+	[SHORTENER] = MINIMAP_ITEM,
+	[DECELERATOR] = MINIMAP_ITEM,
+	[EXTRA_POINTS] = MINIMAP_ITEM,
+};
+
+/*
+ * Return the highest priority of the cells in rows [y0, y1) and columns
+ * [x0, x1)
+ */
+static unsigned char
+reduce_block_scalar(const cell_byte_t *cells, int width,
+		int y0, int y1, int x0, int x1)
+{
+	const cell_byte_t *row;
+	unsigned char max = MINIMAP_EMPTY;
+
+	for (int y = y0; y < y1; y++)
+	{
+		row = cells + (size_t)y * width;
+		for (int x = x0; x < x1; x++)
+			if (priorities[row[x]] > max)
+				max = priorities[row[x]];
+	}
+
+	return (max);
+}
+
+#ifdef MINIMAP_SSSE3
+/*
+ * Same as reduce_block_scalar, looking up the priorities of 16 cells at
+ * once with pshufb and keeping the maximum of each lane
+ */
+__attribute__((target("ssse3")))
+static unsigned char
+reduce_block_ssse3(const cell_byte_t *cells, int width,
+		int y0, int y1, int x0, int x1)
+{
+	const __m128i table = _mm_loadu_si128((const __m128i*)priorities);
+	__m128i lanes = _mm_setzero_si128();
+	const cell_byte_t *row;
+	unsigned char max = MINIMAP_EMPTY;
+	int x;
+
+	for (int y = y0; y < y1; y++)
+	{
+		row = cells + (size_t)y * width;
+		for (x = x0; x + 16 <= x1; x += 16)
+			lanes = _mm_max_epu8(lanes, _mm_shuffle_epi8(table,
+						_mm_loadu_si128((const __m128i*)(row + x))));
+		for (; x < x1; x++)
+			if (priorities[row[x]] > max)
+				max = priorities[row[x]];
+	}
+
+	/* Maximum of the lanes */
+	lanes = _mm_max_epu8(lanes, _mm_srli_si128(lanes, 8));
+	lanes = _mm_max_epu8(lanes, _mm_srli_si128(lanes, 4));
+	lanes = _mm_max_epu8(lanes, _mm_srli_si128(lanes, 2));
+	lanes = _mm_max_epu8(lanes, _mm_srli_si128(lanes, 1));
+	if ((unsigned char)_mm_cvtsi128_si32(lanes) > max)
+		max = (unsigned char)_mm_cvtsi128_si32(lanes);
+
+	return (max);
+}
+#endif
+
+/* Chosen by init_minimap following the CPU */
+static unsigned char (*reduce_block)(const cell_byte_t*, int,
+		int, int, int, int) = reduce_block_scalar;
+
+/*
+ * Compute again the block (r, c) of minimap
+ */
+static void
+compute_block(minimap_t *minimap, const field_t *field, int r, int c)
+{
+	int y0 = r * minimap->block_height, x0 = c * minimap->block_width;
+	int y1 = y0 + minimap->block_height, x1 = x0 + minimap->block_width;
+
+	if (y1 > field->height)
+		y1 = field->height;
+	if (x1 > field->width)
+		x1 = field->width;
+	minimap->blocks[r * minimap->cols + c] =
+		reduce_block(field->cells, field->width, y0, y1, x0, x1);
+}
+
+minimap_t*
+init_minimap(field_t *field, int max_rows, int max_cols)
+{
+	minimap_t *minimap = malloc(sizeof(minimap_t));
+	int n_blocks;
+
+#ifdef MINIMAP_SSSE3
+	if (__builtin_cpu_supports("ssse3"))
+		reduce_block = reduce_block_ssse3;
+#endif
+
+	/* Square blocks as long as the rows fit */
+	minimap->block_width = (field->width + max_cols - 1) / max_cols;
+	minimap->block_height = minimap->block_width;
+	if ((field->height + minimap->block_height - 1) / minimap->block_height >
+			max_rows)
+		minimap->block_height = (field->height + max_rows - 1) / max_rows;
+	minimap->rows = (field->height + minimap->block_height - 1) /
+		minimap->block_height;
+	minimap->cols = (field->width + minimap->block_width - 1) /
+		minimap->block_width;
+
+	n_blocks = minimap->rows * minimap->cols;
+	minimap->blocks = malloc(n_blocks);
+	minimap->dirty = malloc(n_blocks);
+	memset(minimap->dirty, 1, n_blocks);
+
+	/* Everything is computed now, so the damage so far isn't needed */
+	for (int i = 0; i < field->height; i++)
+	{
+		field->damage_from[i] = field->width;
+		field->damage_to[i] = 0;
+	}
+	update_minimap(minimap, field);
+
+	return (minimap);
+}
+
+void
+update_minimap(minimap_t *minimap, field_t *field)
+{
+	unsigned char *dirty;
+	int r, c, last;
+
+	/* Blocks touched by the damage */
+	for (int y = 0; y < field->height; y++)
+	{
+		if (field->damage_from[y] >= field->damage_to[y])
+			continue;
+		dirty = minimap->dirty + y / minimap->block_height * minimap->cols;
+		last = (field->damage_to[y] - 1) / minimap->block_width;
+		for (c = field->damage_from[y] / minimap->block_width; c <= last; c++)
+			dirty[c] = 1;
+		field->damage_from[y] = field->width;
+		field->damage_to[y] = 0;
+	}
+
+	for (r = 0; r < minimap->rows; r++)
+	{
+		dirty = minimap->dirty + r * minimap->cols;
+		for (c = 0; c < minimap->cols; c++)
+		{
+			if (dirty[c])
+			{
+				compute_block(minimap, field, r, c);
+				dirty[c] = 0;
+			}
+		}
+	}
+}
+
+void
+delete_minimap(minimap_t *minimap)
+{
+	free(minimap->blocks);
+	free(minimap->dirty);
+	free(minimap);
+}
@@ -0,0 +1,368 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <observation.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define OBSERVATION_SSSE3
+#include <tmmintrin.h>
+#endif
+
+/* A cell type must fit in a pshufb index */
+_Static_assert(CELL_TYPES <= 16, "cell types don't fit in the plane table");
+
+/* The planes that come from the cell types must fit in a byte */
+_Static_assert(PLANE_OTHER_BODY == 8, "cell type planes don't fit in a byte");
+
+/*
+ * Planes of each cell type as seen by players 1 and 2, bit k meaning plane
+ * k, padded to 16 for pshufb. Bodies are taken as the own one and told
+ * apart later
+ */
+static const unsigned char cell_planes[MAX_PLAYERS][16] = {
+	{
+		[BORDER] = 1 << PLANE_WALLS,
+		[OBSTACLE] = 1 << PLANE_WALLS,
+		[SNAKE] = 1 << PLANE_OWN_BODY,
+		[HEAD] = 1 << PLANE_OWN_HEAD,
+		[HEAD2] = 1 << PLANE_OTHER_HEAD,
+		[FOOD] = 1 << PLANE_FOOD,
+		[SHORTENER] = 1 << PLANE_SHORTENER,
+		[DECELERATOR] = 1 << PLANE_DECELERATOR,
+		[EXTRA_POINTS] = 1 << PLANE_EXTRA_POINTS,
+	},
+	{
+		[BORDER] = 1 << PLANE_WALLS,
+		[OBSTACLE] = 1 << PLANE_WALLS,
+		[SNAKE] = 1 << PLANE_OWN_BODY,
+		[HEAD] = 1 << PLANE_OTHER_HEAD,
+		[HEAD2] = 1 << PLANE_OWN_HEAD,
+		[FOOD] = 1 << PLANE_FOOD,
+		[SHORTENER] = 1 << PLANE_SHORTENER,
+		[DECELERATOR] = 1 << PLANE_DECELERATOR,
+		[EXTRA_POINTS] = 1 << PLANE_EXTRA_POINTS,
+	},
+};
+
+/*
+ * Write n cells in the rows of the planes starting at out, plane_size
+ * bytes apart, a byte per cell. cells can be read up to readable
+ */
+static void
+encode_bytes_scalar(const unsigned char *table, const cell_byte_t *cells,
+		int n, int readable, unsigned char *out, size_t plane_size)
+{
+	(void)readable;
+	for (int i = 0; i < n; i++)
+		for (int k = 0; k < PLANE_OTHER_BODY; k++)
+			out[k * plane_size + i] = table[cells[i]] >> k & 1;
+}
+
+/*
+ * Set the bits of n cells in the rows of the planes starting at out,
+ * plane_words words apart, from column onwards
+ */
+static void
+encode_bits_scalar(const unsigned char *table, const cell_byte_t *cells,
+		int n, int readable, uint64_t *out, size_t plane_words, int column)
+{
+	unsigned char planes;
+
+	(void)readable;
+	for (int i = 0; i < n; i++, column++)
+	{
+		planes = table[cells[i]];
+		for (int k = 0; planes; k++, planes >>= 1)
+			if (planes & 1)
+				out[k * plane_words + column / 64] |= (uint64_t)1 << column % 64;
+	}
+}
+
+#ifdef OBSERVATION_SSSE3
+/*
+ * Same as encode_bytes_scalar, looking up the planes of 16 cells at once
+ * with pshufb. The last cells also go 16 at a time if there are readable
+ * cells after them, through a buffer so no more than n are written
+ */
+__attribute__((target("ssse3")))
+static void
+encode_bytes_ssse3(const unsigned char *table, const cell_byte_t *cells,
+		int n, int readable, unsigned char *out, size_t plane_size)
+{
+	const __m128i lookup = _mm_loadu_si128((const __m128i*)table);
+	const __m128i ones = _mm_set1_epi8(1);
+	unsigned char last[16];
+	__m128i planes;
+	int i;
+
+	for (i = 0; i + 16 <= n; i += 16)
+	{
+		planes = _mm_shuffle_epi8(lookup,
+				_mm_loadu_si128((const __m128i*)(cells + i)));
+		for (int k = 0; k < PLANE_OTHER_BODY; k++)
+			_mm_storeu_si128((__m128i*)(out + k * plane_size + i),
+					_mm_and_si128(_mm_srli_epi16(planes, k), ones));
+	}
+	if (i == n)
+		return;
+	if (i + 16 > readable)
+	{
+		encode_bytes_scalar(table, cells + i, n - i, readable, out + i,
+				plane_size);
+		return;
+	}
+
+	planes = _mm_shuffle_epi8(lookup,
+			_mm_loadu_si128((const __m128i*)(cells + i)));
+	for (int k = 0; k < PLANE_OTHER_BODY; k++)
+	{
+		_mm_storeu_si128((__m128i*)last,
+				_mm_and_si128(_mm_srli_epi16(planes, k), ones));
+		memcpy(out + k * plane_size + i, last, (size_t)(n - i));
+	}
+}
+
+/*
+ * Same as encode_bits_scalar, 16 cells at once: the bit of plane k of
+ * every cell is shifted to the top of its byte and packed with pmovmskb.
+ * The last cells also go 16 at a time if there are readable cells after
+ * them, dropping the bits past n
+ */
+__attribute__((target("ssse3")))
+static void
+encode_bits_ssse3(const unsigned char *table, const cell_byte_t *cells,
+		int n, int readable, uint64_t *out, size_t plane_words, int column)
+{
+	const __m128i lookup = _mm_loadu_si128((const __m128i*)table);
+	__m128i planes;
+	uint64_t bits, keep, *word;
+	int i, shift;
+
+	for (i = 0; i < n; i += 16, column += 16)
+	{
+		if (i + 16 > readable)
+		{
+			encode_bits_scalar(table, cells + i, n - i, readable, out,
+					plane_words, column);
+			return;
+		}
+
+		planes = _mm_shuffle_epi8(lookup,
+				_mm_loadu_si128((const __m128i*)(cells + i)));
+		keep = n - i >= 16 ? 0xFFFF : ((uint64_t)1 << (n - i)) - 1;
+		shift = column % 64;
+		for (int k = 0; k < PLANE_OTHER_BODY; k++)
+		{
+			bits = (uint64_t)_mm_movemask_epi8(_mm_slli_epi16(planes, 7 - k)) &
+				keep;
+			word = out + k * plane_words + column / 64;
+			word[0] |= bits << shift;
+			if (shift > 48 && bits >> (64 - shift))  /* Goes on in the next word */
+				word[1] |= bits >> (64 - shift);
+		}
+	}
+}
+#endif
+
+/*
+ * Mark as walls the columns [from, to) of the row of the walls plane
+ */
+static void
+fill_walls(const observation_spec_t *spec, unsigned char *row, int from,
+		int to)
+{
+	uint64_t *words = (uint64_t*)row, mask;
+	int start, end;
+
+	if (spec->format == OBSERVATION_BYTES)
+	{
+		memset(row + from, 1, (size_t)(to - from));
+		return;
+	}
+
+	for (int w = from / 64; w * 64 < to; w++)
+	{
+		start = from > w * 64 ? from - w * 64 : 0;
+		end = to < w * 64 + 64 ? to - w * 64 : 64;
+		mask = ~(uint64_t)0 << start;
+		if (end < 64)
+			mask &= ((uint64_t)1 << end) - 1;
+		words[w] |= mask;
+	}
+}
+
+/*
+ * Set cell (y, x) of the field in plane and clear it in plane clear, if
+ * it's in the window at (top, left)
+ */
+static void
+move_cell(const observation_spec_t *spec, unsigned char *out, int top,
+		int left, int y, int x, plane_t plane, plane_t clear)
+{
+	size_t row_size = observation_row_size(spec);
+	size_t plane_size = row_size * spec->height;
+	unsigned char *row;
+
+	y -= top;
+	x -= left;
+	if (y < 0 || y >= spec->height || x < 0 || x >= spec->width)
+		return;
+
+	row = out + (size_t)y * row_size;
+	if (spec->format == OBSERVATION_BYTES)
+	{
+		row[plane * plane_size + x] = 1;
+		row[clear * plane_size + x] = 0;
+	}
+	else
+	{
+		((uint64_t*)(row + plane * plane_size))[x / 64] |= (uint64_t)1 << x % 64;
+		((uint64_t*)(row + clear * plane_size))[x / 64] &= ~((uint64_t)1 << x % 64);
+	}
+}
+
+/*
+ * Write the window at (top, left) of the height x width map cells, as
+ * seen by player
+ */
+static void
+encode_window(const observation_spec_t *spec, const cell_byte_t *cells,
+		int height, int width, int player, int top, int left,
+		unsigned char *out)
+{
+	const unsigned char *table = cell_planes[player];
+	size_t row_size = observation_row_size(spec);
+	size_t plane_size = row_size * spec->height;
+	int x0 = left > 0 ? left : 0;
+	int x1 = left + spec->width < width ? left + spec->width : width;
+	int y, inside = x1 > x0 ? x1 - x0 : 0;
+	unsigned char *row;
+	int readable;
+	void (*bytes)(const unsigned char*, const cell_byte_t*, int, int,
+			unsigned char*, size_t) = encode_bytes_scalar;
+	void (*bits)(const unsigned char*, const cell_byte_t*, int, int,
+			uint64_t*, size_t, int) = encode_bits_scalar;
+
+#ifdef OBSERVATION_SSSE3
+	if (__builtin_cpu_supports("ssse3"))
+	{
+		bytes = encode_bytes_ssse3;
+		bits = encode_bits_ssse3;
+	}
+#endif
+
+	for (int r = 0; r < spec->height; r++)
+	{
+		row = out + (size_t)r * row_size;
+		y = top + r;
+
+		/* Cells outside the field are only walls, the rest is written below */
+		if (spec->format == OBSERVATION_BITS || y < 0 || y >= height ||
+				inside == 0)
+			for (int k = 0; k < PLANES; k++)
+				memset(row + k * plane_size, 0, row_size);
+		else
+		{
+			memset(row + PLANE_OTHER_BODY * plane_size, 0, row_size);
+			for (int k = 0; inside < spec->width && k < PLANE_OTHER_BODY; k++)
+			{
+				memset(row + k * plane_size, 0, (size_t)(x0 - left));
+				memset(row + k * plane_size + (x0 - left) + inside, 0,
+						(size_t)(spec->width - (x0 - left) - inside));
+			}
+		}
+		if (y < 0 || y >= height || inside == 0)
+		{
+			fill_walls(spec, row, 0, spec->width);
+			continue;
+		}
+		if (inside < spec->width)
+		{
+			fill_walls(spec, row, 0, x0 - left);
+			fill_walls(spec, row, x0 - left + inside, spec->width);
+		}
+
+		readable = (height - y) * width - x0;
+		if (spec->format == OBSERVATION_BYTES)
+			bytes(table, cells + (size_t)y * width + x0, inside, readable,
+					row + (x0 - left), plane_size);
+		else
+			bits(table, cells + (size_t)y * width + x0, inside, readable,
+					(uint64_t*)row, plane_size / sizeof(uint64_t), x0 - left);
+	}
+}
+
+size_t
+observation_row_size(const observation_spec_t *spec)
+{
+	if (spec->format == OBSERVATION_BITS)
+		return ((size_t)(spec->width + 63) / 64 * sizeof(uint64_t));
+	return ((size_t)spec->width);
+}
+
+size_t
+observation_size(const observation_spec_t *spec)
+{
+	return (observation_row_size(spec) * spec->height * PLANES);
+}
+
+void
+encode_observation(const observation_spec_t *spec, const engine_t *engine,
+		int player, void *out)
+{
+	const field_t *field = engine->field;
+	const snake_t *own = engine->snakes[player];
+	int top = 0, left = 0;
+
+	if (spec->egocentric)
+	{
+		top = own->head->y - spec->height / 2;
+		left = own->head->x - spec->width / 2;
+	}
+	encode_window(spec, field->cells, field->height, field->width, player,
+			top, left, out);
+
+	/* The matrix doesn't tell bodies apart, the other snake does */
+	if (engine->n_players > 1)
+		for (body_t *node = engine->snakes[1 - player]->tail;
+				node != engine->snakes[1 - player]->head; node = node->next)
+			move_cell(spec, out, top, left, node->y, node->x,
+					PLANE_OTHER_BODY, PLANE_OWN_BODY);
+}
+
+void
+encode_vec_observations(const observation_spec_t *spec, const vec_env_t *env,
+		void *out)
+{
+	size_t size = observation_size(spec);
+	const game_state_t *state;
+	int top = 0, left = 0;
+
+	for (int game = 0; game < env->n_envs; game++)
+	{
+		state = vec_env_game(env, game);
+		if (spec->egocentric)
+		{
+			top = state->snakes[0].head / env->width - spec->height / 2;
+			left = state->snakes[0].head % env->width - spec->width / 2;
+		}
+		encode_window(spec, state->map, env->height,
+				env->width, 0, top, left, (unsigned char*)out + game * size);
+	}
+}
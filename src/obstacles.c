@@ -0,0 +1,1052 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <obstacles.h>
+#include <rng.h>
+#include <union_find.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define OBSTACLES_AVX2
+#include <immintrin.h>
+#endif
+
+/* Generations of the cellular automaton smoothing the caves */
+#define CAVE_GENERATIONS 5
+
+/* 1/X of the redundant maze walls get opened anyway to make loops */
+#define MAZE_LOOP_PROBABILITY 10
+
+struct obstacle_plan_s
+{
+	pthread_t thread;
+	int running;  /* 0 if the thread couldn't be created */
+	bitplane_t *plane;
+	obstacle_layout_t layout;
+	int permill_obstacles;
+	uint64_t seed;
+};
+
+/*
+ * Return the bits of word w of a row that belong to columns [from, to)
+ */
+static uint64_t
+columns_mask(int w, int from, int to)
+{
+	uint64_t mask = ~(uint64_t)0;
+	int start = from - w * 64, end = to - w * 64;
+
+	if (end <= 0 || start >= 64)
+		return (0);
+	if (start > 0)
+		mask &= ~(uint64_t)0 << start;
+	if (end < 64)
+		mask &= ((uint64_t)1 << end) - 1;
+	return (mask);
+}
+
+/*
+ * Return 64 random bits, each one set with probability permill/1000
+ */
+static uint64_t
+random_word(rng_t *rng, int permill)
+{
+	/* Probability with 10 bits of precision */
+	uint32_t p = (uint32_t)permill * 1024 / 1000;
+	uint64_t word = 0;
+	int k;
+
+	if (p >= 1024)
+		return (~(uint64_t)0);
+
+	/*
+	 * From the least significant bit of p, OR-ing a random word adds half
+	 * of the remaining probability and AND-ing halves it
+	 */
+	for (k = 0; k < 10; k++)
+		word = (p >> k & 1) ? word | next_rng(rng) : word & next_rng(rng);
+	return (word);
+}
+
+/*
+ * Set (value 1) or clear (value 0) the outer ring of cells of plane
+ */
+static void
+fill_ring(bitplane_t *plane, int value)
+{
+	int y, w;
+	uint64_t *row;
+
+	for (y = 0; y < plane->height; y++)
+	{
+		row = plane->words + (size_t)y * plane->stride;
+		if (y == 0 || y == plane->height - 1)
+		{
+			for (w = 0; w < plane->stride; w++)
+				row[w] = value ? columns_mask(w, 0, plane->width) : 0;
+		}
+		else if (value)
+		{
+			set_bit(plane, y, 0);
+			set_bit(plane, y, plane->width - 1);
+		}
+		else
+		{
+			reset_bit(plane, y, 0);
+			reset_bit(plane, y, plane->width - 1);
+		}
+	}
+}
+
+/*
+ * Uniform layout: exactly permill/1000 of the interior cells, all of them
+ * with the same chances
+ */
+static void
+generate_uniform(bitplane_t *plane, int permill_obstacles, rng_t *rng)
+{
+	uint32_t rows = (uint32_t)plane->height - 2, cols = (uint32_t)plane->width - 2;
+	long interior = (long)rows * cols, number_obstacles, i;
+	int y, x, value = 1;
+
+	number_obstacles = interior * permill_obstacles / 1000;
+
+	/*
+	 * When most of the interior is taken it's faster to fill it all and
+	 * punch the free cells back
+	 */
+	if (number_obstacles * 2 > interior)
+	{
+		fill_ring(plane, 1);
+		for (y = 1; y <= (int)rows; y++)
+			for (x = 0; x < plane->stride; x++)
+				plane->words[(size_t)y * plane->stride + x] =
+					columns_mask(x, 0, plane->width);
+		fill_ring(plane, 0);
+		number_obstacles = interior - number_obstacles;
+		value = 0;
+	}
+
+	for (i = 0; i < number_obstacles; i++)
+	{
+		/* Draw again cells already chosen */
+		do
+		{
+			y = (int)rng_below(rng, rows) + 1;
+			x = (int)rng_below(rng, cols) + 1;
+		} while (get_bit(plane, y, x) == value);
+
+		if (value)
+			set_bit(plane, y, x);
+		else
+			reset_bit(plane, y, x);
+	}
+}
+
+/*
+ * Sum across each cell of a row with its west and east neighbours: bit 0 of
+ * the sums to h0 and bit 1 to h1. row has stride words with a 0 word before
+ * and after them
+ */
+static void
+sum_row_scalar(const uint64_t *row, int stride, uint64_t *h0, uint64_t *h1)
+{
+	uint64_t west, east;
+
+	for (int w = 0; w < stride; w++)
+	{
+		/* West neighbours move one column right and east ones left */
+		west = row[w] << 1 | row[w - 1] >> 63;
+		east = row[w] >> 1 | row[w + 1] << 63;
+		h0[w] = west ^ row[w] ^ east;
+		h1[w] = (west & row[w]) | (east & (west ^ row[w]));
+	}
+}
+
+/*
+ * Write to dst the cells of mask that are walls in the next generation,
+ * those whose 3x3 block has 5 or more walls, from the sums of the rows
+ * above (a), at (b) and below (c) them
+ */
+static void
+block_majority_scalar(const uint64_t *const sums[6], const uint64_t *mask,
+		uint64_t *dst, int stride)
+{
+	uint64_t s0, s1, k0, k1, t0, t1, m0, m1;
+
+	for (int w = 0; w < stride; w++)
+	{
+		/* a + b in k1 s1 s0, plus c: 5 or more is bit 3, or 2 and more */
+		s0 = sums[0][w] ^ sums[2][w];
+		k0 = sums[0][w] & sums[2][w];
+		s1 = sums[1][w] ^ sums[3][w] ^ k0;
+		k1 = (sums[1][w] & sums[3][w]) | (k0 & (sums[1][w] ^ sums[3][w]));
+		t0 = s0 ^ sums[4][w];
+		m0 = s0 & sums[4][w];
+		t1 = s1 ^ sums[5][w] ^ m0;
+		m1 = (s1 & sums[5][w]) | (m0 & (s1 ^ sums[5][w]));
+		dst[w] = (dst[w] & ~mask[w]) |
+			(mask[w] & ((k1 & m1) | ((k1 ^ m1) & (t1 | t0))));
+	}
+}
+
+#ifdef OBSTACLES_AVX2
+/*
+ * Same as sum_row_scalar, 4 words at once
+ */
+__attribute__((target("avx2")))
+static void
+sum_row_avx2(const uint64_t *row, int stride, uint64_t *h0, uint64_t *h1)
+{
+	__m256i here, west, east;
+	int w;
+
+	for (w = 0; w + 4 <= stride; w += 4)
+	{
+		here = _mm256_loadu_si256((const __m256i*)(row + w));
+		west = _mm256_loadu_si256((const __m256i*)(row + w - 1));
+		east = _mm256_loadu_si256((const __m256i*)(row + w + 1));
+		west = _mm256_or_si256(_mm256_slli_epi64(here, 1),
+				_mm256_srli_epi64(west, 63));
+		east = _mm256_or_si256(_mm256_srli_epi64(here, 1),
+				_mm256_slli_epi64(east, 63));
+		_mm256_storeu_si256((__m256i*)(h0 + w),
+				_mm256_xor_si256(_mm256_xor_si256(west, here), east));
+		east = _mm256_and_si256(east, _mm256_xor_si256(west, here));
+		_mm256_storeu_si256((__m256i*)(h1 + w),
+				_mm256_or_si256(_mm256_and_si256(west, here), east));
+	}
+	sum_row_scalar(row + w, stride - w, h0 + w, h1 + w);
+}
+
+/*
+ * Same as block_majority_scalar, 4 words at once
+ */
+__attribute__((target("avx2")))
+static void
+block_majority_avx2(const uint64_t *const sums[6], const uint64_t *mask,
+		uint64_t *dst, int stride)
+{
+	__m256i a0, a1, b0, b1, c0, c1, s0, s1, k0, k1, t0, t1, m0, m1;
+	__m256i in, old, next;
+	const uint64_t *rest[6];
+	int w;
+
+	for (w = 0; w + 4 <= stride; w += 4)
+	{
+		a0 = _mm256_loadu_si256((const __m256i*)(sums[0] + w));
+		a1 = _mm256_loadu_si256((const __m256i*)(sums[1] + w));
+		b0 = _mm256_loadu_si256((const __m256i*)(sums[2] + w));
+		b1 = _mm256_loadu_si256((const __m256i*)(sums[3] + w));
+		c0 = _mm256_loadu_si256((const __m256i*)(sums[4] + w));
+		c1 = _mm256_loadu_si256((const __m256i*)(sums[5] + w));
+		s0 = _mm256_xor_si256(a0, b0);
+		k0 = _mm256_and_si256(a0, b0);
+		s1 = _mm256_xor_si256(_mm256_xor_si256(a1, b1), k0);
+		k1 = _mm256_or_si256(_mm256_and_si256(a1, b1),
+				_mm256_and_si256(k0, _mm256_xor_si256(a1, b1)));
+		t0 = _mm256_xor_si256(s0, c0);
+		m0 = _mm256_and_si256(s0, c0);
+		t1 = _mm256_xor_si256(_mm256_xor_si256(s1, c1), m0);
+		m1 = _mm256_or_si256(_mm256_and_si256(s1, c1),
+				_mm256_and_si256(m0, _mm256_xor_si256(s1, c1)));
+		next = _mm256_and_si256(_mm256_xor_si256(k1, m1),
+				_mm256_or_si256(t1, t0));
+		next = _mm256_or_si256(_mm256_and_si256(k1, m1), next);
+		in = _mm256_loadu_si256((const __m256i*)(mask + w));
+		old = _mm256_loadu_si256((const __m256i*)(dst + w));
+		_mm256_storeu_si256((__m256i*)(dst + w),
+				_mm256_or_si256(_mm256_andnot_si256(in, old),
+					_mm256_and_si256(in, next)));
+	}
+	for (int i = 0; i < 6; i++)
+		rest[i] = sums[i] + w;
+	block_majority_scalar(rest, mask + w, dst + w, stride - w);
+}
+#endif
+
+/*
+ * Caves layout: random noise with permill/1000 of walls smoothed by a
+ * cellular automaton into blobs. A generation makes a cell a wall if 5 or
+ * more neighbours are, or if it's already a wall with 4 of them: 5 or more
+ * walls in its 3x3 block. Each row is summed across once and three sums
+ * make the blocks of a row, 64 cells at a time or 256 with AVX2
+ */
+static void
+generate_caves(bitplane_t *plane, int permill_obstacles, rng_t *rng)
+{
+	void (*sum_row)(const uint64_t*, int, uint64_t*, uint64_t*) = sum_row_scalar;
+	void (*block_majority)(const uint64_t *const[6], const uint64_t*,
+			uint64_t*, int) = block_majority_scalar;
+	bitplane_t *other = init_bitplane(plane->height, plane->width), *aux;
+	bitplane_t *src = plane, *dst = other;
+	const int stride = plane->stride;
+	uint64_t *row, *mask, *sums[3][2];
+	const uint64_t *block[6];
+	int y, w, i, k;
+
+#ifdef OBSTACLES_AVX2
+	if (__builtin_cpu_supports("avx2"))
+	{
+		sum_row = sum_row_avx2;
+		block_majority = block_majority_avx2;
+	}
+#endif
+
+	for (y = 1; y < plane->height - 1; y++)
+		for (w = 0; w < stride; w++)
+			plane->words[(size_t)y * stride + w] =
+				random_word(rng, permill_obstacles) &
+				columns_mask(w, 1, plane->width - 1);
+
+	/* Borders count as walls, so caves don't touch them */
+	fill_ring(plane, 1);
+	fill_ring(other, 1);
+
+	/* A row with a 0 word on each side, the interior and sums of 3 rows */
+	row = calloc((size_t)stride + 2, sizeof(uint64_t));
+	mask = malloc(sizeof(uint64_t) * (size_t)stride * 7);
+	for (w = 0; w < stride; w++)
+		mask[w] = columns_mask(w, 1, plane->width - 1);
+	for (k = 0; k < 6; k++)
+		sums[k / 2][k % 2] = mask + (size_t)stride * (k + 1);
+
+	for (i = 0; i < CAVE_GENERATIONS; i++)
+	{
+		for (k = 0; k < 2; k++)
+		{
+			memcpy(row + 1, src->words + (size_t)k * stride,
+					sizeof(uint64_t) * stride);
+			sum_row(row + 1, stride, sums[k][0], sums[k][1]);
+		}
+		for (y = 1; y < plane->height - 1; y++)
+		{
+			memcpy(row + 1, src->words + (size_t)(y + 1) * stride,
+					sizeof(uint64_t) * stride);
+			sum_row(row + 1, stride, sums[(y + 1) % 3][0],
+					sums[(y + 1) % 3][1]);
+			for (k = 0; k < 6; k++)
+				block[k] = sums[(y - 1 + k / 2) % 3][k % 2];
+			block_majority(block, mask, dst->words + (size_t)y * stride,
+					stride);
+		}
+		aux = src;
+		src = dst;
+		dst = aux;
+	}
+	if (src != plane)
+		memcpy(plane->words, src->words,
+				sizeof(uint64_t) * (size_t)plane->height * stride);
+
+	fill_ring(plane, 0);
+	free(row);
+	free(mask);
+	delete_bitplane(other);
+}
+
+/*
+ * Return a random bit, drawing a word from rng once every 63 of them. bits
+ * starts at 1 and keeps a set bit above the ones left
+ */
+static int
+random_bit(rng_t *rng, uint64_t *bits)
+{
+	int bit;
+
+	if (*bits == 1)
+		*bits = next_rng(rng) >> 1 | (uint64_t)1 << 63;
+	bit = (int)(*bits & 1);
+	*bits >>= 1;
+	return (bit);
+}
+
+/*
+ * Maze layout: walls on a lattice with a spacing of about 1000/permill cells,
+ * opened along a random spanning tree of the rooms (plus some loops) so
+ * every room can be reached. No walls at all with a permill of 0. The tree
+ * is grown a row of rooms at a time (Eller's algorithm): rooms of a row
+ * join the set of the one to the east at random, and each set opens at
+ * least one room to the south to carry it to the next row. The last row
+ * joins all the sets left. Only the sets of a row are kept, and each row
+ * of cells is written whole instead of a cell at a time
+ */
+static void
+generate_maze(bitplane_t *plane, int permill_obstacles, rng_t *rng)
+{
+	const int stride = plane->stride;
+	int spacing, rooms_y, rooms_x, *set, *parent, *first, *members;
+	int r, x, a, b, k, from, to, top, bottom, last;
+	uint8_t *east, *south, *opened;
+	uint64_t *row, bits = 1;
+
+	if (permill_obstacles <= 0)
+		return;
+
+	spacing = 1000 / permill_obstacles;
+	if (spacing < 3)
+		spacing = 3;
+	rooms_y = (plane->height - 3) / spacing + 1;
+	rooms_x = (plane->width - 3) / spacing + 1;
+
+	set = malloc(sizeof(int) * 4 * (size_t)rooms_x);
+	parent = set + rooms_x;
+	first = parent + rooms_x;
+	members = first + rooms_x;
+	east = calloc(3 * (size_t)rooms_x, 1);
+	south = east + rooms_x;
+	opened = south + rooms_x;
+
+	for (r = 0; r < rooms_y; r++)
+	{
+		last = r == rooms_y - 1;
+
+		/*
+		 * Rooms opened from above stay in their set, named after its first
+		 * room in this row, which is its root. The rest start sets of their
+		 * own. Rooms still hold their root from the row above
+		 */
+		for (x = 0; x < rooms_x; x++)
+			first[x] = -1;
+		for (x = 0; x < rooms_x; x++)
+		{
+			parent[x] = -1;
+			if (!south[x])
+				set[x] = x;
+			else if (first[set[x]] < 0)
+				set[x] = first[set[x]] = x;
+			else
+			{
+				set[x] = parent[x] = first[set[x]];
+				parent[set[x]]--;
+			}
+		}
+
+		/* East walls, rooms already joined only open for a loop */
+		a = find_root(parent, 0);
+		for (x = 0; x + 1 < rooms_x; x++)
+		{
+			b = find_root(parent, x + 1);
+			if (a != b)
+				east[x] = last || random_bit(rng, &bits);
+			else
+				east[x] = rng_below(rng, MAZE_LOOP_PROBABILITY) == 0;
+			a = east[x] && a != b ? unite(parent, a, b) : b;
+		}
+
+		/* South walls, the last room of a set opens if none did before */
+		if (!last)
+		{
+			for (x = 0; x < rooms_x; x++)
+			{
+				members[x] = 0;
+				opened[x] = 0;
+			}
+			for (x = 0; x < rooms_x; x++)
+				members[set[x] = find_root(parent, x)]++;
+			for (x = 0; x < rooms_x; x++)
+			{
+				south[x] = random_bit(rng, &bits) ||
+					(--members[set[x]] == 0 && !opened[set[x]]);
+				opened[set[x]] |= south[x];
+			}
+		}
+
+		/* Rows of the room: columns of the lattice but the open ones */
+		top = r * spacing + 1;
+		bottom = last ? plane->height - 1 : (r + 1) * spacing;
+		row = plane->words + (size_t)top * stride;
+		memset(row, 0, sizeof(uint64_t) * stride);
+		for (x = 0, k = spacing; x + 1 < rooms_x; x++, k += spacing)
+			row[k / 64] |= (uint64_t)!east[x] << k % 64;
+		for (k = top + 1; k < bottom; k++)
+			memcpy(plane->words + (size_t)k * stride, row,
+					sizeof(uint64_t) * stride);
+		if (last)
+			break;
+
+		/* Row line below, the last room of each axis takes the remainder */
+		row = plane->words + (size_t)bottom * stride;
+		for (k = 0; k < stride; k++)
+			row[k] = columns_mask(k, 1, plane->width - 1);
+		for (x = 0; x < rooms_x; x++)
+		{
+			if (!south[x])
+				continue;
+			from = x * spacing + 1;
+			to = x == rooms_x - 1 ? plane->width - 1 : (x + 1) * spacing;
+			for (k = from / 64; k <= (to - 1) / 64; k++)
+				row[k] &= ~columns_mask(k, from, to);
+		}
+	}
+
+	free(set);
+	free(east);
+}
+
+/*
+ * Arena layout: random blocks in the top left quarter mirrored into the
+ * other three, so no corner of the map has an advantage
+ */
+static void
+generate_arena(bitplane_t *plane, int permill_obstacles, rng_t *rng)
+{
+	int quarter_h = (plane->height - 1) / 2, quarter_w = (plane->width - 1) / 2;
+	int max_side, side_y, side_x, y0, x0, y, x, last_y, last_x;
+	long target, placed = 0, attempts = 0;
+
+	target = (long)quarter_h * quarter_w * permill_obstacles / 1000;
+	max_side = (quarter_h < quarter_w ? quarter_h : quarter_w) / 6 + 1;
+	last_y = plane->height - 1;
+	last_x = plane->width - 1;
+
+	while (placed < target && attempts++ < 4 * target + 16)
+	{
+		side_y = (int)rng_below(rng, (uint32_t)max_side) + 1;
+		side_x = (int)rng_below(rng, (uint32_t)max_side) + 1;
+		y0 = (int)rng_below(rng, (uint32_t)quarter_h) + 1;
+		x0 = (int)rng_below(rng, (uint32_t)quarter_w) + 1;
+
+		for (y = y0; y < y0 + side_y && y <= quarter_h; y++)
+		{
+			for (x = x0; x < x0 + side_x && x <= quarter_w && placed < target; x++)
+			{
+				if (get_bit(plane, y, x))
+					continue;
+				set_bit(plane, y, x);
+				set_bit(plane, y, last_x - x);
+				set_bit(plane, last_y - y, x);
+				set_bit(plane, last_y - y, last_x - x);
+				placed++;
+			}
+		}
+	}
+}
+
+/*
+ * Runs of free cells of a plane, row after row, as union-find nodes. Run k
+ * covers the columns [start[k], end[k]) of its row, and the runs of row y
+ * are [row_first[y], row_first[y + 1]). Cells opened to join regions get
+ * no node of their own: they take the one of a run they joined
+ */
+typedef struct
+{
+	int n_runs;
+	int *start, *end;
+	int *row_first;  /* [height + 1] */
+	int *parent;     /* Roots hold minus the cells of their region */
+	int n_opened;
+	int *opened_y, *opened_x, *opened_run;
+} runs_t;
+
+/*
+ * Return the free cells of word w of a row of plane, inside the map
+ */
+static uint64_t
+free_word(const bitplane_t *plane, const uint64_t *row, int w)
+{
+	/* Only the last word of a row has columns past the map */
+	if (w < plane->stride - 1)
+		return (~row[w]);
+	return (~row[w] & columns_mask(w, 0, plane->width));
+}
+
+/*
+ * Write base plus the column of each set bit of word to positions and
+ * return how many there were. The first four are written whether they
+ * exist or not so the usual words take no branch: positions needs room
+ * for four
+ */
+static int
+flatten_word(uint64_t word, int base, int *positions)
+{
+	int n = __builtin_popcountll(word);
+
+	for (int k = 0; k < 4; k++)
+	{
+		positions[k] = base + __builtin_ctzll(word | (uint64_t)1 << 63);
+		word &= word - 1;
+	}
+	for (int k = 4; word; k++)
+	{
+		positions[k] = base + __builtin_ctzll(word);
+		word &= word - 1;
+	}
+	return (n);
+}
+
+/*
+ * Write the runs of free cells of a row of plane to start and end and
+ * return how many there are. Both need room for four more than that
+ */
+static int
+row_runs_scalar(const bitplane_t *plane, const uint64_t *row, int *start,
+		int *end)
+{
+	uint64_t vacant = free_word(plane, row, 0), next, carry = 0;
+	int n_starts = 0, n_ends = 0;
+
+	for (int w = 0; w < plane->stride; w++)
+	{
+		next = w + 1 < plane->stride ? free_word(plane, row, w + 1) : 0;
+		n_starts += flatten_word(vacant & ~(vacant << 1 | carry), w * 64,
+				start + n_starts);
+		n_ends += flatten_word(vacant & ~(vacant >> 1 | next << 63), w * 64 + 1,
+				end + n_ends);
+		carry = vacant >> 63;
+		vacant = next;
+	}
+	return (n_starts);
+}
+
+#ifdef OBSTACLES_AVX2
+/*
+ * Same as row_runs_scalar with the popcnt and tzcnt instructions, which
+ * the builtins only use when they're enabled
+ */
+__attribute__((target("popcnt,bmi")))
+static int
+row_runs_popcnt(const bitplane_t *plane, const uint64_t *row, int *start,
+		int *end)
+{
+	uint64_t vacant = free_word(plane, row, 0), next, carry = 0;
+	int n_starts = 0, n_ends = 0;
+
+	for (int w = 0; w < plane->stride; w++)
+	{
+		next = w + 1 < plane->stride ? free_word(plane, row, w + 1) : 0;
+		n_starts += flatten_word(vacant & ~(vacant << 1 | carry), w * 64,
+				start + n_starts);
+		n_ends += flatten_word(vacant & ~(vacant >> 1 | next << 63), w * 64 + 1,
+				end + n_ends);
+		carry = vacant >> 63;
+		vacant = next;
+	}
+	return (n_starts);
+}
+#endif
+
+/*
+ * Find the runs of free cells of plane, each one a region of its own.
+ * Runs must not cross the edges of the map. The arrays grow as rows are
+ * scanned, so the plane is read once
+ */
+static void
+find_runs(const bitplane_t *plane, runs_t *runs)
+{
+	int (*row_runs)(const bitplane_t*, const uint64_t*, int*, int*) =
+		row_runs_scalar;
+	int n_runs = 0, size = plane->height * 8;
+	int *start = malloc(sizeof(int) * (size_t)size);
+	int *end = malloc(sizeof(int) * (size_t)size);
+
+#ifdef OBSTACLES_AVX2
+	if (__builtin_cpu_supports("popcnt") && __builtin_cpu_supports("bmi"))
+		row_runs = row_runs_popcnt;
+#endif
+
+	runs->row_first = malloc(sizeof(int) * ((size_t)plane->height + 1));
+	for (int y = 0; y < plane->height; y++)
+	{
+		runs->row_first[y] = n_runs;
+		/* A row holds at most a run every two cells */
+		if (n_runs + plane->width / 2 + 5 > size)
+		{
+			size = 2 * size + plane->width;
+			start = realloc(start, sizeof(int) * (size_t)size);
+			end = realloc(end, sizeof(int) * (size_t)size);
+		}
+		n_runs += row_runs(plane, plane->words + (size_t)y * plane->stride,
+				start + n_runs, end + n_runs);
+	}
+	runs->row_first[plane->height] = n_runs;
+
+	runs->n_runs = n_runs;
+	runs->start = start;
+	runs->end = end;
+	runs->parent = malloc(sizeof(int) * (size_t)n_runs);
+	for (int i = 0; i < n_runs; i++)
+		runs->parent[i] = start[i] - end[i];
+	runs->n_opened = 0;
+	runs->opened_y = runs->opened_x = runs->opened_run = NULL;
+}
+
+/*
+ * Join every run with the runs it overlaps in the row above. Return the
+ * number of regions left. Nodes end up pointing straight to their root
+ */
+static int
+label_runs(runs_t *runs, int height)
+{
+	const int *start = runs->start, *end = runs->end, *row_first = runs->row_first;
+	int a, b, n_regions = 0;
+
+	for (int y = 2; y < height - 1; y++)
+	{
+		a = row_first[y - 1];
+		b = row_first[y];
+		while (a < row_first[y] && b < row_first[y + 1])
+		{
+			if (start[a] < end[b] && start[b] < end[a])
+				unite(runs->parent, a, b);
+			if (end[a] < end[b])
+				a++;
+			else
+				b++;
+		}
+	}
+
+	for (int i = 0; i < runs->n_runs; i++)
+	{
+		if (runs->parent[i] < 0)
+			n_regions++;
+		else
+			runs->parent[i] = find_root(runs->parent, runs->parent[i]);
+	}
+	return (n_regions);
+}
+
+/*
+ * Add the root of node to the n_roots of roots unless it's there already
+ */
+static void
+add_root(runs_t *runs, int *roots, int *n_roots, int node)
+{
+	int root = find_root(runs->parent, node), i;
+
+	for (i = 0; i < *n_roots && roots[i] != root; i++)
+		;
+	if (i == *n_roots)
+		roots[(*n_roots)++] = root;
+}
+
+/*
+ * Return whether the cell (y, x) of plane is free
+ */
+static int
+is_free(const bitplane_t *plane, int y, int x)
+{
+	return (!(plane->words[(size_t)y * plane->stride + x / 64] >> (x % 64) & 1));
+}
+
+/*
+ * Return the biggest region of runs, ties going to the lowest root
+ */
+static int
+biggest_region(runs_t *runs)
+{
+	int biggest = -1;
+
+	/* Roots are the runs with a size instead of a parent */
+	for (int i = 0; i < runs->n_runs; i++)
+		if (runs->parent[i] < 0 && (biggest == -1 ||
+					runs->parent[i] < runs->parent[biggest]))
+			biggest = i;
+	return (biggest);
+}
+
+/*
+ * Set in near ([stride] words) the cells of row y touching the runs of
+ * row run_y that aren't in the region biggest, as labelled
+ */
+static void
+mark_near(const runs_t *runs, uint64_t *near, int stride, int y, int run_y,
+		int biggest)
+{
+	int root, from, to;
+
+	for (int i = runs->row_first[run_y]; i < runs->row_first[run_y + 1]; i++)
+	{
+		root = runs->parent[i] < 0 ? i : runs->parent[i];
+		if (root == biggest)
+			continue;
+		from = runs->start[i];
+		to = runs->end[i];
+		if (run_y == y)  /* Only the cells at both ends */
+		{
+			near[(from - 1) / 64] |= (uint64_t)1 << ((from - 1) % 64);
+			near[to / 64] |= (uint64_t)1 << (to % 64);
+			continue;
+		}
+		for (int w = from / 64; w <= (to - 1) / 64 && w < stride; w++)
+			near[w] |= columns_mask(w, from, to);
+	}
+}
+
+/*
+ * Open the obstacles of plane touching two or more regions, joining them.
+ * Obstacles with at least two free neighbours are candidates, but only
+ * those next to a region other than the biggest one, or next to an opened
+ * cell, may touch two. Candidates come in order, so the runs around them
+ * are followed forwards. Every opening joins two of the n_regions or
+ * more, so there are fewer openings than regions
+ */
+static void
+bridge_regions(bitplane_t *plane, runs_t *runs, int n_regions)
+{
+	const int stride = plane->stride, *end = runs->end, *row_first = runs->row_first;
+	uint64_t *row, *above, *below, *near, left, right, up, down, candidates;
+	uint64_t pending;
+	int up_run, here_run, down_run, up_opened, row_opened = 0, last;
+	int biggest = biggest_region(runs), x, root, roots[4], n_roots;
+
+	near = malloc(sizeof(uint64_t) * (size_t)stride);
+	runs->opened_y = malloc(sizeof(int) * ((size_t)n_regions - 1));
+	runs->opened_x = malloc(sizeof(int) * ((size_t)n_regions - 1));
+	runs->opened_run = malloc(sizeof(int) * ((size_t)n_regions - 1));
+
+	for (int y = 1; y < plane->height - 1; y++)
+	{
+		row = plane->words + (size_t)y * stride;
+		above = row - stride;
+		below = row + stride;
+		up_run = row_first[y - 1];
+		here_run = row_first[y];
+		down_run = row_first[y + 1];
+		up_opened = row_opened;
+		row_opened = runs->n_opened;
+
+		memset(near, 0, sizeof(uint64_t) * (size_t)stride);
+		for (int run_y = y - 1; run_y <= y + 1; run_y++)
+			mark_near(runs, near, stride, y, run_y, biggest);
+		for (int i = up_opened; i < row_opened; i++)  /* Below the openings */
+			near[runs->opened_x[i] / 64] |= (uint64_t)1 << (runs->opened_x[i] % 64);
+
+		for (int w = 0; w < stride; w++)
+		{
+			left = ~(row[w] << 1 | (w > 0 ? row[w - 1] >> 63 : 1));
+			right = ~(row[w] >> 1 | (w + 1 < stride ? row[w + 1] << 63 : 0));
+			up = ~above[w];
+			down = ~below[w];
+			candidates = row[w] & ((left & right) | (up & down) |
+					((left | right) & (up | down))) &
+				columns_mask(w, 1, plane->width - 1);
+
+			for (pending = candidates & near[w]; pending; pending &= pending - 1)
+			{
+				x = w * 64 + lowest_bit(pending);
+				n_roots = 0;
+
+				/* Above, a run or a cell opened in the previous row */
+				if (is_free(plane, y - 1, x))
+				{
+					while (up_run < row_first[y] && end[up_run] <= x)
+						up_run++;
+					if (up_run < row_first[y] && runs->start[up_run] <= x)
+						add_root(runs, roots, &n_roots, up_run);
+					else
+					{
+						while (runs->opened_x[up_opened] < x)
+							up_opened++;
+						add_root(runs, roots, &n_roots,
+								runs->opened_run[up_opened]);
+					}
+				}
+
+				/* To the left, a run or the last cell opened */
+				last = runs->n_opened - 1;
+				if (last >= row_opened && runs->opened_x[last] == x - 1)
+					add_root(runs, roots, &n_roots, runs->opened_run[last]);
+				else if (is_free(plane, y, x - 1))
+				{
+					while (end[here_run] <= x - 1)
+						here_run++;
+					add_root(runs, roots, &n_roots, here_run);
+				}
+
+				/* To the right and below, nothing was opened yet */
+				if (is_free(plane, y, x + 1))
+				{
+					while (end[here_run] <= x + 1)
+						here_run++;
+					add_root(runs, roots, &n_roots, here_run);
+				}
+				if (is_free(plane, y + 1, x))
+				{
+					while (end[down_run] <= x)
+						down_run++;
+					add_root(runs, roots, &n_roots, down_run);
+				}
+
+				if (n_roots < 2)
+					continue;
+
+				reset_bit(plane, y, x);
+				for (int i = 1; i < n_roots; i++)
+					unite(runs->parent, roots[0], roots[i]);
+				root = find_root(runs->parent, roots[0]);
+				runs->parent[root]--;
+				runs->opened_y[runs->n_opened] = y;
+				runs->opened_x[runs->n_opened] = x;
+				runs->opened_run[runs->n_opened] = root;
+				runs->n_opened++;
+
+				/* The cell to the right is near now */
+				near[(x + 1) / 64] |= (uint64_t)1 << ((x + 1) % 64);
+				if (x % 64 < 63)
+					pending |= candidates & (uint64_t)1 << (x % 64 + 1);
+			}
+		}
+	}
+	free(near);
+}
+
+/*
+ * Turn every region but the biggest one into obstacle
+ */
+static void
+fill_regions(bitplane_t *plane, runs_t *runs)
+{
+	int biggest = biggest_region(runs);
+	uint64_t *row;
+
+	for (int y = 1; y < plane->height - 1; y++)
+	{
+		row = plane->words + (size_t)y * plane->stride;
+		for (int i = runs->row_first[y]; i < runs->row_first[y + 1]; i++)
+		{
+			if (runs->parent[i] == biggest || i == biggest ||
+					find_root(runs->parent, i) == biggest)
+				continue;
+			for (int w = runs->start[i] / 64; w <= (runs->end[i] - 1) / 64; w++)
+				row[w] |= columns_mask(w, runs->start[i], runs->end[i]);
+		}
+	}
+	for (int i = 0; i < runs->n_opened; i++)
+		if (find_root(runs->parent, runs->opened_run[i]) != biggest)
+			set_bit(plane, runs->opened_y[i], runs->opened_x[i]);
+}
+
+/*
+ * Make all the free interior cells of plane a single 4-connected region.
+ * The runs of free cells of each row are found a word at a time and
+ * labelled with union-find, joining them with the runs they touch above.
+ * Then obstacles touching two or more regions are removed to join them.
+ * Whatever still can't reach the biggest region becomes obstacle. Only
+ * runs get a node, so memory and time follow the number of runs rather
+ * than of cells, and layouts already connected stop after the labels
+ */
+static void
+connect_free_space(bitplane_t *plane)
+{
+	runs_t runs;
+	int n_regions;
+
+	/* With the ring as obstacles every run is bounded inside its row */
+	fill_ring(plane, 1);
+
+	find_runs(plane, &runs);
+	if ((n_regions = label_runs(&runs, plane->height)) > 1)
+	{
+		bridge_regions(plane, &runs, n_regions);
+		fill_regions(plane, &runs);
+	}
+
+	fill_ring(plane, 0);
+	free(runs.start);
+	free(runs.end);
+	free(runs.row_first);
+	free(runs.parent);
+	free(runs.opened_y);
+	free(runs.opened_x);
+	free(runs.opened_run);
+}
+
+void
+generate_obstacles(bitplane_t *plane, obstacle_layout_t layout,
+		int permill_obstacles, uint64_t seed)
+{
+	rng_t rng;
+
+	if (plane->height < 3 || plane->width < 3)
+		return;
+
+	seed_rng(&rng, seed);
+	switch (layout)
+	{
+		case LAYOUT_UNIFORM:
+			generate_uniform(plane, permill_obstacles, &rng);
+			break;
+		case LAYOUT_CAVES:
+			generate_caves(plane, permill_obstacles, &rng);
+			break;
+		case LAYOUT_MAZE:
+			/* Connected by construction */
+			generate_maze(plane, permill_obstacles, &rng);
+			return;
+		case LAYOUT_ARENA:
+			generate_arena(plane, permill_obstacles, &rng);
+	}
+	connect_free_space(plane);
+}
+
+int
+parse_obstacle_layout(const char *name)
+{
+	if (strcmp(name, "uniform") == 0)
+		return (LAYOUT_UNIFORM);
+	if (strcmp(name, "caves") == 0)
+		return (LAYOUT_CAVES);
+	if (strcmp(name, "maze") == 0)
+		return (LAYOUT_MAZE);
+	if (strcmp(name, "arena") == 0)
+		return (LAYOUT_ARENA);
+	return (-1);
+}
+
+/*
+ * Thread body of an obstacle_plan_t
+ */
+static void*
+plan_worker(void *arg)
+{
+	obstacle_plan_t *plan = arg;
+
+	generate_obstacles(plan->plane, plan->layout, plan->permill_obstacles,
+			plan->seed);
+	return (NULL);
+}
+
+obstacle_plan_t*
+start_obstacle_plan(int height, int width, obstacle_layout_t layout,
+		int permill_obstacles, uint64_t seed)
+{
+	obstacle_plan_t *plan = malloc(sizeof(obstacle_plan_t));
+
+	plan->plane = init_bitplane(height, width);
+	plan->layout = layout;
+	plan->permill_obstacles = permill_obstacles;
+	plan->seed = seed;
+	plan->running = pthread_create(&plan->thread, NULL, plan_worker, plan) == 0;
+
+	return (plan);
+}
+
+bitplane_t*
+finish_obstacle_plan(obstacle_plan_t *plan)
+{
+	bitplane_t *plane = plan->plane;
+
+	if (plan->running)
+		pthread_join(plan->thread, NULL);
+	else  /* No thread was available, compute it now */
+		plan_worker(plan);
+
+	free(plan);
+	return (plane);
+}
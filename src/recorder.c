@@ -0,0 +1,360 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <recorder.h>
+#include <stdlib.h>
+
+#ifndef _WIN32
+#include <spsc_ring.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Bytes of output read from the pipe at once */
+#define CHUNK_SIZE 4096
+
+/* Chunks the writer thread may fall behind the terminal */
+#define CHUNK_SLOTS 256
+
+/* Bytes of the stdio buffer of the file */
+#define RECORDING_BUFFER_SIZE (1 << 16)
+
+/*
+ * Output as the terminal got it
+ */
+typedef struct
+{
+	double time;  /* Seconds since the recording started */
+	size_t length;
+	unsigned char bytes[CHUNK_SIZE];
+} chunk_t;
+
+struct recorder_s
+{
+	FILE *file;
+	int terminal;  /* The real stdout */
+	int pipe_out;  /* End of the pipe that replaced stdout where output comes */
+	struct timespec start;
+
+	/*
+	 * The pump thread takes the output from the pipe, passes it to the
+	 * terminal and hands it to the writer thread through chunks, so the
+	 * file never holds up the terminal
+	 */
+	spsc_ring_t *chunks;
+	atomic_int pumping;  /* 0 once the pipe is over */
+	pthread_t pump, writer;
+	int failed;  /* Some write to the file went wrong */
+};
+
+/*
+ * Return the seconds since the recording started
+ */
+static double
+recording_time(const recorder_t *recorder)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((double)(now.tv_sec - recorder->start.tv_sec) +
+			(double)(now.tv_nsec - recorder->start.tv_nsec) / 1e9);
+}
+
+/*
+ * Pump thread: move the output from the pipe to the terminal and the ring
+ */
+static void*
+pump_output(void *arg)
+{
+	const struct timespec retry = {0, 1000000};
+	recorder_t *recorder = arg;
+	chunk_t *chunk;
+	ssize_t length, written;
+
+	for (;;)
+	{
+		while (!(chunk = peek_free_slot(recorder->chunks)))
+			nanosleep(&retry, NULL);
+
+		length = read(recorder->pipe_out, chunk->bytes, CHUNK_SIZE);
+		if (length == -1 && errno == EINTR)
+			continue;
+		if (length <= 0)
+			break;
+		chunk->time = recording_time(recorder);
+		chunk->length = (size_t)length;
+
+		for (ssize_t sent = 0; sent < length; sent += written)
+		{
+			written = write(recorder->terminal, chunk->bytes + sent,
+					(size_t)(length - sent));
+			if (written == -1 && errno != EINTR)
+				break;
+			if (written == -1)
+				written = 0;
+		}
+		push_slot(recorder->chunks);
+	}
+
+	atomic_store(&recorder->pumping, 0);
+	return (NULL);
+}
+
+/*
+ * Return how many of the first length bytes of text don't end in the
+ * middle of a UTF-8 sequence
+ */
+static size_t
+complete_utf8(const unsigned char *text, size_t length)
+{
+	size_t needed;
+
+	for (size_t i = length; i > 0 && length - i < 4; i--)
+	{
+		if ((text[i - 1] & 0xc0) == 0x80)
+			continue;  /* Continuation byte */
+		if ((text[i - 1] & 0xe0) == 0xc0)
+			needed = 2;
+		else if ((text[i - 1] & 0xf0) == 0xe0)
+			needed = 3;
+		else if ((text[i - 1] & 0xf8) == 0xf0)
+			needed = 4;
+		else
+			needed = 1;
+		return (i - 1 + needed > length ? i - 1 : length);
+	}
+
+	return (length);
+}
+
+/*
+ * Write text as the contents of a JSON string into escaped, which must
+ * have room for 6 bytes per byte of text. Return the length written
+ */
+static size_t
+escape_json(const unsigned char *text, size_t length, char *escaped)
+{
+	static const char hex[] = "0123456789abcdef";
+	char *end = escaped;
+
+	for (size_t i = 0; i < length; i++)
+	{
+		switch (text[i])
+		{
+			case '"':
+			case '\\':
+				*end++ = '\\';
+				*end++ = (char)text[i];
+				break;
+			case '\n':
+				*end++ = '\\';
+				*end++ = 'n';
+				break;
+			case '\r':
+				*end++ = '\\';
+				*end++ = 'r';
+				break;
+			case '\t':
+				*end++ = '\\';
+				*end++ = 't';
+				break;
+			default:
+				if (text[i] < 0x20 || text[i] == 0x7f)
+				{
+					memcpy(end, "\\u00", 4);
+					end[4] = hex[text[i] >> 4];
+					end[5] = hex[text[i] & 0xf];
+					end += 6;
+				}
+				else
+					*end++ = (char)text[i];
+		}
+	}
+
+	return ((size_t)(end - escaped));
+}
+
+/*
+ * Writer thread: write the chunks into the file as output events. A UTF-8
+ * sequence cut between chunks waits for the next one, as each event must
+ * be valid text
+ */
+static void*
+write_chunks(void *arg)
+{
+	const struct timespec idle = {0, 5000000};
+	recorder_t *recorder = arg;
+	unsigned char text[CHUNK_SIZE + 3];
+	char *escaped = malloc(6 * sizeof(text));
+	size_t length = 0, complete;
+	chunk_t *chunk;
+
+	for (;;)
+	{
+		if (!(chunk = peek_full_slot(recorder->chunks)))
+		{
+			if (!atomic_load(&recorder->pumping) &&
+					!peek_full_slot(recorder->chunks))
+				break;
+			nanosleep(&idle, NULL);
+			continue;
+		}
+
+		/* text keeps the leftovers of the previous chunk */
+		memcpy(text + length, chunk->bytes, chunk->length);
+		length += chunk->length;
+		complete = complete_utf8(text, length);
+		if (complete > 0)
+		{
+			fprintf(recorder->file, "[%.6f, \"o\", \"", chunk->time);
+			fwrite(escaped, 1, escape_json(text, complete, escaped),
+					recorder->file);
+			fputs("\"]\n", recorder->file);
+		}
+		memmove(text, text + complete, length - complete);
+		length -= complete;
+		pop_slot(recorder->chunks);
+	}
+
+	if (ferror(recorder->file))
+		recorder->failed = 1;
+	free(escaped);
+	return (NULL);
+}
+
+/*
+ * Free a recorder whose threads are over, closing the file. Return 0 if
+ * the file couldn't be closed
+ */
+static int
+discard_recorder(recorder_t *recorder)
+{
+	int closed = fclose(recorder->file) == 0;
+
+	close(recorder->terminal);
+	close(recorder->pipe_out);
+	delete_spsc_ring(recorder->chunks);
+	free(recorder);
+
+	return (closed);
+}
+
+recorder_t*
+start_recording(const char *path)
+{
+	struct winsize size = {.ws_row = 24, .ws_col = 80};
+	recorder_t *recorder;
+	const char *term = getenv("TERM");
+	int pipe_fds[2];
+	FILE *file;
+
+	if (!(file = fopen(path, "w")))
+		return (NULL);
+	if (pipe(pipe_fds) == -1)
+	{
+		fclose(file);
+		return (NULL);
+	}
+	setvbuf(file, NULL, _IOFBF, RECORDING_BUFFER_SIZE);
+
+	/* Header */
+	ioctl(STDOUT_FILENO, TIOCGWINSZ, &size);
+	fprintf(file, "{\"version\": 2, \"width\": %d, \"height\": %d, "
+			"\"timestamp\": %ld", size.ws_col, size.ws_row, (long)time(NULL));
+	if (term && !strpbrk(term, "\"\\"))
+		fprintf(file, ", \"env\": {\"TERM\": \"%s\"}", term);
+	fputs("}\n", file);
+
+	fflush(stdout);
+	recorder = malloc(sizeof(recorder_t));
+	recorder->file = file;
+	recorder->terminal = dup(STDOUT_FILENO);
+	recorder->pipe_out = pipe_fds[0];
+	recorder->failed = 0;
+	clock_gettime(CLOCK_MONOTONIC, &recorder->start);
+
+	recorder->chunks = init_spsc_ring(CHUNK_SLOTS, sizeof(chunk_t));
+	atomic_init(&recorder->pumping, 1);
+
+	/* Without both threads the game would block on a full pipe */
+	if (pthread_create(&recorder->pump, NULL, pump_output, recorder) != 0)
+	{
+		close(pipe_fds[1]);
+		discard_recorder(recorder);
+		return (NULL);
+	}
+	if (pthread_create(&recorder->writer, NULL, write_chunks, recorder) != 0)
+	{
+		/* Closing the only end to write ends the pump */
+		close(pipe_fds[1]);
+		pthread_join(recorder->pump, NULL);
+		discard_recorder(recorder);
+		return (NULL);
+	}
+
+	/*
+	 * stdout becomes the pipe. Curses still finds the terminal through
+	 * stdin and stderr for its size and modes
+	 */
+	dup2(pipe_fds[1], STDOUT_FILENO);
+	close(pipe_fds[1]);
+
+	return (recorder);
+}
+
+int
+finish_recording(recorder_t *recorder)
+{
+	int success;
+
+	/* Putting the terminal back closes the pipe, which ends the pump */
+	fflush(stdout);
+	dup2(recorder->terminal, STDOUT_FILENO);
+	pthread_join(recorder->pump, NULL);
+	pthread_join(recorder->writer, NULL);
+
+	success = !recorder->failed;
+	if (!discard_recorder(recorder))
+		success = 0;
+
+	return (success);
+}
+
+#else
+
+/* There's no stdout to take the output from with PDCurses */
+
+recorder_t*
+start_recording(const char *path)
+{
+	(void)path;
+	return (NULL);
+}
+
+int
+finish_recording(recorder_t *recorder)
+{
+	(void)recorder;
+	return (0);
+}
+
+#endif
@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <rng.h>
+
+void
+seed_rng(rng_t *rng, uint64_t seed)
+{
+	rng->state = seed;
+}
+
+uint64_t
+next_rng(rng_t *rng)
+{
+	uint64_t z = (rng->state += 0x9E3779B97F4A7C15u);
+
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9u;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBu;
+	return (z ^ (z >> 31));
+}
+
+uint32_t
+rng_below(rng_t *rng, uint32_t n)
+{
+	/* Multiply-shift instead of modulo: no division and no low bit bias */
+	return ((uint32_t)(((next_rng(rng) >> 32) * n) >> 32));
+}
@@ -16,6 +16,7 @@
  */
 
 #include <snake.h>
+#include <journal.h>
 #include <time.h>
 
 snake_t*
@@ -38,7 +39,7 @@ init_snake(field_t *field, cell_t head_type)
 
 	/* Head */
 	snake->head_type = head_type;
-	field->matrix[snake->head->y][snake->head->x] = head_type;
+	set_cell(field, snake->head->y, snake->head->x, head_type);
 
 	return (snake);
 }
@@ -51,10 +52,12 @@ static void
 append_head(field_t *field, snake_t *snake, coord_t y, coord_t x)
 {
 	/* In the field */
-	field->matrix[snake->head->y][snake->head->x] = SNAKE;
-	field->matrix[y][x] = snake->head_type;
+	set_cell(field, snake->head->y, snake->head->x, SNAKE);
+	set_cell(field, y, x, snake->head_type);
 
 	/* In the snake */
+	if (field->journal)
+		record_head(field->journal, snake, snake->neck);
 	snake->head->next = malloc(sizeof(body_t));
 	snake->head->next->y = y;
 	snake->head->next->x = x;
@@ -72,11 +75,14 @@ delete_tail(field_t *field, snake_t *snake)
 	body_t *aux;
 
 	/* In the field */
-	field->matrix[snake->tail->y][snake->tail->x] = EMPTY;
+	set_cell(field, snake->tail->y, snake->tail->x, EMPTY);
 
-	/* In the snake */
+	/* In the snake, the journal keeps the node to put it back */
 	aux = snake->tail->next;
-	free(snake->tail);
+	if (field->journal)
+		record_tail(field->journal, snake, snake->tail);
+	else
+		free(snake->tail);
 	snake->tail = aux;
 }
 
@@ -98,10 +104,13 @@ delete_half_snake(field_t *field, snake_t *snake)
 
 	for (int i = 0; i < snake_length/2; i++)
 	{
-		field->matrix[snake->tail->y][snake->tail->x] = EMPTY;
+		set_cell(field, snake->tail->y, snake->tail->x, EMPTY);
 
 		aux = snake->tail->next;
-		free(snake->tail);
+		if (field->journal)
+			record_tail(field->journal, snake, snake->tail);
+		else
+			free(snake->tail);
 		snake->tail = aux;
 	}
 }
@@ -160,6 +169,8 @@ advance(field_t *field, snake_t *snake)
 			/* fallthrough */
 		case DECELERATOR:
 		case EXTRA_POINTS:
+			take_temp_item(field, next_y, next_x);
+			/* fallthrough */
 		case EMPTY:
 			append_head(field, snake, next_y, next_x);
 			delete_tail(field, snake);
@@ -174,6 +185,8 @@ advance(field_t *field, snake_t *snake)
 			 */
 			if (next_y == snake->neck->y && next_x == snake->neck->x)
 			{
+				if (field->journal)
+					record_direction(field->journal, snake, snake->direction);
 				reverse_direction(snake);
 				old_type = advance(field, snake);
 			}
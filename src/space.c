@@ -0,0 +1,317 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <space.h>
+#include <flat_map.h>
+#include <snake.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SPACE_SSSE3
+#include <tmmintrin.h>
+#endif
+
+/* A cell type must fit in a pshufb index */
+_Static_assert(CELL_TYPES <= 16, "cell types don't fit in the passable table");
+
+struct space_s
+{
+	int height, width;
+	bitplane_t *passable;  /* Cells a snake can go through */
+	bitplane_t *reached;   /* Cells the last flood reached */
+	int top, bottom;       /* First and last rows with reached cells */
+
+	/*
+	 * [2 * height] Whether each row changed since the one below took
+	 * cells from it, then since the one above did
+	 */
+	unsigned char *fresh;
+};
+
+/*
+ * Set the bits of the passable cells of a row, from column onwards until
+ * n. cells can be read up to readable
+ */
+static void
+pack_row_scalar(const cell_byte_t *cells, int column, int n, int readable,
+		uint64_t *row)
+{
+	(void)readable;
+	for (; column < n; column++)
+		if (flat_passable[cells[column]])
+			row[column / 64] |= (uint64_t)1 << column % 64;
+}
+
+#ifdef SPACE_SSSE3
+/*
+ * Same as pack_row_scalar, 16 cells at once: pshufb turns passable cells
+ * into bytes with the top bit set and pmovmskb packs them. 16 columns
+ * never straddle two words. The last cells also go 16 at a time if there
+ * are readable cells after them, dropping the bits past n
+ */
+__attribute__((target("ssse3")))
+static void
+pack_row_ssse3(const cell_byte_t *cells, int column, int n, int readable,
+		uint64_t *row)
+{
+	static const unsigned char table[16] = {
+		[EMPTY] = 0x80,
+		[FOOD] = 0x80,
+		[SHORTENER] = 0x80,
+		[DECELERATOR] = 0x80,
+		[EXTRA_POINTS] = 0x80,
+	};
+	const __m128i lookup = _mm_loadu_si128((const __m128i*)table);
+	uint64_t bits;
+
+	for (; column < n; column += 16)
+	{
+		if (column + 16 > readable)
+		{
+			pack_row_scalar(cells, column, n, readable, row);
+			return;
+		}
+		bits = (uint64_t)_mm_movemask_epi8(_mm_shuffle_epi8(lookup,
+					_mm_loadu_si128((const __m128i*)(cells + column))));
+		if (n - column < 16)
+			bits &= ((uint64_t)1 << (n - column)) - 1;
+		row[column / 64] |= bits << column % 64;
+	}
+}
+#endif
+
+/*
+ * Fill the run of set bits of p that holds each bit of g towards bit 0,
+ * the Kogge-Stone way: 6 steps that double the distance each time
+ */
+static uint64_t
+fill_down(uint64_t g, uint64_t p)
+{
+	g |= p & (g >> 1);
+	p &= p >> 1;
+	g |= p & (g >> 2);
+	p &= p >> 2;
+	g |= p & (g >> 4);
+	p &= p >> 4;
+	g |= p & (g >> 8);
+	p &= p >> 8;
+	g |= p & (g >> 16);
+	p &= p >> 16;
+	return (g | (p & (g >> 32)));
+}
+
+/*
+ * Add to the reached cells of row those of the row next to it (NULL if
+ * none) that it can take, then fill whole runs of passable cells from
+ * them. Upwards in the bits an addition does it: the carry from a reached
+ * bit runs through the rest of its run. Return whether the row changed
+ */
+static int
+fill_row(uint64_t *row, const uint64_t *next_to, const uint64_t *passable,
+		int stride)
+{
+	uint64_t seed, filled, carry = 0, fresh = 0;
+	int changed = 0;
+
+	if (next_to)
+	{
+		for (int i = 0; i < stride; i++)
+			fresh |= next_to[i] & passable[i] & ~row[i];
+		if (!fresh)
+			return (0);
+	}
+
+	for (int i = 0; i < stride; i++)
+	{
+		seed = (row[i] | (next_to ? next_to[i] : 0) | carry) & passable[i];
+		filled = (((passable[i] + seed) ^ passable[i]) & passable[i]) | seed;
+		carry = filled >> 63;
+		changed |= filled != row[i];
+		row[i] = filled;
+	}
+	carry = 0;
+	for (int i = stride - 1; i >= 0; i--)
+	{
+		filled = fill_down(row[i] | (carry << 63 & passable[i]), passable[i]);
+		carry = filled & 1;
+		changed |= filled != row[i];
+		row[i] = filled;
+	}
+	return (changed);
+}
+
+/*
+ * Return how many bits of the n words are set
+ */
+static int
+count_words_scalar(const uint64_t *words, size_t n)
+{
+	int count = 0;
+
+	for (size_t i = 0; i < n; i++)
+		count += count_bits(words[i]);
+	return (count);
+}
+
+#ifdef SPACE_SSSE3
+/*
+ * Same as count_words_scalar with the popcnt instruction, which the
+ * builtin only uses when it's enabled
+ */
+__attribute__((target("popcnt")))
+static int
+count_words_popcnt(const uint64_t *words, size_t n)
+{
+	int count = 0;
+
+	for (size_t i = 0; i < n; i++)
+		count += __builtin_popcountll(words[i]);
+	return (count);
+}
+#endif
+
+/*
+ * Return how many bits of the n words are set
+ */
+static int
+count_words(const uint64_t *words, size_t n)
+{
+#ifdef SPACE_SSSE3
+	if (__builtin_cpu_supports("popcnt"))
+		return (count_words_popcnt(words, n));
+#endif
+	return (count_words_scalar(words, n));
+}
+
+/*
+ * Flood the passable cells from (y, x), which must be passable, going
+ * down and up the rows until a round changes nothing. A row is only done
+ * again when the one it takes cells from changed since. Return how many
+ * cells it reached
+ */
+static int
+flood(space_t *space, int y, int x)
+{
+	const int stride = space->passable->stride, height = space->height;
+	const uint64_t *passable = space->passable->words;
+	uint64_t *reached = space->reached->words;
+	unsigned char *down = space->fresh, *up = space->fresh + height;
+	int changed;
+
+	memset(reached, 0, sizeof(uint64_t) * stride * height);
+	memset(space->fresh, 0, (size_t)height * 2);
+	set_bit(space->reached, y, x);
+	fill_row(reached + (size_t)y * stride, NULL, passable + (size_t)y * stride,
+			stride);
+	down[y] = up[y] = 1;
+	space->top = space->bottom = y;
+	do
+	{
+		changed = 0;
+		for (int r = space->top + 1; r < height; r++)
+		{
+			if (!down[r - 1])
+				continue;
+			down[r - 1] = 0;
+			if (fill_row(reached + (size_t)r * stride,
+						reached + (size_t)(r - 1) * stride,
+						passable + (size_t)r * stride, stride))
+			{
+				changed = down[r] = up[r] = 1;
+				if (r > space->bottom)
+					space->bottom = r;
+			}
+		}
+		for (int r = space->bottom - 1; r >= 0; r--)
+		{
+			if (!up[r + 1])
+				continue;
+			up[r + 1] = 0;
+			if (fill_row(reached + (size_t)r * stride,
+						reached + (size_t)(r + 1) * stride,
+						passable + (size_t)r * stride, stride))
+			{
+				changed = down[r] = up[r] = 1;
+				if (r < space->top)
+					space->top = r;
+			}
+		}
+	}
+	while (changed);
+
+	return (count_words(reached + (size_t)space->top * stride,
+				(size_t)(space->bottom - space->top + 1) * stride));
+}
+
+space_t*
+init_space(int height, int width)
+{
+	space_t *space = malloc(sizeof(space_t));
+
+	space->height = height;
+	space->width = width;
+	space->passable = init_bitplane(height, width);
+	space->reached = init_bitplane(height, width);
+	space->top = space->bottom = 0;
+	space->fresh = malloc((size_t)height * 2);
+	return (space);
+}
+
+void
+measure_space(space_t *space, const cell_byte_t *map, int head, int room[4])
+{
+	const int w = space->width, offsets[4] = {-w, 1, -1, w};
+	const int stride = space->passable->stride, cells = space->height * w;
+	int next, other;
+	void (*pack)(const cell_byte_t*, int, int, int, uint64_t*) =
+		pack_row_scalar;
+
+#ifdef SPACE_SSSE3
+	if (__builtin_cpu_supports("ssse3"))
+		pack = pack_row_ssse3;
+#endif
+
+	clear_bitplane(space->passable);
+	for (int y = 0; y < space->height; y++)
+		pack(map + (size_t)y * w, 0, w, cells - y * w,
+				space->passable->words + (size_t)y * stride);
+
+	for (int d = NORTH; d <= SOUTH; d++)
+		room[d] = 0;
+	for (int d = NORTH; d <= SOUTH; d++)
+	{
+		next = head + offsets[d];
+		if (room[d] || !flat_passable[map[next]])
+			continue;
+		room[d] = flood(space, next / w, next % w);
+		for (int k = d + 1; k <= SOUTH; k++)
+		{
+			other = head + offsets[k];
+			if (get_bit(space->reached, other / w, other % w))
+				room[k] = room[d];
+		}
+	}
+}
+
+void
+delete_space(space_t *space)
+{
+	delete_bitplane(space->passable);
+	delete_bitplane(space->reached);
+	free(space->fresh);
+	free(space);
+}
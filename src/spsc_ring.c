@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <spsc_ring.h>
+#include <aligned.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+struct spsc_ring_s
+{
+	size_t capacity, slot_size;
+	unsigned char *slots;  /* [capacity * slot_size] */
+
+	/*
+	 * Count of pushed and popped slots, each one only written by its side.
+	 * Kept on separate cache lines so both sides don't fight over them
+	 */
+	_Alignas(64) atomic_size_t pushed;
+	_Alignas(64) atomic_size_t popped;
+};
+
+spsc_ring_t*
+init_spsc_ring(size_t capacity, size_t slot_size)
+{
+	spsc_ring_t *ring = aligned_malloc(64, sizeof(spsc_ring_t));
+
+	ring->capacity = capacity;
+	/* Every slot starts aligned for whatever is stored in it */
+	ring->slot_size = (slot_size + _Alignof(max_align_t) - 1) /
+		_Alignof(max_align_t) * _Alignof(max_align_t);
+	ring->slots = malloc(capacity * ring->slot_size);
+	atomic_init(&ring->pushed, 0);
+	atomic_init(&ring->popped, 0);
+
+	return (ring);
+}
+
+void*
+peek_free_slot(spsc_ring_t *ring)
+{
+	size_t pushed = atomic_load_explicit(&ring->pushed, memory_order_relaxed);
+
+	if (pushed - atomic_load_explicit(&ring->popped, memory_order_acquire) ==
+			ring->capacity)
+		return (NULL);
+	return (ring->slots + pushed % ring->capacity * ring->slot_size);
+}
+
+void
+push_slot(spsc_ring_t *ring)
+{
+	atomic_fetch_add_explicit(&ring->pushed, 1, memory_order_release);
+}
+
+void*
+peek_full_slot(spsc_ring_t *ring)
+{
+	size_t popped = atomic_load_explicit(&ring->popped, memory_order_relaxed);
+
+	if (atomic_load_explicit(&ring->pushed, memory_order_acquire) == popped)
+		return (NULL);
+	return (ring->slots + popped % ring->capacity * ring->slot_size);
+}
+
+void*
+skip_to_last_slot(spsc_ring_t *ring)
+{
+	size_t pushed = atomic_load_explicit(&ring->pushed, memory_order_acquire);
+
+	if (pushed == atomic_load_explicit(&ring->popped, memory_order_relaxed))
+		return (NULL);
+	atomic_store_explicit(&ring->popped, pushed - 1, memory_order_release);
+	return (ring->slots + (pushed - 1) % ring->capacity * ring->slot_size);
+}
+
+void
+pop_slot(spsc_ring_t *ring)
+{
+	atomic_fetch_add_explicit(&ring->popped, 1, memory_order_release);
+}
+
+void
+delete_spsc_ring(spsc_ring_t *ring)
+{
+	free(ring->slots);
+	aligned_free(ring);
+}
@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <thread_pool.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+struct thread_pool_s
+{
+	pthread_t *threads;
+	int n_workers;
+
+	pthread_mutex_t lock;
+	pthread_cond_t job_ready, job_done;
+	unsigned long generation;  /* Jobs started so far, workers wait for the next */
+	int pending;               /* Threads that haven't finished the current job */
+	int quit;
+	pool_job_t job;
+	void *arg;
+};
+
+/*
+ * Numbers a thread of the pool
+ */
+typedef struct
+{
+	thread_pool_t *pool;
+	int worker;
+} worker_arg_t;
+
+/*
+ * Loop of a thread: run every job started after the last one it ran
+ */
+static void*
+work(void *arg)
+{
+	worker_arg_t *worker = arg;
+	thread_pool_t *pool = worker->pool;
+	unsigned long seen = 0;
+
+	pthread_mutex_lock(&pool->lock);
+	for (;;)
+	{
+		while (pool->generation == seen && !pool->quit)
+			pthread_cond_wait(&pool->job_ready, &pool->lock);
+		if (pool->quit)
+			break;
+		seen = pool->generation;
+
+		pthread_mutex_unlock(&pool->lock);
+		pool->job(pool->arg, worker->worker, pool->n_workers);
+		pthread_mutex_lock(&pool->lock);
+
+		if (--pool->pending == 0)
+			pthread_cond_signal(&pool->job_done);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	free(worker);
+	return (NULL);
+}
+
+thread_pool_t*
+init_thread_pool(int n_workers)
+{
+	thread_pool_t *pool = malloc(sizeof(thread_pool_t));
+	worker_arg_t *worker;
+	int created = 0;
+
+	if (n_workers < 1)
+		n_workers = 1;
+	pool->threads = malloc(sizeof(pthread_t) * n_workers);
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->job_ready, NULL);
+	pthread_cond_init(&pool->job_done, NULL);
+	pool->generation = 0;
+	pool->pending = 0;
+	pool->quit = 0;
+
+	/* Threads are numbered from 1, the caller is worker 0 */
+	for (int i = 1; i < n_workers; i++)
+	{
+		worker = malloc(sizeof(worker_arg_t));
+		worker->pool = pool;
+		worker->worker = i;
+		if (pthread_create(&pool->threads[created], NULL, work, worker) != 0)
+		{
+			free(worker);
+			break;
+		}
+		created++;
+	}
+	pool->n_workers = created + 1;
+
+	return (pool);
+}
+
+int
+pool_workers(const thread_pool_t *pool)
+{
+	return (pool->n_workers);
+}
+
+void
+run_thread_pool(thread_pool_t *pool, pool_job_t job, void *arg)
+{
+	if (pool->n_workers > 1)
+	{
+		pthread_mutex_lock(&pool->lock);
+		pool->job = job;
+		pool->arg = arg;
+		pool->pending = pool->n_workers - 1;
+		pool->generation++;
+		pthread_cond_broadcast(&pool->job_ready);
+		pthread_mutex_unlock(&pool->lock);
+	}
+
+	job(arg, 0, pool->n_workers);
+
+	if (pool->n_workers > 1)
+	{
+		pthread_mutex_lock(&pool->lock);
+		while (pool->pending > 0)
+			pthread_cond_wait(&pool->job_done, &pool->lock);
+		pthread_mutex_unlock(&pool->lock);
+	}
+}
+
+void
+delete_thread_pool(thread_pool_t *pool)
+{
+	pthread_mutex_lock(&pool->lock);
+	pool->quit = 1;
+	pthread_cond_broadcast(&pool->job_ready);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (int i = 0; i < pool->n_workers - 1; i++)
+		pthread_join(pool->threads[i], NULL);
+
+	pthread_mutex_destroy(&pool->lock);
+	pthread_cond_destroy(&pool->job_ready);
+	pthread_cond_destroy(&pool->job_done);
+	free(pool->threads);
+	free(pool);
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <union_find.h>
+
+int
+find_root(int *parent, int i)
+{
+	while (parent[i] >= 0)
+	{
+		if (parent[parent[i]] >= 0)
+			parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return (i);
+}
+
+int
+unite(int *parent, int a, int b)
+{
+	int aux;
+
+	a = find_root(parent, a);
+	b = find_root(parent, b);
+	if (a == b)
+		return (a);
+	if (parent[a] > parent[b])  /* The bigger set keeps the root */
+	{
+		aux = a;
+		a = b;
+		b = aux;
+	}
+	parent[a] += parent[b];
+	parent[b] = a;
+	return (a);
+}
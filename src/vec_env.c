@@ -0,0 +1,329 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <vec_env.h>
+#include <aligned.h>
+#include <config.h>
+#include <limits.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VEC_ENV_AVX2
+#include <immintrin.h>
+#endif
+
+/* Games stepped at once by step_lockstep, one per 32 bit lane of AVX2 */
+#define LOCKSTEP_LANES 8
+
+/* Groups of LOCKSTEP_LANES games ahead whose states are prefetched */
+#define LOCKSTEP_AHEAD 2
+
+/*
+ * Fill layout with the borders and a new set of obstacles, as init_field
+ */
+static void
+generate_layout(vec_env_t *env, cell_byte_t *layout, bitplane_t *plane,
+		uint64_t seed)
+{
+	uint64_t word;
+
+	memset(layout, EMPTY, (size_t)env->cells);
+	memset(layout, BORDER, (size_t)env->width);
+	memset(layout + (size_t)(env->height - 1) * env->width, BORDER,
+			(size_t)env->width);
+	for (int y = 1; y < env->height - 1; y++)
+	{
+		layout[y * env->width] = BORDER;
+		layout[y * env->width + env->width - 1] = BORDER;
+	}
+
+	clear_bitplane(plane);
+	generate_obstacles(plane, env->args->obstacle_layout,
+			env->args->permill_obstacles, seed);
+	for (int y = 1; y < env->height - 1; y++)
+		for (int w = 0; w < plane->stride; w++)
+			for (word = plane->words[(size_t)y * plane->stride + w]; word;
+					word &= word - 1)
+				layout[y * env->width + w * 64 + lowest_bit(word)] = OBSTACLE;
+}
+
+/*
+ * Run a tick of game with its action, starting it over if it ends
+ */
+static void
+step_one(vec_env_t *env, int game)
+{
+	game_state_t *state = vec_env_game(env, game);
+	unsigned int old_score = state->scores[0];
+
+	step_game_state(state, &env->actions[game]);
+	env->dones[game] = !state->running;
+	if (state->running)
+		env->rewards[game] = (float)(state->scores[0] - old_score);
+	else
+	{
+		env->rewards[game] = REWARD_DEATH;
+		restart_game_state(state);
+	}
+}
+
+#ifdef VEC_ENV_AVX2
+/*
+ * Run a tick of LOCKSTEP_LANES games from first at once. Turning, the
+ * next cell of each head, its type and the ring test of flat_may_split are
+ * computed with gathers and compares across the states, which are one
+ * after another. Games moving into an empty cell without items to expire
+ * then only need their writes, the rest (eating, dying, turning around,
+ * items) go through step_game_state
+ */
+__attribute__((target("avx2")))
+static void
+step_lockstep(vec_env_t *env, int first)
+{
+	const __m256i zero = _mm256_setzero_si256(), bytes = _mm256_set1_epi32(0xFF);
+	const __m256i one = _mm256_set1_epi32(1);
+	const int w = env->width;
+	const int ring[8] = {-w, -w + 1, 1, w + 1, w, w - 1, -1, -w - 1};
+	const int *base = (const int*)env->states;
+	__m256i state, action, direction, next, cell, type, fast, open, split;
+	__m256i around, pass, before, after, starts, unknown;
+	int lane_direction[LOCKSTEP_LANES], lane_split[LOCKSTEP_LANES], lanes;
+	const game_state_t *ahead;
+
+	/*
+	 * The states are far apart for the prefetchers: ask for the first line
+	 * of the ones coming later, where the fields gathered below are, and
+	 * for the head of the next ones, whose first line is already here
+	 */
+	if (first + (LOCKSTEP_AHEAD + 1) * LOCKSTEP_LANES <= env->n_envs)
+		for (int i = 0; i < LOCKSTEP_LANES; i++)
+			__builtin_prefetch(vec_env_game(env,
+						first + LOCKSTEP_AHEAD * LOCKSTEP_LANES + i));
+	if (first + 2 * LOCKSTEP_LANES <= env->n_envs)
+		for (int i = 0; i < LOCKSTEP_LANES; i++)
+		{
+			ahead = vec_env_game(env, first + LOCKSTEP_LANES + i);
+			__builtin_prefetch(ahead->map + ahead->snakes[0].head);
+		}
+
+	/* Offset of the state of each game */
+	state = _mm256_mullo_epi32(_mm256_set1_epi32((int)env->state_size),
+			_mm256_add_epi32(_mm256_set1_epi32(first),
+				_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+
+	/* Actions that are directions replace the current one */
+	action = _mm256_loadu_si256((const __m256i*)(env->actions + first));
+	direction = _mm256_and_si256(_mm256_i32gather_epi32(base,
+				_mm256_add_epi32(state, _mm256_set1_epi32((int)
+						offsetof(game_state_t, snakes[0].direction))), 1), bytes);
+	direction = _mm256_blendv_epi8(direction, action, _mm256_and_si256(
+				_mm256_cmpgt_epi32(action, _mm256_set1_epi32(-1)),
+				_mm256_cmpgt_epi32(_mm256_set1_epi32(4), action)));
+
+	/* Next cell, as an offset from the first state */
+	next = _mm256_add_epi32(_mm256_i32gather_epi32(base,
+				_mm256_add_epi32(state, _mm256_set1_epi32((int)
+						offsetof(game_state_t, snakes[0].head))), 1),
+			_mm256_permutevar8x32_epi32(_mm256_setr_epi32(-w, 1, -1, w, 0, 0, 0, 0),
+				direction));
+	cell = _mm256_add_epi32(_mm256_add_epi32(state, next),
+			_mm256_set1_epi32((int)offsetof(game_state_t, map)));
+	type = _mm256_and_si256(_mm256_i32gather_epi32(base, cell, 1), bytes);
+
+	fast = _mm256_and_si256(_mm256_cmpeq_epi32(type, zero), _mm256_cmpeq_epi32(
+				_mm256_i32gather_epi32(base, _mm256_add_epi32(state,
+						_mm256_set1_epi32((int)offsetof(game_state_t, n_items))), 1),
+				zero));
+	lanes = _mm256_movemask_ps(_mm256_castsi256_ps(fast));
+
+	/* Ring test, for the games whose map is still known to be connected */
+	split = _mm256_i32gather_epi32(base, _mm256_add_epi32(state,
+				_mm256_set1_epi32((int)offsetof(game_state_t, split))), 1);
+	unknown = _mm256_and_si256(fast, _mm256_cmpeq_epi32(split, zero));
+	if (_mm256_movemask_ps(_mm256_castsi256_ps(unknown)))
+	{
+		/*
+		 * Only the lanes moving into an empty cell gather its ring: the
+		 * others may be on a border, with their ring outside the map
+		 */
+		open = zero;
+		for (int k = 0; k < 8; k++)
+		{
+			around = _mm256_and_si256(_mm256_mask_i32gather_epi32(zero, base,
+						_mm256_add_epi32(cell, _mm256_set1_epi32(ring[k])), unknown, 1),
+					bytes);
+			pass = _mm256_or_si256(_mm256_or_si256(
+						_mm256_cmpeq_epi32(around, zero),
+						_mm256_cmpeq_epi32(around, _mm256_set1_epi32(FOOD))),
+					_mm256_and_si256(
+						_mm256_cmpgt_epi32(around, _mm256_set1_epi32(OBSTACLE)),
+						_mm256_cmpgt_epi32(_mm256_set1_epi32(CELL_TYPES), around)));
+			open = _mm256_or_si256(open,
+					_mm256_and_si256(pass, _mm256_set1_epi32(1 << k)));
+		}
+		before = _mm256_and_si256(_mm256_or_si256(_mm256_slli_epi32(open, 1),
+					_mm256_srli_epi32(open, 7)), bytes);
+		after = _mm256_and_si256(_mm256_or_si256(_mm256_srli_epi32(open, 1),
+					_mm256_slli_epi32(open, 7)), bytes);
+		starts = _mm256_and_si256(_mm256_andnot_si256(before, open),
+				_mm256_or_si256(_mm256_set1_epi32(0x55), after));
+		split = _mm256_or_si256(split, _mm256_andnot_si256(_mm256_cmpeq_epi32(
+						_mm256_and_si256(starts, _mm256_sub_epi32(starts, one)), zero),
+					one));
+	}
+
+	_mm256_storeu_si256((__m256i*)lane_direction, direction);
+	_mm256_storeu_si256((__m256i*)lane_split, split);
+	for (int i = 0; i < LOCKSTEP_LANES; i++)
+	{
+		if (!(lanes >> i & 1))
+		{
+			step_one(env, first + i);
+			continue;
+		}
+
+		slide_game_state(vec_env_game(env, first + i), lane_direction[i],
+				lane_split[i]);
+		env->rewards[first + i] = 0;
+		env->dones[first + i] = 0;
+	}
+}
+#endif
+
+/*
+ * Job of a worker: step its slice of the games
+ */
+static void
+step_slice(void *arg, int worker, int n_workers)
+{
+	vec_env_t *env = arg;
+	int first = (int)((long)env->n_envs * worker / n_workers);
+	int last = (int)((long)env->n_envs * (worker + 1) / n_workers);
+	int game = first;
+
+#ifdef VEC_ENV_AVX2
+	if (env->lockstep)
+		for (; game + LOCKSTEP_LANES <= last; game += LOCKSTEP_LANES)
+			step_lockstep(env, game);
+#endif
+	for (; game < last; game++)
+		step_one(env, game);
+}
+
+/*
+ * Job of a worker: reset its slice of the games
+ */
+static void
+reset_slice(void *arg, int worker, int n_workers)
+{
+	vec_env_t *env = arg;
+	int first = (int)((long)env->n_envs * worker / n_workers);
+	int last = (int)((long)env->n_envs * (worker + 1) / n_workers);
+
+	for (int game = first; game < last; game++)
+		restart_game_state(vec_env_game(env, game));
+}
+
+vec_env_t*
+init_vec_env(const arguments_t *args, int n_envs, int n_workers,
+		uint64_t seed)
+{
+	vec_env_t *env;
+	bitplane_t *plane;
+	rng_t seeder;
+	int n;
+
+	if (args->two_players)
+		return (NULL);
+
+	env = malloc(sizeof(vec_env_t));
+	env->args = args;
+	env->n_envs = n_envs;
+	env->height = args->height;
+	env->width = args->width;
+	env->cells = args->height * args->width;
+	env->pool = init_thread_pool(n_workers);
+	/* Each state starts a cache line, so a plain tick touches a single one */
+	env->state_size = (game_state_size(env->height, env->width, 1) + 63) /
+		64 * 64;
+	env->lockstep = 0;
+#ifdef VEC_ENV_AVX2
+	/* The gathers index all the states with 32 bit offsets */
+	env->lockstep = __builtin_cpu_supports("avx2") &&
+		(double)n_envs * env->state_size < INT_MAX;
+#endif
+
+	seed_rng(&seeder, seed);
+	env->layouts = malloc(sizeof(cell_byte_t) * VEC_ENV_LAYOUTS * env->cells);
+	plane = init_bitplane(env->height, env->width);
+	for (int i = 0; i < VEC_ENV_LAYOUTS; i++)
+		generate_layout(env, env->layouts + (size_t)i * env->cells, plane,
+				next_rng(&seeder));
+	delete_bitplane(plane);
+
+	/*
+	 * Each game gets its own sequence and the flood queue of the worker
+	 * stepping its slice, so slices don't share anything
+	 */
+	env->states = aligned_malloc(64, env->state_size * n_envs);
+	n = pool_workers(env->pool);
+	env->queue = malloc(sizeof(int*) * n);
+	for (int worker = 0; worker < n; worker++)
+	{
+		env->queue[worker] = malloc(sizeof(int) * env->cells);
+		for (int i = (int)((long)n_envs * worker / n);
+				i < (int)((long)n_envs * (worker + 1) / n); i++)
+			new_game_state(vec_env_game(env, i), args, 1, env->layouts,
+					VEC_ENV_LAYOUTS, env->queue[worker], next_rng(&seeder));
+	}
+
+	return (env);
+}
+
+game_state_t*
+vec_env_game(const vec_env_t *env, int game)
+{
+	return ((game_state_t*)(env->states + env->state_size * game));
+}
+
+void
+reset_vec_env(vec_env_t *env)
+{
+	run_thread_pool(env->pool, reset_slice, env);
+}
+
+void
+step_vec_env(vec_env_t *env, const int *actions, float *rewards,
+		unsigned char *dones)
+{
+	env->actions = actions;
+	env->rewards = rewards;
+	env->dones = dones;
+	run_thread_pool(env->pool, step_slice, env);
+}
+
+void
+delete_vec_env(vec_env_t *env)
+{
+	for (int i = 0; i < pool_workers(env->pool); i++)
+		free(env->queue[i]);
+	delete_thread_pool(env->pool);
+	free(env->queue);
+	aligned_free(env->states);
+	free(env->layouts);
+	free(env);
+}
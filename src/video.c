@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <video.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Bytes of the stdio buffer of the file, a frame usually takes several */
+#define VIDEO_BUFFER_SIZE (1 << 20)
+
+/* Color of each cell type, as RGB */
+static const unsigned char cell_colors[CELL_TYPES][3] = {
+	[EMPTY] = {0, 0, 0},
+	[SNAKE] = {205, 0, 0},
+	[HEAD] = {0, 255, 0},
+	[HEAD2] = {0, 255, 255},
+	[FOOD] = {229, 229, 229},
+	[BORDER] = {205, 0, 205},
+	[OBSTACLE] = {205, 0, 205},
+	[SHORTENER] = {0, 0, 238},
+	[DECELERATOR] = {0, 205, 0},
+	[EXTRA_POINTS] = {205, 205, 0},
+};
+
+/*
+ * Convert the color rgb into limited range BT.601 yuv
+ */
+static void
+rgb_to_yuv(const unsigned char *rgb, unsigned char *yuv)
+{
+	int r = rgb[0], g = rgb[1], b = rgb[2];
+
+	yuv[0] = (unsigned char)(16 + (66 * r + 129 * g + 25 * b + 128) / 256);
+	yuv[1] = (unsigned char)(128 + (-38 * r - 74 * g + 112 * b + 128) / 256);
+	yuv[2] = (unsigned char)(128 + (112 * r - 94 * g - 18 * b + 128) / 256);
+}
+
+/*
+ * Draw cells into the pixels of the frame for Y4M: a plane of Y, then U,
+ * then V. Each cell is a run of scale bytes in the first pixel row of its
+ * field row, the other pixel rows are copies of that one
+ */
+static void
+draw_y4m(video_t *video, const cell_byte_t *cells)
+{
+	int field_width = video->width / video->scale, scale = video->scale;
+	size_t plane_size = (size_t)video->width * video->height;
+	unsigned char *plane, *row;
+	const cell_byte_t *cell_row;
+
+	for (int p = 0; p < 3; p++)
+	{
+		plane = video->frame + video->header_size + p * plane_size;
+		for (int y = 0; y < video->height / scale; y++)
+		{
+			row = plane + (size_t)y * scale * video->width;
+			cell_row = cells + (size_t)y * field_width;
+			if (scale == 1)
+				for (int x = 0; x < field_width; x++)
+					row[x] = video->palette[p][cell_row[x]];
+			else
+				for (int x = 0; x < field_width; x++)
+					memset(row + x * scale, video->palette[p][cell_row[x]], scale);
+			for (int k = 1; k < scale; k++)
+				memcpy(row + (size_t)k * video->width, row, video->width);
+		}
+	}
+}
+
+/*
+ * Draw cells into the pixels of the frame for PPM, copying the run of
+ * scale RGB pixels of each cell
+ */
+static void
+draw_ppm(video_t *video, const cell_byte_t *cells)
+{
+	int field_width = video->width / video->scale, scale = video->scale;
+	size_t row_size = (size_t)video->width * 3, run_size = (size_t)scale * 3;
+	unsigned char *row;
+	const cell_byte_t *cell_row;
+
+	for (int y = 0; y < video->height / scale; y++)
+	{
+		row = video->frame + video->header_size + (size_t)y * scale * row_size;
+		cell_row = cells + (size_t)y * field_width;
+		for (int x = 0; x < field_width; x++)
+			memcpy(row + x * run_size, video->runs + cell_row[x] * run_size,
+					run_size);
+		for (int k = 1; k < scale; k++)
+			memcpy(row + k * row_size, row, row_size);
+	}
+}
+
+video_t*
+open_video(const char *path, int field_height, int field_width, int scale,
+		int fps_num, int fps_den)
+{
+	video_t *video;
+	size_t length = strlen(path);
+	FILE *file;
+
+	if (!(file = fopen(path, "wb")))
+		return (NULL);
+
+	video = malloc(sizeof(video_t));
+	video->file = file;
+	video->scale = scale;
+	video->width = field_width * scale;
+	video->height = field_height * scale;
+	video->failed = 0;
+	setvbuf(file, NULL, _IOFBF, VIDEO_BUFFER_SIZE);
+
+	/* Colors in the order of the format, and pixel runs for PPM */
+	video->format = length >= 4 && !strcmp(path + length - 4, ".y4m") ?
+		VIDEO_Y4M : VIDEO_PPM;
+	video->runs = malloc((size_t)CELL_TYPES * scale * 3);
+	for (int i = 0; i < CELL_TYPES; i++)
+	{
+		unsigned char yuv[3];
+
+		rgb_to_yuv(cell_colors[i], yuv);
+		for (int p = 0; p < 3; p++)
+			video->palette[p][i] = video->format == VIDEO_Y4M ?
+				yuv[p] : cell_colors[i][p];
+		for (int j = 0; j < scale; j++)
+			memcpy(video->runs + ((size_t)i * scale + j) * 3, cell_colors[i], 3);
+	}
+
+	/* Frame buffer, with the header of each frame already in place */
+	if (video->format == VIDEO_Y4M)
+	{
+		fprintf(file, "YUV4MPEG2 W%d H%d F%d:%d Ip A1:1 C444\n",
+				video->width, video->height, fps_num, fps_den);
+		video->header_size = strlen("FRAME\n");
+	}
+	else
+		video->header_size = (size_t)snprintf(NULL, 0, "P6\n%d %d\n255\n",
+				video->width, video->height);
+	video->frame_size = video->header_size +
+		(size_t)video->width * video->height * 3;
+	video->frame = malloc(video->frame_size + 1);
+	if (video->format == VIDEO_Y4M)
+		memcpy(video->frame, "FRAME\n", video->header_size);
+	else
+		snprintf((char*)video->frame, video->header_size + 1, "P6\n%d %d\n255\n",
+				video->width, video->height);
+
+	return (video);
+}
+
+void
+write_video_frame(video_t *video, const cell_byte_t *cells)
+{
+	if (video->format == VIDEO_Y4M)
+		draw_y4m(video, cells);
+	else
+		draw_ppm(video, cells);
+
+	if (fwrite(video->frame, 1, video->frame_size, video->file) !=
+			video->frame_size)
+		video->failed = 1;
+}
+
+int
+close_video(video_t *video)
+{
+	int success = !video->failed;
+
+	if (fclose(video->file) != 0)
+		success = 0;
+	free(video->frame);
+	free(video->runs);
+	free(video);
+
+	return (success);
+}
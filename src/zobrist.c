@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2020 Esteban López Rodríguez <gnu_stallman@protonmail.ch>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <zobrist.h>
+#include <rng.h>
+
+/* Tags so keys of different things don't come from the same numbers */
+#define TAG_CELL 0x0000000000000000u
+#define TAG_ITEM 0x4000000000000000u
+#define TAG_PLAYER 0x8000000000000000u
+
+/*
+ * Return the bits of x mixed up (an output of splitmix64)
+ */
+static uint64_t
+mix(uint64_t x)
+{
+	rng_t rng = {x};
+
+	return (next_rng(&rng));
+}
+
+uint64_t
+zobrist_cell(int cell, cell_t type)
+{
+	return (mix(TAG_CELL + (uint64_t)cell * CELL_TYPES + type));
+}
+
+uint64_t
+zobrist_item(int cell, game_clock_t destruction)
+{
+	return (mix(mix(TAG_ITEM + (uint64_t)cell) + destruction));
+}
+
+uint64_t
+zobrist_player(int player, direction_t direction, unsigned int score)
+{
+	return (mix(mix(TAG_PLAYER + (uint64_t)player * 4 + direction) + score));
+}